@@ -26,6 +26,11 @@
 //           an engine. Bits 7:4 are the engine index. The register
 //           interpretations are determined by the engines.
 //
+//   0x8?? - Snapshot of the individual engine CSR spaces (read only),
+//           with the same layout as the live space at 0x4??. Values
+//           are recorded by the snapshot command below, only for the
+//           CSR indices in SNAPSHOT_CSR_MASK. Others read as 0.
+//
 
 //
 // CSR manager control space (0x01?):
@@ -38,6 +43,11 @@
 //
 //    0x011: Disable engines. Clear state_run in the selected engines.
 //
+//    0x012: Snapshot. Record the read registers of all engines and the
+//           execution cycle counters in a single cycle. The value written
+//           is ignored. Engines keep running, so the snapshot can be used
+//           to sample consistent counters from live traffic.
+//
 //  Reads:
 //    0x010: Configuration details:
 //             [63:16] undefined
@@ -48,6 +58,10 @@
 //           even if not running while outstanding requests are in flight.
 //    0x013: Engine execution cycles in clk domain (primary AFU clock).
 //    0x014: Engine execution cycles in pClk domain.
+//    0x015: Engine execution cycles in clk domain at the last snapshot.
+//    0x016: Engine execution cycles in pClk domain at the last snapshot.
+//    0x017: Number of snapshots taken. Software can wait for the count to
+//           change to be sure a snapshot is complete.
 //
 
 module csr_mgr
@@ -57,7 +71,13 @@ module csr_mgr
     parameter DFH_MMIO_NEXT_ADDR = 0,
     parameter MMIO_ADDR_WIDTH = 16,
     parameter MMIO_DATA_WIDTH = 64,
-    parameter MMIO_TID_WIDTH = 9
+    parameter MMIO_TID_WIDTH = 9,
+
+    // Engine CSR indices recorded by the snapshot command. Others read
+    // as 0 in the snapshot space. Each set bit costs a 64 bit register
+    // per engine, so only AFUs whose software reads snapshots set any.
+    // The cycle counters and snapshot count are recorded regardless.
+    parameter SNAPSHOT_CSR_MASK = 16'h0
     )
    (
     input  logic clk,
@@ -115,6 +135,12 @@ module csr_mgr
 
     logic [47:0] num_pClk_cycles, num_clk_cycles;
 
+    // Snapshot state
+    logic snapshot_req;
+    logic [47:0] snap_pClk_cycles, snap_clk_cycles;
+    logic [31:0] snap_count;
+    t_mmio_value eng_csr_snap[NUM_ENGINES][16];
+
 
     // ====================================================================
     //
@@ -186,12 +212,16 @@ module csr_mgr
     t_mmio_value eng_csr_data;
 
     generate
-        // First stage, pick from the 16 registers in each engine.
+        // First stage, pick from the 16 registers in each engine. Address
+        // bit 11 selects the snapshot.
         for (genvar e = 0; e < NUM_ENGINES; e = e + 1)
         begin : es3
             always_ff @(posedge clk)
             begin
-                eng_csr_data_s3[e] <= eng_csr[e].rd_data[read_idx[4][3:0]];
+                if (read_idx[4][11])
+                    eng_csr_data_s3[e] <= eng_csr_snap[e][read_idx[4][3:0]];
+                else
+                    eng_csr_data_s3[e] <= eng_csr[e].rd_data[read_idx[4][3:0]];
             end
         end
         for (genvar e = NUM_ENGINES; e < 64; e = e + 1)
@@ -283,6 +313,9 @@ module csr_mgr
             4'h2: csr_mgr_ctrl <= 64'(status_active);
             4'h3: csr_mgr_ctrl <= 64'(num_clk_cycles);
             4'h4: csr_mgr_ctrl <= 64'(num_pClk_cycles);
+            4'h5: csr_mgr_ctrl <= 64'(snap_clk_cycles);
+            4'h6: csr_mgr_ctrl <= 64'(snap_pClk_cycles);
+            4'h7: csr_mgr_ctrl <= 64'(snap_count);
             default: csr_mgr_ctrl <= 64'b0;
         endcase
     end
@@ -306,8 +339,10 @@ module csr_mgr
             12'h02?: rd_readdata <= eng_csr_glob_data;
 
             // Individual engines have 16 registers each, reduced
-            // to a single register in a pipeline above.
+            // to a single register in a pipeline above. The live
+            // registers and the snapshot share the pipeline.
             12'b01??????????: rd_readdata <= eng_csr_data;
+            12'b10??????????: rd_readdata <= eng_csr_data;
 
             default: rd_readdata <= 64'h0;
         endcase // casez (read_idx[0])
@@ -422,6 +457,8 @@ module csr_mgr
     assign is_eng_enable_cmd = is_cmd && (cmd_wr_address[3:0] == 4'h0);
     logic is_eng_disable_cmd;
     assign is_eng_disable_cmd = is_cmd && (cmd_wr_address[3:0] == 4'h1);
+    logic is_snapshot_cmd;
+    assign is_snapshot_cmd = is_cmd && (cmd_wr_address[3:0] == 4'h2);
 
     generate
         for (genvar e = 0; e < NUM_ENGINES; e = e + 1)
@@ -454,6 +491,81 @@ module csr_mgr
         end
     endgenerate
 
+
+    //
+    // Snapshot. The command is registered once and then again locally in
+    // each engine's fanout, so all engines record their CSRs in the same
+    // cycle. The cycle counters are recorded in that cycle too.
+    //
+    always_ff @(posedge clk)
+    begin
+        snapshot_req <= is_snapshot_cmd;
+
+        if (!reset_n)
+        begin
+            snapshot_req <= 1'b0;
+        end
+    end
+
+    logic snapshot_cycles;
+
+    always_ff @(posedge clk)
+    begin
+        snapshot_cycles <= snapshot_req;
+
+        if (snapshot_cycles)
+        begin
+            snap_clk_cycles <= num_clk_cycles;
+            snap_pClk_cycles <= num_pClk_cycles;
+            snap_count <= snap_count + 1;
+        end
+
+        if (!reset_n)
+        begin
+            snapshot_cycles <= 1'b0;
+            snap_clk_cycles <= '0;
+            snap_pClk_cycles <= '0;
+            snap_count <= '0;
+        end
+    end
+
+    generate
+        for (genvar e = 0; e < NUM_ENGINES; e = e + 1)
+        begin : snap_eng
+            logic snapshot_eng;
+
+            always_ff @(posedge clk)
+            begin
+                snapshot_eng <= snapshot_req;
+                eng_csr[e].snapshot <= snapshot_req;
+
+                if (!reset_n)
+                begin
+                    snapshot_eng <= 1'b0;
+                    eng_csr[e].snapshot <= 1'b0;
+                end
+            end
+
+            for (genvar i = 0; i < 16; i = i + 1)
+            begin : r
+                if (SNAPSHOT_CSR_MASK[i])
+                begin : s
+                    always_ff @(posedge clk)
+                    begin
+                        if (snapshot_eng)
+                        begin
+                            eng_csr_snap[e][i] <= eng_csr[e].rd_data[i];
+                        end
+                    end
+                end
+                else
+                begin : z
+                    assign eng_csr_snap[e][i] = '0;
+                end
+            end
+        end
+    endgenerate
+
     logic cycle_counter_reset_n;
     logic cycle_counter_enable;
     assign cycle_counter_enable = some_engine_is_active;
@@ -13,7 +13,9 @@ module csr_mgr_axi
   #(
     parameter INSTANCE_ID = 0,
     parameter NUM_ENGINES = 1,
-    parameter DFH_MMIO_NEXT_ADDR = 0
+    parameter DFH_MMIO_NEXT_ADDR = 0,
+    // Passed to csr_mgr
+    parameter SNAPSHOT_CSR_MASK = 16'h0
     )
    (
     // CSR read and write commands from the host
@@ -127,7 +129,8 @@ module csr_mgr_axi
         .DFH_MMIO_NEXT_ADDR(DFH_MMIO_NEXT_ADDR),
         .MMIO_ADDR_WIDTH(MMIO_ADDR_WIDTH),
         .MMIO_DATA_WIDTH(MMIO_DATA_WIDTH),
-        .MMIO_TID_WIDTH(mmio_if.USER_WIDTH + mmio_if.RID_WIDTH)
+        .MMIO_TID_WIDTH(mmio_if.USER_WIDTH + mmio_if.RID_WIDTH),
+        .SNAPSHOT_CSR_MASK(SNAPSHOT_CSR_MASK)
         )
       csr_mgr
        (
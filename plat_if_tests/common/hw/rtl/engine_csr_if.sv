@@ -35,6 +35,11 @@ interface engine_csr_if
     // Read registers are sampled continuously. There is no explicit request.
     t_csr_value rd_data[NUM_CSRS];
 
+    // Raised for one cycle when the host requests a snapshot. The CSR manager
+    // records rd_data in the same cycle for every engine, so engines need not
+    // act on it.
+    logic snapshot;
+
     modport csr_mgr
        (
         output state_reset,
@@ -45,7 +50,8 @@ interface engine_csr_if
         output wr_idx,
         output wr_data,
 
-        input  rd_data
+        input  rd_data,
+        output snapshot
         );
 
     modport engine
@@ -58,7 +64,8 @@ interface engine_csr_if
         input  wr_idx,
         input  wr_data,
 
-        output rd_data
+        output rd_data,
+        input  snapshot
         );
 
 endinterface // engine_csr_if
@@ -0,0 +1,340 @@
+// Copyright (C) 2022 Intel Corporation
+// SPDX-License-Identifier: MIT
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <pthread.h>
+#include <numa.h>
+
+#include "buffer_pool.h"
+
+#define KB(x) ((size_t)(x) * 1024)
+#define MB(x) ((size_t)(x) * 1048576)
+#define GB(x) ((size_t)(x) * 1073741824)
+
+#define PROTECTION (PROT_READ | PROT_WRITE)
+
+#ifndef MAP_HUGETLB
+#define MAP_HUGETLB 0x40000
+#endif
+#ifndef MAP_HUGE_SHIFT
+#define MAP_HUGE_SHIFT 26
+#endif
+
+#define MAP_1G_HUGEPAGE (0x1e << MAP_HUGE_SHIFT) /* 2 ^ 0x1e = 1G */
+
+#define FLAGS_4K (MAP_PRIVATE | MAP_ANONYMOUS)
+#define FLAGS_2M (FLAGS_4K | MAP_HUGETLB)
+#define FLAGS_1G (FLAGS_2M | MAP_1G_HUGEPAGE)
+
+//
+// A mapped (and usually pinned) range from which buffers are carved.
+//
+typedef struct t_buf_pool_chunk
+{
+    struct t_buf_pool_chunk *next;
+
+    fpga_handle accel_handle;
+    // Copy of the NUMA binding, NULL when unbound
+    struct bitmask *numa_mem_mask;
+    // Pages are interleaved across numa_mem_mask instead of bound to it
+    bool interleave;
+
+    void *va;
+    size_t size;
+    size_t page_size;
+    bool pinned;
+    uint64_t wsid;
+    uint64_t ioaddr;
+
+    // Bytes consumed from the start of the chunk
+    size_t used;
+}
+t_buf_pool_chunk;
+
+static pthread_mutex_t s_lock = PTHREAD_MUTEX_INITIALIZER;
+static t_buf_pool_chunk *s_chunks;
+static size_t s_max_page_size;
+
+
+static bool
+sameNumaMask(struct bitmask *a, struct bitmask *b)
+{
+    if ((NULL == a) || (NULL == b)) return (a == b);
+    return numa_bitmask_equal(a, b);
+}
+
+
+static size_t
+roundUp(size_t n, size_t align)
+{
+    return (n + align - 1) & ~(align - 1);
+}
+
+
+//
+// Find the offset of a size/align buffer in chunk c. Returns false if it
+// doesn't fit.
+//
+static bool
+chunkFit(
+    const t_buf_pool_chunk *c,
+    size_t size,
+    size_t align,
+    size_t *offset)
+{
+    uintptr_t va = (uintptr_t)c->va;
+    size_t off = roundUp(va + c->used, align) - va;
+
+    // The engines treat a zero IOVA as a hint to disable the engine
+    if (c->ioaddr + off == 0) off += align;
+
+    if (off + size > c->size) return false;
+
+    // A buffer may only span pages of a multi-page chunk if it is the
+    // chunk's first. The chunk was then mapped for that buffer and pinned
+    // as a unit, as though it had been allocated on its own.
+    if ((c->page_size < c->size) && (c->used != 0) &&
+        ((off / c->page_size) != ((off + size - 1) / c->page_size)))
+    {
+        return false;
+    }
+
+    *offset = off;
+    return true;
+}
+
+
+//
+// Map and pin a new chunk big enough for a size/align buffer. Try a 1GB
+// page first, then fall back to smaller pages.
+//
+static t_buf_pool_chunk *
+newChunk(
+    fpga_handle accel_handle,
+    struct bitmask *numa_mem_mask,
+    bool interleave,
+    size_t size,
+    size_t align)
+{
+    const size_t page_sizes[] = { GB(1), MB(2), KB(4) };
+    const int page_flags[] = { FLAGS_1G, FLAGS_2M, FLAGS_4K };
+    size_t max_page_size = s_max_page_size ? s_max_page_size : GB(1);
+
+    t_buf_pool_chunk *c = calloc(1, sizeof(t_buf_pool_chunk));
+    assert(NULL != c);
+
+    // Preserve current NUMA configuration
+    struct bitmask *numa_mems_preserve = NULL;
+    if (numa_mem_mask && ! interleave)
+    {
+        numa_mems_preserve = numa_get_membind();
+        numa_set_membind(numa_mem_mask);
+    }
+
+    c->va = MAP_FAILED;
+    for (int i = 0; i < 3; i += 1)
+    {
+        size_t page_size = page_sizes[i];
+        if ((page_size > max_page_size) && (page_size != KB(4))) continue;
+
+        // Sized for the buffer, leaving room to align it. Small buffers
+        // share a 1GB page.
+        size_t csize = roundUp(size + (align > page_size ? align : 0), page_size);
+
+        c->va = mmap(NULL, csize, PROTECTION, page_flags[i], -1, 0);
+        if (MAP_FAILED != c->va)
+        {
+            c->size = csize;
+            c->page_size = page_size;
+            break;
+        }
+    }
+
+    if (MAP_FAILED == c->va) goto fail;
+
+    // An interleave policy on the mapping itself applies whenever pages
+    // are faulted in, either by pinning or by first touch.
+    if (interleave) numa_interleave_memory(c->va, c->size, numa_mem_mask);
+
+    if (accel_handle)
+    {
+        // Pin the chunk
+        fpga_result r;
+        r = fpgaPrepareBuffer(accel_handle, c->size, &c->va, &c->wsid,
+                              FPGA_BUF_PREALLOCATED);
+        if (FPGA_OK != r)
+        {
+            munmap(c->va, c->size);
+            goto fail;
+        }
+
+        r = fpgaGetIOAddress(accel_handle, c->wsid, &c->ioaddr);
+        assert(FPGA_OK == r);
+        c->pinned = true;
+    }
+    else
+    {
+        c->ioaddr = (uint64_t)c->va;
+    }
+
+    if (numa_mem_mask)
+    {
+        // Restore NUMA configuration
+        if (numa_mems_preserve)
+        {
+            numa_set_membind(numa_mems_preserve);
+            numa_bitmask_free(numa_mems_preserve);
+        }
+
+        c->numa_mem_mask = numa_allocate_nodemask();
+        copy_bitmask_to_bitmask(numa_mem_mask, c->numa_mem_mask);
+    }
+
+    c->accel_handle = accel_handle;
+    c->interleave = interleave;
+    c->next = s_chunks;
+    s_chunks = c;
+    return c;
+
+  fail:
+    if (numa_mems_preserve)
+    {
+        numa_set_membind(numa_mems_preserve);
+        numa_bitmask_free(numa_mems_preserve);
+    }
+    free(c);
+    return NULL;
+}
+
+
+static void *
+allocRegion(
+    fpga_handle accel_handle,
+    struct bitmask *numa_mem_mask,
+    bool interleave,
+    size_t size,
+    size_t align,
+    t_buf_pool_region *region)
+{
+    if (align < 64) align = 64;
+    assert(0 == (align & (align - 1)));
+
+    pthread_mutex_lock(&s_lock);
+
+    t_buf_pool_chunk *c;
+    size_t off = 0;
+    for (c = s_chunks; c; c = c->next)
+    {
+        if ((c->accel_handle == accel_handle) &&
+            (c->interleave == interleave) &&
+            sameNumaMask(c->numa_mem_mask, numa_mem_mask) &&
+            chunkFit(c, size, align, &off))
+        {
+            break;
+        }
+    }
+
+    // A new chunk whose IOVA is 0 may not fit the buffer after skipping
+    // the first address. Keep it allocated as a placeholder and try again.
+    while (NULL == c)
+    {
+        c = newChunk(accel_handle, numa_mem_mask, interleave, size, align);
+        if (NULL == c) break;
+        if (! chunkFit(c, size, align, &off))
+        {
+            c->used = c->size;
+            c = NULL;
+        }
+    }
+
+    void *va = NULL;
+    if (c)
+    {
+        c->used = off + size;
+
+        va = (uint8_t*)c->va + off;
+        region->va = va;
+        region->ioaddr = c->ioaddr + off;
+        region->wsid = c->wsid;
+        region->page_size = c->page_size;
+        region->page_va = (uint8_t*)c->va + (off & ~(c->page_size - 1));
+        region->iova_contiguous = ! c->pinned ||
+                                  (c->page_size >= c->size) ||
+                                  ((off / c->page_size) ==
+                                   ((off + size - 1) / c->page_size));
+    }
+
+    pthread_mutex_unlock(&s_lock);
+    return va;
+}
+
+
+void *
+bufPoolAlloc(
+    fpga_handle accel_handle,
+    struct bitmask *numa_mem_mask,
+    size_t size,
+    size_t align,
+    t_buf_pool_region *region)
+{
+    return allocRegion(accel_handle, numa_mem_mask, false, size, align, region);
+}
+
+
+void *
+bufPoolAllocInterleaved(
+    fpga_handle accel_handle,
+    struct bitmask *numa_mem_mask,
+    size_t size,
+    size_t align,
+    t_buf_pool_region *region)
+{
+    assert(NULL != numa_mem_mask);
+    return allocRegion(accel_handle, numa_mem_mask, true, size, align, region);
+}
+
+
+void
+bufPoolRelease(fpga_handle accel_handle)
+{
+    pthread_mutex_lock(&s_lock);
+
+    t_buf_pool_chunk **p = &s_chunks;
+    while (*p)
+    {
+        t_buf_pool_chunk *c = *p;
+        if (c->accel_handle != accel_handle)
+        {
+            p = &c->next;
+            continue;
+        }
+
+        *p = c->next;
+        if (c->pinned) fpgaReleaseBuffer(accel_handle, c->wsid);
+        munmap(c->va, c->size);
+        if (c->numa_mem_mask) numa_bitmask_free(c->numa_mem_mask);
+        free(c);
+    }
+
+    pthread_mutex_unlock(&s_lock);
+}
+
+
+void
+bufPoolSetMaxPageSize(size_t page_size)
+{
+    s_max_page_size = page_size;
+}
+
+
+const char *
+bufPoolPageSizeStr(size_t page_size)
+{
+    if (page_size == GB(1)) return "1GB";
+    if (page_size == MB(2)) return "2MB";
+    if (page_size == KB(4)) return "4KB";
+    return "?";
+}
@@ -0,0 +1,104 @@
+// Copyright (C) 2022 Intel Corporation
+// SPDX-License-Identifier: MIT
+
+//
+// Pool of pinned host memory shared with the FPGA. Tests that need many
+// small buffers (one or more per engine) allocate them from the pool
+// instead of mapping and pinning each buffer separately.
+//
+// The pool reserves memory in chunks, preferring 1GB huge pages, and pins
+// each chunk once with fpgaPrepareBuffer(). Buffers are carved from chunks
+// with the requested alignment. When 1GB pages are not available, chunks
+// fall back to 2MB and then 4KB pages sized for the request, which matches
+// the old one buffer per mapping behavior.
+//
+// Chunks belong to one accelerator handle and one NUMA memory binding or
+// interleave set.
+// A NULL accelerator handle allocates unpinned memory whose I/O address
+// is the virtual address, as used by software models.
+//
+// Buffers are not freed individually. bufPoolRelease() unpins and unmaps
+// every chunk of a handle.
+//
+
+#ifndef __BUFFER_POOL_H__
+#define __BUFFER_POOL_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <opae/fpga.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+struct bitmask;
+
+typedef struct
+{
+    void *va;
+    // Address of va in the FPGA's I/O space
+    uint64_t ioaddr;
+    // Workspace ID of the pinned chunk holding the buffer
+    uint64_t wsid;
+
+    // Size of the pages backing the buffer and the start of the page
+    // holding va
+    size_t page_size;
+    void *page_va;
+    // Is the buffer's I/O address range known to be contiguous? True when
+    // the buffer is within a single page or the pool is unpinned.
+    bool iova_contiguous;
+}
+t_buf_pool_region;
+
+//
+// Allocate size bytes aligned to align (at least a cache line) and pinned
+// for accel_handle. Memory is bound to the nodes in numa_mem_mask, or
+// follows the current policy when numa_mem_mask is NULL. The I/O address
+// of a buffer is never 0, since engines treat 0 as disabled.
+//
+// Returns the virtual address, or NULL on failure.
+//
+void *bufPoolAlloc(
+    fpga_handle accel_handle,
+    struct bitmask *numa_mem_mask,
+    size_t size,
+    size_t align,
+    t_buf_pool_region *region);
+
+//
+// Like bufPoolAlloc(), but pages are interleaved across the nodes in
+// numa_mem_mask. Pages are the unit of interleaving, so buffers smaller
+// than a page land on a single node.
+//
+void *bufPoolAllocInterleaved(
+    fpga_handle accel_handle,
+    struct bitmask *numa_mem_mask,
+    size_t size,
+    size_t align,
+    t_buf_pool_region *region);
+
+//
+// Unpin and unmap all memory allocated for accel_handle.
+//
+void bufPoolRelease(fpga_handle accel_handle);
+
+//
+// Limit the page size of new chunks. Simulation passes 2MB since it
+// mirrors every pinned byte. Footprint sweeps use it to pick the page
+// size under test. 0 restores the default (1GB).
+//
+void bufPoolSetMaxPageSize(size_t page_size);
+
+//
+// Page size as a short string, e.g. "2MB".
+//
+const char *bufPoolPageSizeStr(size_t page_size);
+
+#ifdef __cplusplus
+}
+#endif
+#endif // __BUFFER_POOL_H__
@@ -0,0 +1,183 @@
+// Copyright (C) 2022 Intel Corporation
+// SPDX-License-Identifier: MIT
+
+#include <stdint.h>
+#include <pthread.h>
+#include <cpuid.h>
+#include <immintrin.h>
+
+#include "cache_ops.h"
+#include "thread_pool.h"
+
+#define CACHELINE_BYTES 64
+
+// Ranges at least this large are split across the thread pool, in tasks
+// of CACHE_TASK_BYTES.
+#define CACHE_MT_MIN_BYTES (16 * 1048576)
+#define CACHE_TASK_BYTES (2 * 1048576)
+
+static pthread_once_t s_probe_once = PTHREAD_ONCE_INIT;
+static t_cache_features s_features;
+
+
+static void
+probeFeatures(void)
+{
+    unsigned int eax, ebx, ecx, edx;
+    if (__get_cpuid_max(0, 0) >= 7)
+    {
+        __cpuid_count(7, 0, eax, ebx, ecx, edx);
+        s_features.clflushopt = (((1 << 23) & ebx) != 0);
+        s_features.clwb = (((1 << 24) & ebx) != 0);
+        s_features.cldemote = (((1 << 25) & ecx) != 0);
+    }
+}
+
+
+const t_cache_features *
+cacheGetFeatures(void)
+{
+    pthread_once(&s_probe_once, probeFeatures);
+    return &s_features;
+}
+
+
+//
+// Taken from https://github.com/pmem/pmdk/blob/master/src/libpmem2/x86_64/flush.h.
+// The clflushopt and clwb instructions were added for Skylake and aren't in
+// <immintrin.h> in many of the compilers currently in use.
+//
+static inline void
+asm_clflushopt(const void *addr)
+{
+    asm volatile(".byte 0x66; clflush %0" : "+m" \
+        (*(volatile char *)(addr)));
+}
+
+static inline void
+asm_clwb(const void *addr)
+{
+    asm volatile(".byte 0x66; xsaveopt %0" : "+m" \
+        (*(volatile char *)(addr)));
+}
+
+// cldemote (NP 0F 1C /0) with the address in rax. Older CPUs treat it
+// as a NOP.
+static inline void
+asm_cldemote(const void *addr)
+{
+    asm volatile(".byte 0x0f, 0x1c, 0x00" : : "a" (addr) : "memory");
+}
+
+
+typedef enum
+{
+    CACHE_OP_FLUSH,
+    CACHE_OP_WRITEBACK
+}
+t_cache_op;
+
+static void
+flushLines(t_cache_op op, uint8_t *cl, uint8_t *end)
+{
+    const t_cache_features *f = cacheGetFeatures();
+
+    if ((op == CACHE_OP_WRITEBACK) && f->clwb)
+    {
+        for (; cl < end; cl += CACHELINE_BYTES) asm_clwb(cl);
+    }
+    else if (f->clflushopt)
+    {
+        for (; cl < end; cl += CACHELINE_BYTES) asm_clflushopt(cl);
+    }
+    else
+    {
+        // clflush is ordered with respect to other flushes and stores,
+        // so it doesn't need the fence. It is much slower.
+        for (; cl < end; cl += CACHELINE_BYTES) _mm_clflush(cl);
+        return;
+    }
+
+    _mm_sfence();
+}
+
+
+typedef struct
+{
+    t_cache_op op;
+    uint8_t *start;
+    uint8_t *end;
+}
+t_flush_job;
+
+static void
+flushTask(void *arg, uint32_t task_idx)
+{
+    const t_flush_job *job = arg;
+    uint8_t *cl = job->start + (size_t)task_idx * CACHE_TASK_BYTES;
+    uint8_t *end = cl + CACHE_TASK_BYTES;
+    if (end > job->end) end = job->end;
+
+    flushLines(job->op, cl, end);
+}
+
+
+static void
+flushRange(t_cache_op op, void *start, size_t len)
+{
+    // Cover partial lines at both ends
+    uint8_t *cl = (uint8_t*)((uintptr_t)start & ~(uintptr_t)(CACHELINE_BYTES - 1));
+    uint8_t *end = (uint8_t*)start + len;
+
+    if ((len < CACHE_MT_MIN_BYTES) || (threadPoolNumThreads() == 1))
+    {
+        flushLines(op, cl, end);
+        return;
+    }
+
+    // Each thread fences its own flushes. threadPoolRun() returns only once
+    // all have finished.
+    t_flush_job job = { op, cl, end };
+    size_t n_tasks = (end - cl + CACHE_TASK_BYTES - 1) / CACHE_TASK_BYTES;
+    threadPoolRun(n_tasks, flushTask, &job);
+}
+
+
+void
+cacheFlushRange(void *start, size_t len)
+{
+    flushRange(CACHE_OP_FLUSH, start, len);
+}
+
+
+void
+cacheWritebackRange(void *start, size_t len)
+{
+    flushRange(CACHE_OP_WRITEBACK, start, len);
+}
+
+
+void
+cacheDemoteRange(void *start, size_t len)
+{
+    if (! cacheGetFeatures()->cldemote) return;
+
+    uint8_t *cl = (uint8_t*)((uintptr_t)start & ~(uintptr_t)(CACHELINE_BYTES - 1));
+    uint8_t *end = (uint8_t*)start + len;
+    for (; cl < end; cl += CACHELINE_BYTES) asm_cldemote(cl);
+}
+
+
+void
+cachePrefetchRange(void *start, size_t len)
+{
+    // Single threaded. The point is to fill this core's cache.
+    const volatile uint8_t *cl = start;
+    const volatile uint8_t *end = (const uint8_t*)start + len;
+
+    while (cl < end)
+    {
+        (void)*cl;
+        cl += CACHELINE_BYTES;
+    }
+}
@@ -0,0 +1,62 @@
+// Copyright (C) 2022 Intel Corporation
+// SPDX-License-Identifier: MIT
+
+//
+// Cache line management for buffers shared with the FPGA. Tests use these
+// to put buffers in a known cache state before the FPGA touches them.
+//
+// CPU features are probed once. Operations fall back when an instruction
+// is missing: clflushopt to clflush and clwb to a flush. cldemote is only
+// a hint and is skipped when unsupported. Flushes and write-backs of
+// large ranges are split across the common thread pool, so they must not
+// be called from a thread pool task.
+//
+
+#ifndef __CACHE_OPS_H__
+#define __CACHE_OPS_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+typedef struct
+{
+    bool clflushopt;
+    bool clwb;
+    bool cldemote;
+}
+t_cache_features;
+
+// CPU cache management features, probed on the first call
+const t_cache_features *cacheGetFeatures(void);
+
+//
+// Write back and invalidate a range in the entire coherence domain.
+// (All cores all sockets)
+//
+void cacheFlushRange(void *start, size_t len);
+
+//
+// Write back dirty lines in a range to memory. Lines may remain cached.
+//
+void cacheWritebackRange(void *start, size_t len);
+
+//
+// Hint that lines in a range, cached by the calling core, should move to
+// a cache shared with other agents (the LLC).
+//
+void cacheDemoteRange(void *start, size_t len);
+
+//
+// Read a range into the calling core's cache.
+//
+void cachePrefetchRange(void *start, size_t len);
+
+#ifdef __cplusplus
+}
+#endif
+#endif // __CACHE_OPS_H__
@@ -68,9 +68,10 @@ LDFLAGS  += -L$(DESTDIR)$(prefix)/lib -Wl,-rpath-link -Wl,$(prefix)/lib -Wl,-rpa
             -L$(DESTDIR)$(prefix)/lib64 -Wl,-rpath-link -Wl,$(prefix)/lib64 -Wl,-rpath -Wl,$(DESTDIR)$(prefix)/lib64
 endif
 
-COMMON_SRCS = connect.c csr_mgr.c hash32.c test_data.c
+COMMON_SRCS = cache_ops.c connect.c csr_mgr.c eng_wait.c hash32.c result_writer.c test_data.c thread_pool.c
 
-LDFLAGS += -luuid
+CFLAGS += -pthread
+LDFLAGS += -luuid -pthread
 
 FPGA_LIBS = -lopae-c
 ASE_LIBS = -lopae-c-ase
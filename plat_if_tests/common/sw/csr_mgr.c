@@ -5,20 +5,132 @@
 
 #include "csr_mgr.h"
 
+//
+// Direct MMIO mappings are shared by all handles on the same FPGA handle
+// and MMIO region. fpgaMapMMIO() of a mapped region returns the existing
+// mapping and a single fpgaUnmapMMIO() removes it, so mappings are
+// reference counted and unmapped when the last handle is released.
+//
+#define MAX_MMIO_MAPS 16
+
+typedef struct
+{
+    fpga_handle fpga_handle;
+    uint32_t mmio_num;
+    uint64_t *mmio_ptr;
+    uint32_t ref_cnt;
+}
+t_mmio_map;
+
+static t_mmio_map s_mmio_maps[MAX_MMIO_MAPS];
+
+static t_mmio_map *
+findMmioMap(fpga_handle fpga_handle, uint32_t mmio_num)
+{
+    for (int i = 0; i < MAX_MMIO_MAPS; i += 1)
+    {
+        if (s_mmio_maps[i].ref_cnt &&
+            (s_mmio_maps[i].fpga_handle == fpga_handle) &&
+            (s_mmio_maps[i].mmio_num == mmio_num))
+        {
+            return &s_mmio_maps[i];
+        }
+    }
+    return NULL;
+}
+
+//
+// Map an MMIO region or add a reference to an existing mapping. Returns
+// NULL if the region can't be mapped.
+//
+static uint64_t *
+mapMmio(fpga_handle fpga_handle, uint32_t mmio_num)
+{
+    t_mmio_map *m = findMmioMap(fpga_handle, mmio_num);
+    if (m)
+    {
+        m->ref_cnt += 1;
+        return m->mmio_ptr;
+    }
+
+    // Free slot
+    for (int i = 0; (m == NULL) && (i < MAX_MMIO_MAPS); i += 1)
+    {
+        if (s_mmio_maps[i].ref_cnt == 0) m = &s_mmio_maps[i];
+    }
+    if (m == NULL) return NULL;
+
+    uint64_t *mmio_ptr;
+    if (fpgaMapMMIO(fpga_handle, mmio_num, &mmio_ptr) != FPGA_OK) return NULL;
+
+    m->fpga_handle = fpga_handle;
+    m->mmio_num = mmio_num;
+    m->mmio_ptr = mmio_ptr;
+    m->ref_cnt = 1;
+    return mmio_ptr;
+}
+
+static void
+unmapMmio(fpga_handle fpga_handle, uint32_t mmio_num)
+{
+    t_mmio_map *m = findMmioMap(fpga_handle, mmio_num);
+    if (m == NULL) return;
+
+    m->ref_cnt -= 1;
+    if (m->ref_cnt == 0)
+    {
+        fpgaUnmapMMIO(fpga_handle, mmio_num);
+    }
+}
+
 t_csr_handle_p
 csrAllocHandle(fpga_handle fpga_handle, uint32_t mmio_num)
+{
+    return csrAllocHandleMode(fpga_handle, mmio_num, CSR_MMIO_API);
+}
+
+t_csr_handle_p
+csrAllocHandleMode(fpga_handle fpga_handle, uint32_t mmio_num,
+                   t_csr_mmio_mode mode)
 {
     t_csr_handle* h = malloc(sizeof(t_csr_handle));
     if (h == NULL) return NULL;
 
     h->fpga_handle = fpga_handle;
     h->mmio_num = mmio_num;
+    h->mmio_ptr = NULL;
+    h->model = NULL;
+
+    if (mode == CSR_MMIO_DIRECT)
+    {
+        h->mmio_ptr = mapMmio(fpga_handle, mmio_num);
+    }
+
+    return h;
+}
+
+t_csr_handle_p
+csrAllocModelHandle(const t_csr_model *model)
+{
+    t_csr_handle* h = malloc(sizeof(t_csr_handle));
+    if (h == NULL) return NULL;
+
+    h->fpga_handle = NULL;
+    h->mmio_num = 0;
+    h->mmio_ptr = NULL;
+    h->model = model;
+
     return h;
 }
 
 fpga_result
 csrReleaseHandle(t_csr_handle_p csr_handle)
 {
+    if (csr_handle && csr_handle->mmio_ptr)
+    {
+        unmapMmio(csr_handle->fpga_handle, csr_handle->mmio_num);
+    }
+
     free((void*)csr_handle);
     return FPGA_OK;
 }
@@ -31,6 +143,14 @@ csrGetNumEngines(t_csr_handle_p csr_handle)
     return v & 0xff;
 }
 
+uint32_t
+csrGetPClkMHz(t_csr_handle_p csr_handle)
+{
+    if (! csr_handle) return 0;
+    uint64_t v = csrRead(csr_handle, CSR_RD_CTRL_CONFIG_INFO);
+    return (v >> 8) & 0xffff;
+}
+
 float
 csrGetClockMHz(t_csr_handle_p csr_handle)
 {
@@ -97,32 +217,162 @@ csrEngGlobWrite(t_csr_handle_p csr_handle, uint32_t idx, uint64_t value)
 }
 
 //
-// Read write the 16 private engine CSRs
+// Read the engine CSRs selected by csr_mask into csrs[idx].
 //
+static fpga_result
+engReadMasked(t_csr_handle_p csr_handle, uint64_t space, uint32_t eng_num,
+              uint16_t csr_mask, uint64_t *csrs)
+{
+    if (! csr_handle || (eng_num >= 64)) return FPGA_INVALID_PARAM;
+
+    uint64_t base = space | (eng_num << 4);
+
+    if (csr_handle->mmio_ptr)
+    {
+        volatile uint64_t *eng_csrs = csr_handle->mmio_ptr + base;
+        for (uint32_t idx = 0; idx < 16; idx += 1)
+        {
+            if (csr_mask & (1 << idx)) csrs[idx] = eng_csrs[idx];
+        }
+        return FPGA_OK;
+    }
+
+    if (csr_handle->model)
+    {
+        for (uint32_t idx = 0; idx < 16; idx += 1)
+        {
+            if (csr_mask & (1 << idx))
+            {
+                csrs[idx] = csr_handle->model->read(csr_handle->model->ctx, base + idx);
+            }
+        }
+        return FPGA_OK;
+    }
+
+    for (uint32_t idx = 0; idx < 16; idx += 1)
+    {
+        if (csr_mask & (1 << idx))
+        {
+            fpga_result r;
+            r = fpgaReadMMIO64(csr_handle->fpga_handle, csr_handle->mmio_num,
+                               (base + idx) * 8, &csrs[idx]);
+            if (r != FPGA_OK) return r;
+        }
+    }
+
+    return FPGA_OK;
+}
+
+fpga_result
+csrEngReadBlock(t_csr_handle_p csr_handle, uint32_t eng_num,
+                uint32_t first_idx, uint32_t num_csrs, uint64_t *values)
+{
+    if ((first_idx + num_csrs > 16) || (num_csrs == 0)) return FPGA_INVALID_PARAM;
+
+    uint64_t csrs[16];
+    uint16_t csr_mask = ((1 << num_csrs) - 1) << first_idx;
+    fpga_result r = engReadMasked(csr_handle, CSR_ENG_BASE, eng_num, csr_mask, csrs);
+    if (r != FPGA_OK) return r;
+
+    for (uint32_t i = 0; i < num_csrs; i += 1)
+    {
+        values[i] = csrs[first_idx + i];
+    }
+
+    return FPGA_OK;
+}
+
+fpga_result
+csrEngSnapshot(t_csr_handle_p csr_handle, uint32_t eng_num,
+               uint16_t csr_mask, t_csr_eng_snapshot *snapshot)
+{
+    snapshot->valid_mask = 0;
+    fpga_result r = engReadMasked(csr_handle, CSR_ENG_BASE, eng_num, csr_mask,
+                                  snapshot->csr);
+    if (r == FPGA_OK) snapshot->valid_mask = csr_mask;
+
+    return r;
+}
+
+fpga_result
+csrSnapshotEngines(t_csr_handle_p csr_handle, uint64_t engine_mask,
+                   uint16_t csr_mask, t_csr_eng_snapshot *snapshots)
+{
+    for (uint32_t e = 0; engine_mask; e += 1)
+    {
+        if (engine_mask & 1)
+        {
+            fpga_result r = csrEngSnapshot(csr_handle, e, csr_mask, &snapshots[e]);
+            if (r != FPGA_OK) return r;
+        }
+        engine_mask >>= 1;
+    }
+
+    return FPGA_OK;
+}
+
+fpga_result
+csrSnapshot(t_csr_handle_p csr_handle)
+{
+    if (! csr_handle) return FPGA_INVALID_PARAM;
+
+    // MMIO reads may pass the command write, so wait for the snapshot
+    // count to change. It takes only a few cycles.
+    uint64_t count = csrRead(csr_handle, CSR_RD_CTRL_SNAP_COUNT);
+
+    fpga_result r = csrWrite(csr_handle, CSR_WR_CTRL_SNAPSHOT, 0);
+    if (r != FPGA_OK) return r;
+
+    for (int trips = 0; trips < 100; trips += 1)
+    {
+        if (csrRead(csr_handle, CSR_RD_CTRL_SNAP_COUNT) != count) return FPGA_OK;
+    }
+
+    return FPGA_NOT_SUPPORTED;
+}
+
+uint64_t
+csrGetSnapshotClockCycles(t_csr_handle_p csr_handle)
+{
+    return csrRead(csr_handle, CSR_RD_CTRL_SNAP_CYCLES);
+}
+
 uint64_t
-csrEngRead(t_csr_handle_p csr_handle, uint32_t eng_num, uint32_t idx)
+csrGetSnapshotPClkCycles(t_csr_handle_p csr_handle)
 {
-    if ((eng_num > 64) || (idx > 16)) return -1;
+    return csrRead(csr_handle, CSR_RD_CTRL_SNAP_PCLK_CYCLES);
+}
+
+uint64_t
+csrEngSnapRead(t_csr_handle_p csr_handle, uint32_t eng_num, uint32_t idx)
+{
+    if ((eng_num >= 64) || (idx >= 16)) return -1;
     return csrRead(csr_handle,
-                   CSR_ENG_BASE | (eng_num << 4) | idx);
+                   CSR_ENG_SNAP_BASE | (eng_num << 4) | idx);
 }
 
 fpga_result
-csrEngWrite(t_csr_handle_p csr_handle, uint32_t eng_num, uint32_t idx,
-            uint64_t value)
+csrEngReadSnapshot(t_csr_handle_p csr_handle, uint32_t eng_num,
+                   uint16_t csr_mask, t_csr_eng_snapshot *snapshot)
 {
-    if ((eng_num > 64) || (idx > 16)) return -1;
-    return csrWrite(csr_handle,
-                    CSR_ENG_BASE | (eng_num << 4) | idx,
-                    value);
+    snapshot->valid_mask = 0;
+    fpga_result r = engReadMasked(csr_handle, CSR_ENG_SNAP_BASE, eng_num, csr_mask,
+                                  snapshot->csr);
+    if (r == FPGA_OK) snapshot->valid_mask = csr_mask;
+
+    return r;
 }
 
 uint64_t
-csrRead(t_csr_handle_p csr_handle, uint64_t idx)
+csrApiRead(t_csr_handle_p csr_handle, uint64_t idx)
 {
     fpga_result r;
     uint64_t v;
     if (! csr_handle) return -1;
+    if (csr_handle->model)
+    {
+        return csr_handle->model->read(csr_handle->model->ctx, idx);
+    }
 
     r = fpgaReadMMIO64(csr_handle->fpga_handle, csr_handle->mmio_num,
                        idx * 8, &v);
@@ -132,9 +382,15 @@ csrRead(t_csr_handle_p csr_handle, uint64_t idx)
 }
 
 fpga_result
-csrWrite(t_csr_handle_p csr_handle, uint64_t idx, uint64_t value)
+csrApiWrite(t_csr_handle_p csr_handle, uint64_t idx, uint64_t value)
 {
     if (! csr_handle) return FPGA_INVALID_PARAM;
+    if (csr_handle->model)
+    {
+        csr_handle->model->write(csr_handle->model->ctx, idx, value);
+        return FPGA_OK;
+    }
+
     return fpgaWriteMMIO64(csr_handle->fpga_handle, csr_handle->mmio_num,
                            idx * 8, value);
 }
@@ -23,31 +23,72 @@ typedef enum
     CSR_RD_CTRL_ENG_ACTIVE_MASK = 0x12,
     CSR_RD_CTRL_ENG_CYCLES = 0x13,
     CSR_RD_CTRL_ENG_PCLK_CYCLES = 0x14,
+    CSR_RD_CTRL_SNAP_CYCLES = 0x15,
+    CSR_RD_CTRL_SNAP_PCLK_CYCLES = 0x16,
+    CSR_RD_CTRL_SNAP_COUNT = 0x17,
     CSR_WR_CTRL_ENG_ENABLE_MASK = 0x10,
     CSR_WR_CTRL_ENG_DISABLE_MASK = 0x11,
+    CSR_WR_CTRL_SNAPSHOT = 0x12,
 
     CSR_ENG_GLOB_BASE = 0x020,
-    CSR_ENG_BASE = 0x400
+    CSR_ENG_BASE = 0x400,
+    CSR_ENG_SNAP_BASE = 0x800
 }
 t_csr_enum;
 
+typedef enum
+{
+    // All accesses go through fpgaReadMMIO64() and fpgaWriteMMIO64()
+    CSR_MMIO_API = 0,
+    // Map the MMIO space once and access CSRs with direct loads and
+    // stores. Falls back to CSR_MMIO_API when mapping isn't possible.
+    // Handles on the same region share one mapping, which is unmapped
+    // when the last of them is released.
+    // Not for ASE, where MMIO must be forwarded to the simulator.
+    CSR_MMIO_DIRECT = 1
+}
+t_csr_mmio_mode;
+
+//
+// CSR accesses may be directed to a software model of an AFU instead of
+// an FPGA. The model implements the whole MMIO space. Indices are in 64
+// bit words, as in csrRead().
+//
+typedef struct
+{
+    uint64_t (*read)(void *ctx, uint64_t idx);
+    void (*write)(void *ctx, uint64_t idx, uint64_t value);
+    void *ctx;
+}
+t_csr_model;
+
 typedef struct
 {
     fpga_handle fpga_handle;
     uint32_t mmio_num;
+    // Base of the mapped MMIO space, NULL when not using direct access
+    volatile uint64_t *mmio_ptr;
+    // Software model, NULL when connected to an FPGA
+    const t_csr_model *model;
 }
 t_csr_handle;
 
 typedef const t_csr_handle* t_csr_handle_p;
 
-// All the CSR calls expect a CSR handle
+// All the CSR calls expect a CSR handle. csrAllocHandle() uses CSR_MMIO_API.
 t_csr_handle_p csrAllocHandle(fpga_handle fpga_handle, uint32_t mmio_num);
+t_csr_handle_p csrAllocHandleMode(fpga_handle fpga_handle, uint32_t mmio_num,
+                                  t_csr_mmio_mode mode);
+// Handle for a software model. The model must outlive the handle.
+t_csr_handle_p csrAllocModelHandle(const t_csr_model *model);
 fpga_result csrReleaseHandle(t_csr_handle_p csr_handle);
 
 //
 // Various configuration details
 //
 uint32_t csrGetNumEngines(t_csr_handle_p csr_handle);
+// Frequency of the pClk reference clock, from the CSR manager's configuration
+uint32_t csrGetPClkMHz(t_csr_handle_p csr_handle);
 // This function computes the engine's clock frequency relative to the
 // known pClk reference. It can only be called after at least one engine
 // is enabled and then disabled. (This is because it depends on the engine
@@ -75,18 +116,103 @@ uint64_t csrEngGlobRead(t_csr_handle_p csr_handle, uint32_t idx);
 fpga_result csrEngGlobWrite(t_csr_handle_p csr_handle, uint32_t idx, uint64_t value);
 
 //
-// Read write the 16 private engine CSRs
+// Generic CSR read/write through the OPAE MMIO API, independent of the
+// handle's mode. Model handles call the model.
 //
-uint64_t csrEngRead(t_csr_handle_p csr_handle, uint32_t eng_num, uint32_t idx);
-fpga_result csrEngWrite(t_csr_handle_p csr_handle, uint32_t eng_num, uint32_t idx,
-                        uint64_t value);
+uint64_t csrApiRead(t_csr_handle_p csr_handle, uint64_t idx);
+fpga_result csrApiWrite(t_csr_handle_p csr_handle, uint64_t idx, uint64_t value);
 
 //
 // Generic CSR read/write (index is in 64 bit data space, so index 1 is byte
-// address 8).
+// address 8). These are used in polling loops, so they are inline and
+// become a single load or store in CSR_MMIO_DIRECT mode.
+//
+static inline uint64_t
+csrRead(t_csr_handle_p csr_handle, uint64_t idx)
+{
+    if (csr_handle && csr_handle->mmio_ptr) return csr_handle->mmio_ptr[idx];
+    return csrApiRead(csr_handle, idx);
+}
+
+static inline fpga_result
+csrWrite(t_csr_handle_p csr_handle, uint64_t idx, uint64_t value)
+{
+    if (csr_handle && csr_handle->mmio_ptr)
+    {
+        csr_handle->mmio_ptr[idx] = value;
+        return FPGA_OK;
+    }
+    return csrApiWrite(csr_handle, idx, value);
+}
+
+//
+// Read write the 16 private engine CSRs
+//
+static inline uint64_t
+csrEngRead(t_csr_handle_p csr_handle, uint32_t eng_num, uint32_t idx)
+{
+    if ((eng_num > 64) || (idx > 16)) return -1;
+    return csrRead(csr_handle,
+                   CSR_ENG_BASE | (eng_num << 4) | idx);
+}
+
+static inline fpga_result
+csrEngWrite(t_csr_handle_p csr_handle, uint32_t eng_num, uint32_t idx,
+            uint64_t value)
+{
+    if ((eng_num > 64) || (idx > 16)) return -1;
+    return csrWrite(csr_handle,
+                    CSR_ENG_BASE | (eng_num << 4) | idx,
+                    value);
+}
+
+//
+// Batched engine CSR reads. Reading a set of CSRs in one call avoids
+// per-access overhead and keeps the values of an engine's counters
+// together. Reads are 64 bits -- the CSR manager's read data path is
+// no wider.
+//
+typedef struct
+{
+    // Bit i is set when csr[i] was read
+    uint16_t valid_mask;
+    uint64_t csr[16];
+}
+t_csr_eng_snapshot;
+
+// Read num_csrs consecutive private CSRs of an engine, starting at first_idx.
+fpga_result csrEngReadBlock(t_csr_handle_p csr_handle, uint32_t eng_num,
+                            uint32_t first_idx, uint32_t num_csrs,
+                            uint64_t *values);
+
+// Read the private CSRs of one engine selected by csr_mask.
+fpga_result csrEngSnapshot(t_csr_handle_p csr_handle, uint32_t eng_num,
+                           uint16_t csr_mask, t_csr_eng_snapshot *snapshot);
+
+// Snapshot each engine in engine_mask. snapshots is indexed by engine number.
+fpga_result csrSnapshotEngines(t_csr_handle_p csr_handle, uint64_t engine_mask,
+                               uint16_t csr_mask, t_csr_eng_snapshot *snapshots);
+
+//
+// Hardware snapshot. csrSnapshot() tells the CSR manager to record every
+// engine's CSRs and the execution cycle counters in the same cycle, without
+// stopping the engines, and waits for the snapshot to complete. The recorded
+// values stay readable until the next snapshot. FPGA_NOT_SUPPORTED is
+// returned by AFUs built before the snapshot command was added and when
+// the CSR manager is busy starting engines. AFUs record only the engine
+// CSRs their software reads (the CSR manager's SNAPSHOT_CSR_MASK). Other
+// recorded engine CSRs read as 0.
 //
-uint64_t csrRead(t_csr_handle_p csr_handle, uint64_t idx);
-fpga_result csrWrite(t_csr_handle_p csr_handle, uint64_t idx, uint64_t value);
+fpga_result csrSnapshot(t_csr_handle_p csr_handle);
+// Engine execution cycles at the last snapshot, in the engine clock domain
+// and in the pClk domain.
+uint64_t csrGetSnapshotClockCycles(t_csr_handle_p csr_handle);
+uint64_t csrGetSnapshotPClkCycles(t_csr_handle_p csr_handle);
+// Read one recorded engine CSR
+uint64_t csrEngSnapRead(t_csr_handle_p csr_handle, uint32_t eng_num, uint32_t idx);
+// Read the recorded engine CSRs selected by csr_mask
+fpga_result csrEngReadSnapshot(t_csr_handle_p csr_handle, uint32_t eng_num,
+                               uint16_t csr_mask, t_csr_eng_snapshot *snapshot);
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,83 @@
+// Copyright (C) 2022 Intel Corporation
+// SPDX-License-Identifier: MIT
+
+#include <assert.h>
+#include <stdbool.h>
+#include <time.h>
+
+#include "eng_wait.h"
+
+// Spin on the CSRs this long before backing off
+#define SPIN_NS 10000
+// First backoff interval
+#define MIN_POLL_NS 1000
+#define DEFAULT_MAX_POLL_NS 1000000
+
+static uint64_t s_max_poll_ns;
+
+
+static uint64_t
+nowNs(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * (uint64_t)1000000000 + ts.tv_nsec;
+}
+
+
+static bool
+condHolds(t_csr_handle_p csr_handle, t_eng_wait_cond cond)
+{
+    switch (cond)
+    {
+      case ENG_WAIT_STARTED:
+        return (csrGetEnginesEnabled(csr_handle) != 0);
+      case ENG_WAIT_DONE:
+        return (csrGetEnginesEnabled(csr_handle) != 0) &&
+               (csrGetEnginesActive(csr_handle) == 0);
+      default:
+        return (csrGetEnginesActive(csr_handle) == 0);
+    }
+}
+
+
+int
+engWait(
+    t_csr_handle_p csr_handle,
+    t_eng_wait_cond cond,
+    uint64_t timeout_ns)
+{
+    uint64_t max_poll_ns = s_max_poll_ns ? s_max_poll_ns : DEFAULT_MAX_POLL_NS;
+    uint64_t start_ns = nowNs();
+    uint64_t poll_ns = MIN_POLL_NS;
+
+    while (true)
+    {
+        if (condHolds(csr_handle, cond)) return 0;
+
+        uint64_t elapsed_ns = nowNs() - start_ns;
+        if (timeout_ns && (elapsed_ns >= timeout_ns)) return 1;
+
+        if (elapsed_ns < SPIN_NS) continue;
+
+        uint64_t wait_ns = poll_ns;
+        poll_ns = (poll_ns * 2 < max_poll_ns) ? poll_ns * 2 : max_poll_ns;
+
+        if (timeout_ns && (wait_ns > timeout_ns - elapsed_ns))
+        {
+            wait_ns = timeout_ns - elapsed_ns;
+        }
+
+        struct timespec ts;
+        ts.tv_sec = wait_ns / 1000000000;
+        ts.tv_nsec = wait_ns % 1000000000;
+        nanosleep(&ts, NULL);
+    }
+}
+
+
+void
+engWaitSetMaxPollNs(uint64_t max_poll_ns)
+{
+    s_max_poll_ns = max_poll_ns;
+}
@@ -0,0 +1,61 @@
+// Copyright (C) 2022 Intel Corporation
+// SPDX-License-Identifier: MIT
+
+//
+// Wait for test engines to start or finish.
+//
+// Engine state is read from the CSR manager's run and active masks. The
+// masks are polled with an adaptive backoff: the first few microseconds
+// spin on the CSRs, then the interval between reads doubles up to a limit.
+// Short runs are noticed within microseconds and long runs don't flood the
+// MMIO path.
+//
+// Waits never sleep on an interrupt. The test engines don't raise one when
+// they finish. An AFU that does could register it as host_chan_intr does,
+// with fpgaRegisterEvent(), and poll() its event handle between reads.
+//
+
+#ifndef __ENG_WAIT_H__
+#define __ENG_WAIT_H__
+
+#include <stdint.h>
+
+#include "csr_mgr.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+typedef enum
+{
+    // Some engine is enabled
+    ENG_WAIT_STARTED = 0,
+    // Some engine is enabled and no engine is active. Checking the enable
+    // mask resolves the race between the request to start an engine and
+    // the engine's active flag going high.
+    ENG_WAIT_DONE,
+    // No engine is active, e.g. after engines are disabled
+    ENG_WAIT_IDLE
+}
+t_eng_wait_cond;
+
+//
+// Wait until cond holds for the engines behind csr_handle. Returns 0 when
+// it holds and 1 if timeout_ns passes first. A timeout_ns of 0 waits
+// forever.
+//
+int engWait(t_csr_handle_p csr_handle, t_eng_wait_cond cond,
+            uint64_t timeout_ns);
+
+//
+// Limit the interval between CSR reads when polling. Simulation should pass
+// a large value, since each MMIO read is slow there. 0 restores the default
+// (1ms).
+//
+void engWaitSetMaxPollNs(uint64_t max_poll_ns);
+
+#ifdef __cplusplus
+}
+#endif
+#endif // __ENG_WAIT_H__
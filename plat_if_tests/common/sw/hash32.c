@@ -1,11 +1,200 @@
 // Copyright (C) 2022 Intel Corporation
 // SPDX-License-Identifier: MIT
 
+#include <stdbool.h>
+#include <stdio.h>
+
 #include "hash32.h"
 
+#ifdef __x86_64__
+#include <wmmintrin.h>
+#endif
+
 const uint32_t HASH32_DEFAULT_INIT = 0x14d6;
 
-uint32_t hash32(uint32_t cur_hash, uint32_t data)
+// Multiplying by x^32 mod P, split into tables indexed by each byte of the
+// multiplicand. Generated from HASH32_POLY at startup.
+static uint32_t s_mul_x32_tbl[4][256];
+
+// x^(2^k) mod P, used for jumping ahead.
+static uint32_t s_x2n_tbl[64];
+
+static uint32_t (*s_mul_mod_p)(uint32_t a, uint32_t b);
+
+
+//
+// Multiply the state by x mod P. This is the RTL shift without new data.
+//
+static inline uint32_t
+hash32Shift(uint32_t cur_hash)
+{
+    return (cur_hash >> 1) ^ ((0 - (cur_hash & 1)) & HASH32_POLY);
+}
+
+static inline uint32_t
+mulX32(uint32_t v)
+{
+    return s_mul_x32_tbl[0][v & 0xff] ^
+           s_mul_x32_tbl[1][(v >> 8) & 0xff] ^
+           s_mul_x32_tbl[2][(v >> 16) & 0xff] ^
+           s_mul_x32_tbl[3][v >> 24];
+}
+
+
+//
+// Multiply a * b mod P. In this bit order x^0 is (1 << 31).
+//
+static uint32_t
+mulModPSw(uint32_t a, uint32_t b)
+{
+    uint32_t m = (uint32_t)1 << 31;
+    uint32_t p = 0;
+
+    if (a == 0) return 0;
+
+    while (true)
+    {
+        if (a & m)
+        {
+            p ^= b;
+            if ((a & (m - 1)) == 0) break;
+        }
+        m >>= 1;
+        b = hash32Shift(b);
+    }
+
+    return p;
+}
+
+#ifdef __x86_64__
+__attribute__((target("pclmul")))
+static uint32_t
+mulModPClmul(uint32_t a, uint32_t b)
+{
+    __m128i p = _mm_clmulepi64_si128(_mm_cvtsi32_si128(a),
+                                     _mm_cvtsi32_si128(b), 0);
+
+    // The 63 bit product is reflected. Shifting left by one puts x^0 in
+    // bit 63. The high half is then already reduced and the low half holds
+    // the coefficients of x^32 and above.
+    uint64_t c = (uint64_t)_mm_cvtsi128_si64(p) << 1;
+    return (uint32_t)(c >> 32) ^ mulX32((uint32_t)c);
+}
+#endif
+
+
+__attribute__((constructor))
+static void
+hash32Init(void)
+{
+    for (int j = 0; j < 4; j += 1)
+    {
+        for (uint32_t b = 0; b < 256; b += 1)
+        {
+            uint32_t v = b << (8 * j);
+            for (int i = 0; i < 32; i += 1)
+            {
+                v = hash32Shift(v);
+            }
+            s_mul_x32_tbl[j][b] = v;
+        }
+    }
+
+    s_mul_mod_p = mulModPSw;
+#ifdef __x86_64__
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("pclmul"))
+    {
+        s_mul_mod_p = mulModPClmul;
+    }
+#endif
+
+    // x^1
+    s_x2n_tbl[0] = (uint32_t)1 << 30;
+    for (int k = 1; k < 64; k += 1)
+    {
+        s_x2n_tbl[k] = s_mul_mod_p(s_x2n_tbl[k-1], s_x2n_tbl[k-1]);
+    }
+}
+
+
+uint32_t
+hash32(uint32_t cur_hash, uint32_t data)
+{
+    return hash32Shift(cur_hash) ^ data;
+}
+
+
+uint32_t
+hash32Stream(uint32_t cur_hash, const uint32_t *data, size_t num_words)
+{
+    // Blocks of 32 values are accumulated without reduction in a 64 bit
+    // value. Value i in the block is multiplied by x^(31-i), which is
+    // just a shift. The low 32 bits, holding x^32 and above, are reduced
+    // once per block.
+    while (num_words >= 32)
+    {
+        uint64_t acc = cur_hash;
+        for (int i = 0; i < 32; i += 1)
+        {
+            acc ^= ((uint64_t)data[i] << 32) >> (31 - i);
+        }
+        cur_hash = (uint32_t)(acc >> 32) ^ mulX32((uint32_t)acc);
+
+        data += 32;
+        num_words -= 32;
+    }
+
+    while (num_words--)
+    {
+        cur_hash = hash32(cur_hash, *data++);
+    }
+
+    return cur_hash;
+}
+
+
+uint32_t
+hash32Advance(uint32_t cur_hash, uint64_t num_steps)
+{
+    return s_mul_mod_p(hash32PowX(num_steps), cur_hash);
+}
+
+
+uint32_t
+hash32Combine(uint32_t hash_a, uint32_t hash_b, uint64_t len_b)
+{
+    return hash32Advance(hash_a, len_b) ^ hash_b;
+}
+
+
+uint32_t
+hash32MulModP(uint32_t a, uint32_t b)
+{
+    return s_mul_mod_p(a, b);
+}
+
+
+uint32_t
+hash32PowX(uint64_t n)
+{
+    // Compute x^n mod P from the table of powers of 2
+    uint32_t x_n = (uint32_t)1 << 31;
+    for (int k = 0; n; k += 1)
+    {
+        if (n & 1)
+        {
+            x_n = s_mul_mod_p(s_x2n_tbl[k], x_n);
+        }
+        n >>= 1;
+    }
+
+    return x_n;
+}
+
+
+uint32_t
+hash32Ref(uint32_t cur_hash, uint32_t data)
 {
     // Burst bits into individual buckets
     uint8_t value[32], new_data[32], new_value[32];
@@ -61,3 +250,142 @@ uint32_t hash32(uint32_t cur_hash, uint32_t data)
 
     return new_hash;
 }
+
+
+//
+// xorshift32, for self-check inputs
+//
+static uint32_t
+nextRand(uint32_t *state)
+{
+    uint32_t x = *state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    *state = x;
+    return x;
+}
+
+//
+// hash32Advance() using a specific multiply
+//
+static uint32_t
+advanceWith(uint32_t (*mul)(uint32_t a, uint32_t b), uint32_t cur_hash,
+            uint64_t num_steps)
+{
+    uint32_t x_n = (uint32_t)1 << 31;
+    for (int k = 0; num_steps; k += 1)
+    {
+        if (num_steps & 1)
+        {
+            x_n = mul(s_x2n_tbl[k], x_n);
+        }
+        num_steps >>= 1;
+    }
+
+    return mul(x_n, cur_hash);
+}
+
+
+uint32_t
+hash32SelfCheck(uint32_t seed, uint32_t num_trials)
+{
+    uint32_t (*muls[2])(uint32_t a, uint32_t b);
+    const char *mul_names[2] = { "table", "pclmul" };
+    int num_muls = 1;
+    muls[0] = mulModPSw;
+#ifdef __x86_64__
+    if (__builtin_cpu_supports("pclmul"))
+    {
+        muls[1] = mulModPClmul;
+        num_muls = 2;
+    }
+#endif
+
+    uint32_t rand_state = seed ? seed : 1;
+    uint32_t errors = 0;
+    uint32_t data[256];
+
+    for (uint32_t t = 0; t < num_trials; t += 1)
+    {
+        uint32_t h = nextRand(&rand_state);
+
+        // Single updates and streams of arbitrary length
+        size_t num_words = nextRand(&rand_state) % 256;
+        uint32_t ref = h;
+        for (size_t i = 0; i < num_words; i += 1)
+        {
+            data[i] = nextRand(&rand_state);
+            if (hash32(ref, data[i]) != hash32Ref(ref, data[i])) errors += 1;
+            ref = hash32Ref(ref, data[i]);
+        }
+        uint32_t stream = hash32Stream(h, data, num_words);
+        if (stream != ref)
+        {
+            fprintf(stderr, "hash32Stream(0x%08x, %ld words): 0x%08x, expected 0x%08x\n",
+                    h, num_words, stream, ref);
+            errors += 1;
+        }
+
+        // Combining the hashes of the two halves
+        size_t split = num_words / 2;
+        uint32_t comb = hash32Combine(hash32Stream(h, data, split),
+                                      hash32Stream(0, data + split, num_words - split),
+                                      num_words - split);
+        if (comb != ref)
+        {
+            fprintf(stderr, "hash32Combine(%ld + %ld words): 0x%08x, expected 0x%08x\n",
+                    split, num_words - split, comb, ref);
+            errors += 1;
+        }
+
+        // Jumps short enough to step through one update at a time
+        uint64_t n = nextRand(&rand_state) % 4096;
+        ref = h;
+        for (uint64_t i = 0; i < n; i += 1)
+        {
+            ref = hash32Ref(ref, 0);
+        }
+
+        // Long jumps are checked by splitting them in two
+        uint64_t n_a = ((uint64_t)nextRand(&rand_state) << 32) | nextRand(&rand_state);
+        uint64_t n_b = nextRand(&rand_state);
+        n_a >>= 1;
+
+        for (int m = 0; m < num_muls; m += 1)
+        {
+            uint32_t adv = advanceWith(muls[m], h, n);
+            if (adv != ref)
+            {
+                fprintf(stderr, "hash32Advance(0x%08x, %ld) %s: 0x%08x, expected 0x%08x\n",
+                        h, n, mul_names[m], adv, ref);
+                errors += 1;
+            }
+
+            uint32_t adv_ab = advanceWith(muls[m], h, n_a + n_b);
+            uint32_t adv_a_b = advanceWith(muls[m], advanceWith(muls[m], h, n_a), n_b);
+            if (adv_ab != adv_a_b)
+            {
+                fprintf(stderr, "hash32Advance(0x%08x, %ld + %ld) %s: 0x%08x, expected 0x%08x\n",
+                        h, n_a, n_b, mul_names[m], adv_ab, adv_a_b);
+                errors += 1;
+            }
+        }
+
+        // Both multiplies must agree with each other and with the
+        // exported, dispatched version
+        uint32_t a = nextRand(&rand_state);
+        uint32_t b = nextRand(&rand_state);
+        for (int m = 0; m < num_muls; m += 1)
+        {
+            if (muls[m](a, b) != hash32MulModP(a, b))
+            {
+                fprintf(stderr, "hash32MulModP(0x%08x, 0x%08x) %s: 0x%08x, expected 0x%08x\n",
+                        a, b, mul_names[m], muls[m](a, b), hash32MulModP(a, b));
+                errors += 1;
+            }
+        }
+    }
+
+    return errors;
+}
@@ -4,6 +4,7 @@
 #ifndef __HASH32_H__
 #define __HASH32_H__
 
+#include <stddef.h>
 #include <stdint.h>
 
 #ifdef __cplusplus
@@ -13,9 +14,54 @@ extern "C"
 
 extern const uint32_t HASH32_DEFAULT_INIT;
 
-// This code matches the hash32 RTL. It isn't fast.
+//
+// The hash32 RTL is a Galois LFSR that shifts right one bit per update
+// and XORs new data into the shifted state. Viewed as a polynomial with
+// bit i holding the coefficient of x^(31-i), each update multiplies the
+// state by x modulo
+//
+//   P(x) = x^32 + x^31 + x^30 + x^29 + x^27 + x^25 + 1
+//
+// and adds the new data. All the functions below are bit-exact with the
+// RTL. They are linear over GF(2), which is what makes hash32Stream()
+// and hash32Advance() possible.
+//
+#define HASH32_POLY 0x80000057
+
+// One hash update, equivalent to one enabled cycle of the RTL.
 uint32_t hash32(uint32_t cur_hash, uint32_t data);
 
+// Bit-by-bit transcription of the RTL. Slow. It is kept as the reference
+// for validating the faster implementations.
+uint32_t hash32Ref(uint32_t cur_hash, uint32_t data);
+
+// Hash a sequence of num_words values, in order, into a single hash.
+// Equivalent to calling hash32() on each value.
+uint32_t hash32Stream(uint32_t cur_hash, const uint32_t *data, size_t num_words);
+
+// Advance the hash num_steps updates with zero data. Computed in
+// O(log num_steps) time.
+uint32_t hash32Advance(uint32_t cur_hash, uint64_t num_steps);
+
+// Hash of sequence A followed by sequence B, given hash_a (the hash of A
+// from any initial state) and hash_b (the hash of B starting from 0).
+// Independent chunks of a long stream can be hashed in parallel and then
+// combined in order.
+uint32_t hash32Combine(uint32_t hash_a, uint32_t hash_b, uint64_t len_b);
+
+// Polynomial arithmetic mod P on hash values, for composing jumps.
+// hash32Advance(h, n) is hash32MulModP(hash32PowX(n), h). The polynomial
+// 1 is (1 << 31).
+uint32_t hash32MulModP(uint32_t a, uint32_t b);
+uint32_t hash32PowX(uint64_t n);
+
+// Check hash32(), hash32Stream(), hash32Advance() and hash32Combine()
+// against hash32Ref() on num_trials pseudo-random inputs and jump lengths.
+// Jumps are checked with both the table driven multiply and, when the CPU
+// supports it, PCLMULQDQ. Mismatches are printed on stderr. Returns the
+// number of mismatches.
+uint32_t hash32SelfCheck(uint32_t seed, uint32_t num_trials);
+
 #ifdef __cplusplus
 }
 #endif
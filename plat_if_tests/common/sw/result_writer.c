@@ -0,0 +1,322 @@
+// Copyright (C) 2022 Intel Corporation
+// SPDX-License-Identifier: MIT
+
+#include <assert.h>
+#include <inttypes.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "result_writer.h"
+
+#define MAX_FIELDS 64
+#define MAX_CSV_KEYS 256
+#define MAX_KEY_BYTES 32
+#define MAX_VALUE_BYTES 128
+
+typedef struct
+{
+    char key[MAX_KEY_BYTES];
+    // Value formatted for output. Strings are quoted when written.
+    char value[MAX_VALUE_BYTES];
+    bool is_string;
+}
+t_result_field;
+
+static const char *s_opt_path;
+static FILE *s_file;
+static bool s_csv;
+static char s_test_name[MAX_VALUE_BYTES];
+
+// Record being built
+static bool s_in_record;
+static uint32_t s_num_fields;
+static t_result_field s_fields[MAX_FIELDS];
+
+// CSV header row: the union of all records' keys, in order of first use.
+// s_csv_hdr_bytes is the length of the header row in the file.
+static uint32_t s_num_csv_keys;
+static char s_csv_keys[MAX_CSV_KEYS][MAX_KEY_BYTES];
+static long s_csv_hdr_bytes;
+
+
+int
+resultOpen(const char *path, const char *test_name)
+{
+    resultClose();
+
+    size_t len = strlen(path);
+    s_csv = (len >= 4) && (0 == strcmp(path + len - 4, ".csv"));
+
+    // CSV rows are read back when the header grows
+    s_file = fopen(path, s_csv ? "w+" : "w");
+    if (NULL == s_file) return -1;
+
+    snprintf(s_test_name, sizeof(s_test_name), "%s", test_name);
+    s_num_csv_keys = 0;
+    s_csv_hdr_bytes = 0;
+    s_in_record = false;
+
+    return 0;
+}
+
+
+void
+resultParseOpt(const char *arg)
+{
+    s_opt_path = arg;
+}
+
+
+int
+resultOpenOpt(const char *test_name)
+{
+    if (NULL == s_opt_path) return 0;
+
+    if (resultOpen(s_opt_path, test_name))
+    {
+        fprintf(stderr, "Failed to open result file: %s\n", s_opt_path);
+        return -1;
+    }
+
+    return 0;
+}
+
+
+void
+resultClose(void)
+{
+    if (s_file)
+    {
+        fclose(s_file);
+        s_file = NULL;
+    }
+}
+
+
+bool
+resultIsOpen(void)
+{
+    return (NULL != s_file);
+}
+
+
+static t_result_field *
+newField(const char *key, bool is_string)
+{
+    if (! s_file) return NULL;
+    assert(s_in_record);
+    assert(s_num_fields < MAX_FIELDS);
+
+    t_result_field *f = &s_fields[s_num_fields++];
+    snprintf(f->key, sizeof(f->key), "%s", key);
+    f->is_string = is_string;
+    return f;
+}
+
+
+void
+resultBegin(const char *record_type)
+{
+    if (! s_file) return;
+    assert(! s_in_record);
+
+    s_in_record = true;
+    s_num_fields = 0;
+    resultStr("test", s_test_name);
+    resultStr("record", record_type);
+}
+
+
+void
+resultInt(const char *key, int64_t value)
+{
+    t_result_field *f = newField(key, false);
+    if (f) snprintf(f->value, sizeof(f->value), "%" PRId64, value);
+}
+
+
+void
+resultDouble(const char *key, double value)
+{
+    t_result_field *f = newField(key, false);
+    if (! f) return;
+
+    if (isfinite(value))
+        snprintf(f->value, sizeof(f->value), "%.6g", value);
+    else
+        snprintf(f->value, sizeof(f->value), "%s", s_csv ? "" : "null");
+}
+
+
+void
+resultStr(const char *key, const char *value)
+{
+    t_result_field *f = newField(key, true);
+    if (f) snprintf(f->value, sizeof(f->value), "%s", value);
+}
+
+
+void
+resultBool(const char *key, bool value)
+{
+    t_result_field *f = newField(key, false);
+    if (f) snprintf(f->value, sizeof(f->value), "%s", value ? "true" : "false");
+}
+
+
+//
+// Write a string, quoted and escaped for JSON or CSV.
+//
+static void
+writeQuoted(const char *s)
+{
+    fputc('"', s_file);
+    for (; *s; s += 1)
+    {
+        if (s_csv)
+        {
+            // CSV doubles embedded quotes
+            if (*s == '"') fputc('"', s_file);
+            fputc(*s, s_file);
+        }
+        else if ((*s == '"') || (*s == '\\'))
+        {
+            fprintf(s_file, "\\%c", *s);
+        }
+        else if ((unsigned char)*s < 0x20)
+        {
+            fprintf(s_file, "\\u%04x", *s);
+        }
+        else
+        {
+            fputc(*s, s_file);
+        }
+    }
+    fputc('"', s_file);
+}
+
+
+//
+// Rewrite the CSV header row after keys were added. Rows already written
+// end at the old header's last column. New keys are appended, so the rows
+// are completed with empty columns.
+//
+static void
+writeCsvHeader(uint32_t num_old_keys)
+{
+    fseek(s_file, 0, SEEK_END);
+    size_t row_bytes = ftell(s_file) - s_csv_hdr_bytes;
+    char *rows = malloc(row_bytes + 1);
+    assert(NULL != rows);
+
+    fseek(s_file, s_csv_hdr_bytes, SEEK_SET);
+    size_t n = fread(rows, 1, row_bytes, s_file);
+    assert(n == row_bytes);
+
+    rewind(s_file);
+    for (uint32_t i = 0; i < s_num_csv_keys; i += 1)
+    {
+        fprintf(s_file, "%s%s", i ? "," : "", s_csv_keys[i]);
+    }
+    fprintf(s_file, "\n");
+    s_csv_hdr_bytes = ftell(s_file);
+
+    char *line = rows;
+    while (line < rows + row_bytes)
+    {
+        char *eol = memchr(line, '\n', rows + row_bytes - line);
+        assert(NULL != eol);
+
+        fwrite(line, 1, eol - line, s_file);
+        for (uint32_t i = num_old_keys; i < s_num_csv_keys; i += 1)
+        {
+            fputc(',', s_file);
+        }
+        fputc('\n', s_file);
+
+        line = eol + 1;
+    }
+
+    free(rows);
+}
+
+
+static void
+writeCsvRecord(void)
+{
+    // Add the record's new keys to the header
+    uint32_t num_old_keys = s_num_csv_keys;
+    for (uint32_t i = 0; i < s_num_fields; i += 1)
+    {
+        uint32_t k = 0;
+        while ((k < s_num_csv_keys) && strcmp(s_fields[i].key, s_csv_keys[k]))
+            k += 1;
+
+        if (k == s_num_csv_keys)
+        {
+            assert(s_num_csv_keys < MAX_CSV_KEYS);
+            strcpy(s_csv_keys[s_num_csv_keys++], s_fields[i].key);
+        }
+    }
+
+    if (s_num_csv_keys != num_old_keys)
+    {
+        writeCsvHeader(num_old_keys);
+    }
+
+    // One column per header key. Keys the record doesn't have are empty.
+    for (uint32_t k = 0; k < s_num_csv_keys; k += 1)
+    {
+        if (k) fputc(',', s_file);
+
+        for (uint32_t i = 0; i < s_num_fields; i += 1)
+        {
+            if (0 == strcmp(s_fields[i].key, s_csv_keys[k]))
+            {
+                if (s_fields[i].is_string)
+                    writeQuoted(s_fields[i].value);
+                else
+                    fprintf(s_file, "%s", s_fields[i].value);
+                break;
+            }
+        }
+    }
+    fprintf(s_file, "\n");
+}
+
+
+static void
+writeJsonRecord(void)
+{
+    fputc('{', s_file);
+    for (uint32_t i = 0; i < s_num_fields; i += 1)
+    {
+        if (i) fprintf(s_file, ", ");
+        writeQuoted(s_fields[i].key);
+        fprintf(s_file, ": ");
+        if (s_fields[i].is_string)
+            writeQuoted(s_fields[i].value);
+        else
+            fprintf(s_file, "%s", s_fields[i].value);
+    }
+    fprintf(s_file, "}\n");
+}
+
+
+void
+resultEnd(void)
+{
+    if (! s_file) return;
+    assert(s_in_record);
+
+    if (s_csv)
+        writeCsvRecord();
+    else
+        writeJsonRecord();
+
+    // Keep the file complete if the test exits on an error
+    fflush(s_file);
+    s_in_record = false;
+}
@@ -0,0 +1,67 @@
+// Copyright (C) 2022 Intel Corporation
+// SPDX-License-Identifier: MIT
+
+//
+// Machine-readable test results. Tests emit one record per measured
+// configuration or checked case, in addition to their normal output.
+// Records are written as JSON lines, or as CSV when the result file name
+// ends in ".csv".
+//
+// A record is built with resultBegin(), one call per field and then
+// resultEnd(). Every record starts with the test name and the record type.
+// In CSV, one header row holds the union of all records' fields. A record
+// leaves the columns of fields it lacks empty.
+//
+// All calls are no-ops until resultOpen() succeeds, so tests may emit
+// records unconditionally. The writer is not thread safe.
+//
+
+#ifndef __RESULT_WRITER_H__
+#define __RESULT_WRITER_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+// Open (truncate) path for results. Returns 0 on success.
+int resultOpen(const char *path, const char *test_name);
+
+//
+// The --results=<file> command line option. Programs add RESULT_LONGOPT to
+// their getopt_long() table and RESULT_OPT_HELP to their help text, pass
+// the option's argument to resultParseOpt() and call resultOpenOpt() after
+// parsing.
+//
+#define RESULT_OPT 0x100
+#define RESULT_LONGOPT { "results", required_argument, NULL, RESULT_OPT }
+#define RESULT_OPT_HELP \
+    "        --results           Write machine-readable results to <file>, as\n" \
+    "                            JSON lines or as CSV if <file> ends in .csv.\n"
+
+void resultParseOpt(const char *arg);
+
+// Open the --results file, if one was given. Returns 0 on success.
+int resultOpenOpt(const char *test_name);
+
+// Flush and close the result file.
+void resultClose(void);
+
+// Is a result file open?
+bool resultIsOpen(void);
+
+void resultBegin(const char *record_type);
+void resultInt(const char *key, int64_t value);
+// NaN and infinite values are written as null (JSON) or empty (CSV).
+void resultDouble(const char *key, double value);
+void resultStr(const char *key, const char *value);
+void resultBool(const char *key, bool value);
+void resultEnd(void);
+
+#ifdef __cplusplus
+}
+#endif
+#endif // __RESULT_WRITER_H__
@@ -6,12 +6,25 @@
 //
 
 #include <assert.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
+#ifdef __x86_64__
+#include <immintrin.h>
+#endif
+
 #include "test_data.h"
 #include "hash32.h"
 
+//
+// Vector length specific implementations of testDataGenNext() and
+// testDataChkNext() are selected at startup, depending on CPU features.
+//
+static void (*s_gen_next)(size_t byte_len, uint64_t seed, uint64_t *data);
+static void (*s_chk_next)(size_t byte_len, uint32_t *hash_buckets,
+                          const uint32_t *data32);
+
 static void
 assert_valid_len(size_t byte_len)
 {
@@ -21,7 +34,219 @@ assert_valid_len(size_t byte_len)
     // Size must be at least 8 bytes
     assert(byte_len >= 8);
 }
-    
+
+static inline uint64_t
+rotateLeft64(uint64_t v, uint32_t r)
+{
+    r &= 63;
+    return (v << r) | (v >> ((64 - r) & 63));
+}
+
+
+// ========================================================================
+//
+//  Scalar and SIMD kernels. Each 64 bit data word and each 32 bit hash
+//  bucket is independent, so the vector versions simply operate on as
+//  many as fit in a register. The SIMD kernels handle whole vectors and
+//  pass any remainder to the scalar kernels.
+//
+// ========================================================================
+
+static void
+genNextScalar(size_t byte_len, uint64_t seed, uint64_t *data)
+{
+    // Each 64 bit entry is rotated one byte left and XOR the seed in
+    for (size_t i = 0; i < (byte_len / 8); i += 1)
+    {
+        data[i] = (data[i] << 8) | (data[i] >> 56);
+        data[i] ^= seed;
+        seed = (seed << 1) | (seed >> 63);
+    }
+}
+
+static void
+chkNextScalar(size_t byte_len, uint32_t *hash_buckets, const uint32_t *data32)
+{
+    for (size_t i = 0; i < (byte_len / 4); i += 1)
+    {
+        hash_buckets[i] = hash32(hash_buckets[i], data32[i]);
+    }
+}
+
+#ifdef __x86_64__
+
+__attribute__((target("sse4.2")))
+static void
+genNextSse(size_t byte_len, uint64_t seed, uint64_t *data)
+{
+    size_t n = byte_len / 8;
+    size_t i = 0;
+
+    // Rotate each 64 bit word left one byte
+    const __m128i rot8 = _mm_set_epi8(14, 13, 12, 11, 10, 9, 8, 15,
+                                      6, 5, 4, 3, 2, 1, 0, 7);
+    __m128i sv = _mm_set_epi64x(rotateLeft64(seed, 1), seed);
+
+    for (; i + 2 <= n; i += 2)
+    {
+        __m128i d = _mm_loadu_si128((const __m128i*)(data + i));
+        d = _mm_xor_si128(_mm_shuffle_epi8(d, rot8), sv);
+        _mm_storeu_si128((__m128i*)(data + i), d);
+
+        sv = _mm_or_si128(_mm_slli_epi64(sv, 2), _mm_srli_epi64(sv, 62));
+    }
+
+    genNextScalar((n - i) * 8, rotateLeft64(seed, i), data + i);
+}
+
+__attribute__((target("sse4.2")))
+static void
+chkNextSse(size_t byte_len, uint32_t *hash_buckets, const uint32_t *data32)
+{
+    size_t n = byte_len / 4;
+    size_t i = 0;
+
+    const __m128i poly = _mm_set1_epi32(HASH32_POLY);
+
+    for (; i + 4 <= n; i += 4)
+    {
+        __m128i h = _mm_loadu_si128((const __m128i*)(hash_buckets + i));
+        __m128i d = _mm_loadu_si128((const __m128i*)(data32 + i));
+
+        // Broadcast bit 0 to all bits to select the feedback polynomial
+        __m128i fb = _mm_and_si128(_mm_srai_epi32(_mm_slli_epi32(h, 31), 31), poly);
+        h = _mm_xor_si128(_mm_xor_si128(_mm_srli_epi32(h, 1), fb), d);
+        _mm_storeu_si128((__m128i*)(hash_buckets + i), h);
+    }
+
+    chkNextScalar((n - i) * 4, hash_buckets + i, data32 + i);
+}
+
+__attribute__((target("avx2")))
+static void
+genNextAvx2(size_t byte_len, uint64_t seed, uint64_t *data)
+{
+    size_t n = byte_len / 8;
+    size_t i = 0;
+
+    const __m256i rot8 = _mm256_set_epi8(14, 13, 12, 11, 10, 9, 8, 15,
+                                         6, 5, 4, 3, 2, 1, 0, 7,
+                                         14, 13, 12, 11, 10, 9, 8, 15,
+                                         6, 5, 4, 3, 2, 1, 0, 7);
+    __m256i sv = _mm256_set_epi64x(rotateLeft64(seed, 3), rotateLeft64(seed, 2),
+                                   rotateLeft64(seed, 1), seed);
+
+    for (; i + 4 <= n; i += 4)
+    {
+        __m256i d = _mm256_loadu_si256((const __m256i*)(data + i));
+        d = _mm256_xor_si256(_mm256_shuffle_epi8(d, rot8), sv);
+        _mm256_storeu_si256((__m256i*)(data + i), d);
+
+        sv = _mm256_or_si256(_mm256_slli_epi64(sv, 4), _mm256_srli_epi64(sv, 60));
+    }
+
+    genNextScalar((n - i) * 8, rotateLeft64(seed, i), data + i);
+}
+
+__attribute__((target("avx2")))
+static void
+chkNextAvx2(size_t byte_len, uint32_t *hash_buckets, const uint32_t *data32)
+{
+    size_t n = byte_len / 4;
+    size_t i = 0;
+
+    const __m256i poly = _mm256_set1_epi32(HASH32_POLY);
+
+    for (; i + 8 <= n; i += 8)
+    {
+        __m256i h = _mm256_loadu_si256((const __m256i*)(hash_buckets + i));
+        __m256i d = _mm256_loadu_si256((const __m256i*)(data32 + i));
+
+        __m256i fb = _mm256_and_si256(_mm256_srai_epi32(_mm256_slli_epi32(h, 31), 31), poly);
+        h = _mm256_xor_si256(_mm256_xor_si256(_mm256_srli_epi32(h, 1), fb), d);
+        _mm256_storeu_si256((__m256i*)(hash_buckets + i), h);
+    }
+
+    chkNextScalar((n - i) * 4, hash_buckets + i, data32 + i);
+}
+
+__attribute__((target("avx512f")))
+static void
+genNextAvx512(size_t byte_len, uint64_t seed, uint64_t *data)
+{
+    size_t n = byte_len / 8;
+    size_t i = 0;
+
+    __m512i sv = _mm512_set_epi64(rotateLeft64(seed, 7), rotateLeft64(seed, 6),
+                                  rotateLeft64(seed, 5), rotateLeft64(seed, 4),
+                                  rotateLeft64(seed, 3), rotateLeft64(seed, 2),
+                                  rotateLeft64(seed, 1), seed);
+
+    // One 512 bit line per iteration
+    for (; i + 8 <= n; i += 8)
+    {
+        __m512i d = _mm512_loadu_si512((const void*)(data + i));
+        d = _mm512_xor_si512(_mm512_rol_epi64(d, 8), sv);
+        _mm512_storeu_si512((void*)(data + i), d);
+
+        sv = _mm512_rol_epi64(sv, 8);
+    }
+
+    genNextScalar((n - i) * 8, rotateLeft64(seed, i), data + i);
+}
+
+__attribute__((target("avx512f")))
+static void
+chkNextAvx512(size_t byte_len, uint32_t *hash_buckets, const uint32_t *data32)
+{
+    size_t n = byte_len / 4;
+    size_t i = 0;
+
+    const __m512i poly = _mm512_set1_epi32(HASH32_POLY);
+
+    for (; i + 16 <= n; i += 16)
+    {
+        __m512i h = _mm512_loadu_si512((const void*)(hash_buckets + i));
+        __m512i d = _mm512_loadu_si512((const void*)(data32 + i));
+
+        __m512i fb = _mm512_and_si512(_mm512_srai_epi32(_mm512_slli_epi32(h, 31), 31), poly);
+        h = _mm512_ternarylogic_epi32(_mm512_srli_epi32(h, 1), fb, d, 0x96);
+        _mm512_storeu_si512((void*)(hash_buckets + i), h);
+    }
+
+    chkNextScalar((n - i) * 4, hash_buckets + i, data32 + i);
+}
+
+#endif // __x86_64__
+
+
+__attribute__((constructor))
+static void
+testDataInit(void)
+{
+    s_gen_next = genNextScalar;
+    s_chk_next = chkNextScalar;
+
+#ifdef __x86_64__
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f"))
+    {
+        s_gen_next = genNextAvx512;
+        s_chk_next = chkNextAvx512;
+    }
+    else if (__builtin_cpu_supports("avx2"))
+    {
+        s_gen_next = genNextAvx2;
+        s_chk_next = chkNextAvx2;
+    }
+    else if (__builtin_cpu_supports("sse4.2"))
+    {
+        s_gen_next = genNextSse;
+        s_chk_next = chkNextSse;
+    }
+#endif
+}
+
 
 //
 // Reset the generator's data vector to the initial value. A 64 bit seed
@@ -74,13 +299,25 @@ void
 testDataGenNext(size_t byte_len, uint64_t seed, uint64_t *data)
 {
     assert_valid_len(byte_len);
+    s_gen_next(byte_len, seed, data);
+}
 
-    // Each 64 bit entry is rotated one byte left and XOR the seed in
-    for (size_t i = 0; i < (byte_len / 8); i += 1)
+
+//
+// Jump ahead, equivalent to calling testDataGenNext() num_steps times.
+//
+void
+testDataGenAdvance(size_t byte_len, uint64_t seed, uint64_t *data,
+                   uint64_t num_steps)
+{
+    assert_valid_len(byte_len);
+
+    // Each word is rotated a byte and XORed with a constant. Eight
+    // rotations restore the word, leaving it XORed with the same value
+    // as the 8 constants combined. Another 8 steps cancel that.
+    for (uint64_t i = 0; i < (num_steps & 15); i += 1)
     {
-        data[i] = (data[i] << 8) | (data[i] >> 56);
-        data[i] ^= seed;
-        seed = (seed << 1) | (seed >> 63);
+        s_gen_next(byte_len, seed, data);
     }
 }
 
@@ -111,13 +348,97 @@ testDataChkNext(size_t byte_len, void *hash_vec, uint64_t *data)
 {
     assert_valid_len(byte_len);
 
-    uint32_t *hash_buckets = (uint32_t*)hash_vec;
     // Treat data as 32 bit values
-    uint32_t *data32 = (uint32_t*)data;
+    s_chk_next(byte_len, (uint32_t*)hash_vec, (const uint32_t*)data);
+}
+
+
+//
+// Hash of one 16 step period of the generator starting at data, from zero
+// hash state. The generator returns to the initial data after the period,
+// so every period has the same hash. scratch is a byte_len temporary.
+//
+static void
+chkPeriodHash(size_t byte_len, uint64_t seed, const uint64_t *data,
+              uint32_t *period_hash, uint64_t *scratch)
+{
+    memset(period_hash, 0, byte_len);
+    memcpy(scratch, data, byte_len);
+    for (int i = 0; i < 16; i += 1)
+    {
+        s_chk_next(byte_len, period_hash, (const uint32_t*)scratch);
+        s_gen_next(byte_len, seed, scratch);
+    }
+}
+
+
+//
+// Advance the hash buckets num_periods full generator periods, given the
+// hash of one period from chkPeriodHash().
+//
+static void
+chkAdvancePeriods(size_t byte_len, uint32_t *hash_buckets,
+                  const uint32_t *period_hash, uint64_t num_periods)
+{
+    if (num_periods == 0) return;
+
+    // Each period updates a hash h to (x^16 * h + period_hash). After
+    // num_periods, h becomes (x^(16 * num_periods) * h + G * period_hash)
+    // where G is the geometric sum of x^(16 * j) for j < num_periods.
+    // Walk the bits of num_periods from the top, doubling the prefix
+    // t and optionally adding one: G(2t) = G(t) * (1 + x^(16 * t)) and
+    // G(t + 1) = G(t) + x^(16 * t).
+    const uint32_t one = (uint32_t)1 << 31;
+    const uint32_t x16 = hash32PowX(16);
+    uint32_t g = 0;
+    uint32_t x_t = one;
+    for (int b = 63 - __builtin_clzll(num_periods); b >= 0; b -= 1)
+    {
+        g = hash32MulModP(g, x_t ^ one);
+        x_t = hash32MulModP(x_t, x_t);
+
+        if ((num_periods >> b) & 1)
+        {
+            g ^= x_t;
+            x_t = hash32MulModP(x_t, x16);
+        }
+    }
 
     for (size_t i = 0; i < (byte_len / 4); i += 1)
     {
-        hash_buckets[i] = hash32(hash_buckets[i], data32[i]);
+        hash_buckets[i] = hash32MulModP(x_t, hash_buckets[i]) ^
+                          hash32MulModP(g, period_hash[i]);
+    }
+}
+
+
+//
+// Jump ahead in both the checker and the generator.
+//
+void
+testDataChkAdvance(size_t byte_len, uint64_t seed, void *hash_vec,
+                   uint64_t *data, uint64_t num_data_values)
+{
+    assert_valid_len(byte_len);
+
+    uint32_t *hash_buckets = (uint32_t*)hash_vec;
+    uint64_t num_periods = num_data_values / 16;
+
+    if (num_periods)
+    {
+        // Vectors are one data width, small enough for the stack
+        uint32_t period_hash[byte_len / 4];
+        uint64_t period_data[byte_len / 8];
+
+        chkPeriodHash(byte_len, seed, data, period_hash, period_data);
+        chkAdvancePeriods(byte_len, hash_buckets, period_hash, num_periods);
+    }
+
+    // Remainder
+    for (uint64_t i = 0; i < (num_data_values & 15); i += 1)
+    {
+        s_chk_next(byte_len, hash_buckets, (const uint32_t*)data);
+        s_gen_next(byte_len, seed, data);
     }
 }
 
@@ -149,6 +470,78 @@ testDataChkReduce(size_t byte_len, void *hash_vec)
 }
 
 
+//
+// Allocate a checker context for byte_len vectors. All vectors come from a
+// single allocation, each aligned to a cache line.
+//
+t_test_data_ctx*
+testDataCtxAlloc(size_t byte_len)
+{
+    assert_valid_len(byte_len);
+
+    t_test_data_ctx *ctx = malloc(sizeof(t_test_data_ctx));
+    assert(ctx != NULL);
+
+    size_t vec_bytes = (byte_len + TEST_DATA_ALIGN - 1) & ~(size_t)(TEST_DATA_ALIGN - 1);
+    uint8_t *buf;
+    int r = posix_memalign((void**)&buf, TEST_DATA_ALIGN, 4 * vec_bytes);
+    assert(r == 0);
+
+    ctx->byte_len = byte_len;
+    ctx->seed = 0;
+    ctx->seed_valid = false;
+    ctx->reset_data = (uint64_t*)buf;
+    ctx->period_hash = (uint32_t*)(buf + vec_bytes);
+    ctx->data = (uint64_t*)(buf + 2 * vec_bytes);
+    ctx->hash_vec = (uint32_t*)(buf + 3 * vec_bytes);
+
+    return ctx;
+}
+
+
+void
+testDataCtxFree(t_test_data_ctx *ctx)
+{
+    if (ctx == NULL) return;
+
+    // reset_data is the base of the vector allocation
+    free(ctx->reset_data);
+    free(ctx);
+}
+
+
+//
+// Equivalent to testDataChkGen(), using the context's buffers.
+//
+uint64_t
+testDataCtxChkGen(t_test_data_ctx *ctx, uint64_t seed, uint64_t num_data_values)
+{
+    size_t byte_len = ctx->byte_len;
+
+    if (!ctx->seed_valid || (ctx->seed != seed))
+    {
+        testDataGenReset(byte_len, seed, ctx->reset_data);
+        chkPeriodHash(byte_len, seed, ctx->reset_data, ctx->period_hash, ctx->data);
+        ctx->seed = seed;
+        ctx->seed_valid = true;
+    }
+
+    testDataChkReset(byte_len, ctx->hash_vec);
+    chkAdvancePeriods(byte_len, ctx->hash_vec, ctx->period_hash,
+                      num_data_values / 16);
+
+    // Full periods leave the generator back at the reset state
+    memcpy(ctx->data, ctx->reset_data, byte_len);
+    for (uint64_t i = 0; i < (num_data_values & 15); i += 1)
+    {
+        s_chk_next(byte_len, ctx->hash_vec, (const uint32_t*)ctx->data);
+        s_gen_next(byte_len, seed, ctx->data);
+    }
+
+    return testDataChkReduce(byte_len, ctx->hash_vec);
+}
+
+
 //
 // Convenience function to generate a reduced hash for num_data_values
 // and a seed. This tends to be useful when synthesizing check data
@@ -156,28 +549,110 @@ testDataChkReduce(size_t byte_len, void *hash_vec)
 // synthesize data and testDataChk functions to compute the associated
 // hash.
 //
+// The vectors are one data width and are kept on the stack, so there is
+// no heap allocation. Loops checking the same seed repeatedly should use
+// a t_test_data_ctx, which also caches the seed's period hash.
+//
 uint64_t
 testDataChkGen(size_t byte_len, uint64_t seed, int num_data_values)
 {
     assert_valid_len(byte_len);
 
-    uint64_t *data = malloc(byte_len);
-    uint64_t *hash_vec = malloc(byte_len);
-    assert((data != NULL) && (hash_vec != NULL));
+    uint64_t reset_data[byte_len / 8];
+    uint32_t period_hash[byte_len / 4];
+    uint64_t data[byte_len / 8];
+    uint32_t hash_vec[byte_len / 4];
+
+    t_test_data_ctx ctx;
+    ctx.byte_len = byte_len;
+    ctx.seed_valid = false;
+    ctx.reset_data = reset_data;
+    ctx.period_hash = period_hash;
+    ctx.data = data;
+    ctx.hash_vec = hash_vec;
+
+    return testDataCtxChkGen(&ctx, seed, num_data_values);
+}
+
+
+uint32_t
+testDataSelfCheck(size_t byte_len, uint64_t seed, uint32_t num_trials)
+{
+    assert_valid_len(byte_len);
+
+    t_test_data_ctx *ctx = testDataCtxAlloc(byte_len);
+    uint64_t *step_data = malloc(byte_len);
+    uint32_t *step_hash = malloc(byte_len);
+    uint64_t *jump_data = malloc(byte_len);
+    uint32_t *jump_hash = malloc(byte_len);
+    uint64_t *gen_data = malloc(byte_len);
+    assert(ctx && step_data && step_hash && jump_data && jump_hash && gen_data);
 
-    testDataGenReset(byte_len, seed, data);
-    testDataChkReset(byte_len, hash_vec);
+    // xorshift64, for starting points and jump lengths
+    uint64_t rand_state = seed | 1;
 
-    for (int i = 0; i < num_data_values; i += 1)
+    uint32_t errors = 0;
+    for (uint32_t t = 0; t < num_trials; t += 1)
     {
-        testDataChkNext(byte_len, hash_vec, data);
-        testDataGenNext(byte_len, seed, data);
+        rand_state ^= rand_state << 13;
+        rand_state ^= rand_state >> 7;
+        rand_state ^= rand_state << 17;
+
+        // Jumps cover several generator periods, from a start that is
+        // not period aligned
+        uint64_t start = rand_state % 37;
+        uint64_t num_steps = (rand_state >> 8) % 300;
+
+        testDataGenReset(byte_len, seed, step_data);
+        testDataChkReset(byte_len, step_hash);
+        for (uint64_t i = 0; i < start; i += 1)
+        {
+            testDataChkNext(byte_len, step_hash, step_data);
+            testDataGenNext(byte_len, seed, step_data);
+        }
+
+        memcpy(jump_data, step_data, byte_len);
+        memcpy(jump_hash, step_hash, byte_len);
+        testDataChkAdvance(byte_len, seed, jump_hash, jump_data, num_steps);
+
+        memcpy(gen_data, step_data, byte_len);
+        testDataGenAdvance(byte_len, seed, gen_data, num_steps);
+
+        for (uint64_t i = 0; i < num_steps; i += 1)
+        {
+            testDataChkNext(byte_len, step_hash, step_data);
+            testDataGenNext(byte_len, seed, step_data);
+        }
+
+        if (memcmp(gen_data, step_data, byte_len))
+        {
+            fprintf(stderr, "testDataGenAdvance(%ld bytes, %ld + %ld steps) mismatch\n",
+                    byte_len, start, num_steps);
+            errors += 1;
+        }
+        if (memcmp(jump_data, step_data, byte_len) || memcmp(jump_hash, step_hash, byte_len))
+        {
+            fprintf(stderr, "testDataChkAdvance(%ld bytes, %ld + %ld steps) mismatch\n",
+                    byte_len, start, num_steps);
+            errors += 1;
+        }
+
+        uint64_t step_reduced = testDataChkReduce(byte_len, step_hash);
+        uint64_t ctx_reduced = testDataCtxChkGen(ctx, seed, start + num_steps);
+        if (ctx_reduced != step_reduced)
+        {
+            fprintf(stderr, "testDataCtxChkGen(%ld bytes, %ld values): 0x%016lx, expected 0x%016lx\n",
+                    byte_len, start + num_steps, ctx_reduced, step_reduced);
+            errors += 1;
+        }
     }
 
-    uint64_t chk = testDataChkReduce(byte_len, hash_vec);
-
-    free(hash_vec);
-    free(data);
+    free(gen_data);
+    free(jump_hash);
+    free(jump_data);
+    free(step_hash);
+    free(step_data);
+    testDataCtxFree(ctx);
 
-    return chk;
+    return errors;
 }
@@ -8,6 +8,7 @@
 #ifndef __TEST_DATA_H__
 #define __TEST_DATA_H__
 
+#include <stdbool.h>
 #include <stddef.h>
 #include <stdint.h>
 
@@ -35,6 +36,14 @@ void testDataGenReset(size_t byte_len, uint64_t seed, uint64_t *data);
 //
 void testDataGenNext(size_t byte_len, uint64_t seed, uint64_t *data);
 
+//
+// Jump ahead, equivalent to calling testDataGenNext() num_steps times.
+// Each 64 bit word of the sequence repeats every 16 steps, so the cost
+// is independent of num_steps.
+//
+void testDataGenAdvance(size_t byte_len, uint64_t seed, uint64_t *data,
+                        uint64_t num_steps);
+
 
 // ========================================================================
 //
@@ -56,6 +65,20 @@ void testDataChkReset(size_t byte_len, void *hash_vec);
 //
 void testDataChkNext(size_t byte_len, void *hash_vec, uint64_t *data);
 
+//
+// Jump ahead in both the checker and the generator. Equivalent to
+// num_data_values iterations of:
+//
+//   testDataChkNext(byte_len, hash_vec, data);
+//   testDataGenNext(byte_len, seed, data);
+//
+// The hash is linear, so full 16 step periods of the generator are
+// folded in using powers of x mod the hash polynomial. The cost grows
+// with log(num_data_values).
+//
+void testDataChkAdvance(size_t byte_len, uint64_t seed, void *hash_vec,
+                        uint64_t *data, uint64_t num_data_values);
+
 //
 // Reduce hashes to a single 64 bit value.
 //
@@ -72,6 +95,53 @@ uint64_t testDataChkGen(size_t byte_len, uint64_t seed,
                         int num_data_values);
 
 
+// ========================================================================
+//
+//  Reusable checker context. A context owns cache line aligned vectors
+//  for one byte_len, so computing expected hashes in a loop performs no
+//  heap allocation. The generator reset vector and the hash of one full
+//  generator period are cached for the most recent seed.
+//
+// ========================================================================
+
+#define TEST_DATA_ALIGN 64
+
+typedef struct
+{
+    size_t byte_len;
+
+    // Cached for seed
+    uint64_t seed;
+    bool seed_valid;
+    uint64_t *reset_data;
+    uint32_t *period_hash;
+
+    // Scratch vectors, byte_len each. Callers may also use these to drive
+    // the testDataGen and testDataChk functions directly.
+    uint64_t *data;
+    uint32_t *hash_vec;
+}
+t_test_data_ctx;
+
+t_test_data_ctx *testDataCtxAlloc(size_t byte_len);
+void testDataCtxFree(t_test_data_ctx *ctx);
+
+//
+// Same result as testDataChkGen(ctx->byte_len, seed, num_data_values).
+//
+uint64_t testDataCtxChkGen(t_test_data_ctx *ctx, uint64_t seed,
+                           uint64_t num_data_values);
+
+//
+// Compare testDataGenAdvance(), testDataChkAdvance() and
+// testDataCtxChkGen() with stepping testDataGenNext() and testDataChkNext()
+// one value at a time, over num_trials pseudo-random starting points and
+// jump lengths. Mismatches are printed on stderr. Returns the number of
+// mismatches.
+//
+uint32_t testDataSelfCheck(size_t byte_len, uint64_t seed, uint32_t num_trials);
+
+
 #ifdef __cplusplus
 }
 #endif
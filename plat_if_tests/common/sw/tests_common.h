@@ -4,9 +4,13 @@
 #ifndef __TESTS_COMMON_H__
 #define __TESTS_COMMON_H__
 
+#include "cache_ops.h"
 #include "connect.h"
 #include "csr_mgr.h"
+#include "eng_wait.h"
 #include "hash32.h"
+#include "result_writer.h"
 #include "test_data.h"
+#include "thread_pool.h"
 
 #endif // __TESTS_COMMON_H__
@@ -0,0 +1,173 @@
+// Copyright (C) 2022 Intel Corporation
+// SPDX-License-Identifier: MIT
+
+#include <assert.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "thread_pool.h"
+
+static pthread_mutex_t s_run_lock = PTHREAD_MUTEX_INITIALIZER;
+
+// Everything below is protected by s_lock, except s_job_next_task
+// which is claimed atomically while a job is open.
+static pthread_mutex_t s_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t s_work_cv = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t s_done_cv = PTHREAD_COND_INITIALIZER;
+
+static uint32_t s_num_workers;
+static uint32_t s_max_threads;
+
+static uint64_t s_generation;
+static bool s_job_open;
+static uint32_t s_job_num_workers;
+static t_thread_pool_task s_job_task;
+static void *s_job_arg;
+static uint32_t s_job_num_tasks;
+static uint32_t s_job_next_task;
+static uint32_t s_job_tasks_done;
+static uint32_t s_job_busy;
+
+
+static uint32_t
+numOnlineCPUs(void)
+{
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    return (n > 0) ? n : 1;
+}
+
+
+//
+// Claim and run tasks from the open job until none are left. Returns
+// the number of tasks run.
+//
+static uint32_t
+runTasks(void)
+{
+    uint32_t n_done = 0;
+    uint32_t t;
+
+    while ((t = __atomic_fetch_add(&s_job_next_task, 1, __ATOMIC_RELAXED)) <
+           s_job_num_tasks)
+    {
+        s_job_task(s_job_arg, t);
+        n_done += 1;
+    }
+
+    return n_done;
+}
+
+
+static void*
+workerThread(void *args)
+{
+    uint32_t worker_idx = (uintptr_t)args;
+    uint64_t seen_generation = 0;
+
+    pthread_mutex_lock(&s_lock);
+    while (true)
+    {
+        while (s_generation == seen_generation)
+        {
+            pthread_cond_wait(&s_work_cv, &s_lock);
+        }
+        seen_generation = s_generation;
+
+        // Job already finished or this worker isn't needed?
+        if (!s_job_open || (worker_idx >= s_job_num_workers)) continue;
+
+        s_job_busy += 1;
+        pthread_mutex_unlock(&s_lock);
+
+        uint32_t n_done = runTasks();
+
+        pthread_mutex_lock(&s_lock);
+        s_job_tasks_done += n_done;
+        s_job_busy -= 1;
+        if ((s_job_tasks_done == s_job_num_tasks) && (s_job_busy == 0))
+        {
+            pthread_cond_signal(&s_done_cv);
+        }
+    }
+
+    return NULL;
+}
+
+
+void
+threadPoolRun(uint32_t num_tasks, t_thread_pool_task task, void *arg)
+{
+    if (num_tasks == 0) return;
+
+    uint32_t num_threads = threadPoolNumThreads();
+    if ((num_tasks == 1) || (num_threads == 1))
+    {
+        for (uint32_t t = 0; t < num_tasks; t += 1)
+        {
+            task(arg, t);
+        }
+        return;
+    }
+
+    pthread_mutex_lock(&s_run_lock);
+    pthread_mutex_lock(&s_lock);
+
+    // Workers are created on demand and then live until the program exits
+    while (s_num_workers < num_threads - 1)
+    {
+        pthread_t tid;
+        int r = pthread_create(&tid, NULL, workerThread,
+                               (void*)(uintptr_t)s_num_workers);
+        assert(0 == r);
+        pthread_detach(tid);
+        s_num_workers += 1;
+    }
+
+    s_job_task = task;
+    s_job_arg = arg;
+    s_job_num_tasks = num_tasks;
+    s_job_next_task = 0;
+    s_job_tasks_done = 0;
+    s_job_num_workers = num_threads - 1;
+    s_job_open = true;
+    s_generation += 1;
+    pthread_cond_broadcast(&s_work_cv);
+
+    // The caller works too
+    s_job_busy += 1;
+    pthread_mutex_unlock(&s_lock);
+
+    uint32_t n_done = runTasks();
+
+    pthread_mutex_lock(&s_lock);
+    s_job_tasks_done += n_done;
+    s_job_busy -= 1;
+    while ((s_job_tasks_done != s_job_num_tasks) || (s_job_busy != 0))
+    {
+        pthread_cond_wait(&s_done_cv, &s_lock);
+    }
+    s_job_open = false;
+
+    pthread_mutex_unlock(&s_lock);
+    pthread_mutex_unlock(&s_run_lock);
+}
+
+
+uint32_t
+threadPoolNumThreads(void)
+{
+    uint32_t n = numOnlineCPUs();
+    uint32_t max_threads = __atomic_load_n(&s_max_threads, __ATOMIC_RELAXED);
+
+    if (max_threads && (max_threads < n)) n = max_threads;
+    return n;
+}
+
+
+void
+threadPoolSetMaxThreads(uint32_t max_threads)
+{
+    __atomic_store_n(&s_max_threads, max_threads, __ATOMIC_RELAXED);
+}
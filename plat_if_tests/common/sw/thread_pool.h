@@ -0,0 +1,43 @@
+// Copyright (C) 2022 Intel Corporation
+// SPDX-License-Identifier: MIT
+
+//
+// Minimal shared thread pool for splitting host-side checking work
+// across cores.
+//
+
+#ifndef __THREAD_POOL_H__
+#define __THREAD_POOL_H__
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+typedef void (*t_thread_pool_task)(void *arg, uint32_t task_idx);
+
+//
+// Run task(arg, i) for every i in [0, num_tasks) and return once all
+// have completed. The calling thread executes tasks too. Tasks may run
+// in any order and in parallel. Calls are serialized -- a task must not
+// call threadPoolRun().
+//
+void threadPoolRun(uint32_t num_tasks, t_thread_pool_task task, void *arg);
+
+//
+// Number of threads, including the caller, that threadPoolRun() will use.
+//
+uint32_t threadPoolNumThreads(void);
+
+//
+// Limit the number of threads used by threadPoolRun(), including the
+// caller. 0 restores the default: one per online CPU.
+//
+void threadPoolSetMaxThreads(uint32_t max_threads);
+
+#ifdef __cplusplus
+}
+#endif
+#endif // __THREAD_POOL_H__
@@ -29,6 +29,7 @@ help(void)
     printf("\n"
            "Usage:\n"
            "    host_chan_atomic [-h] [-B <bus>] [-D <device>] [-F <function>] [-S <socket-id>]\n"
+           "                     [--results=<file>]\n"
            "\n"
            "        -h,--help           Print this help\n"
            "        -B,--bus            Set target bus number\n"
@@ -36,6 +37,8 @@ help(void)
            "        -F,--function       Set target function number\n"
            "        -S,--socket-id      Set target socket number\n"
            "        -v,--verbose        Verbose messages\n"
+           "\n"
+           RESULT_OPT_HELP
            "\n");
 }
 
@@ -54,6 +57,7 @@ parse_args(int argc, char *argv[])
         {"function",   required_argument, NULL, 'F'},
         {"socket-id",  required_argument, NULL, 'S'},
         {"verbose",    required_argument, NULL, 'v'},
+        RESULT_LONGOPT,
         {0, 0, 0, 0}
     };
 
@@ -127,6 +131,10 @@ parse_args(int argc, char *argv[])
             }
             break;
 
+        case RESULT_OPT: /* results */
+            resultParseOpt(tmp_optarg);
+            break;
+
         case ':': /* missing option argument */
             fprintf(stderr, "Missing option argument\n");
             return -1;
@@ -160,6 +168,9 @@ int main(int argc, char *argv[])
     if (parse_args(argc, argv) < 0)
         return 1;
 
+    if (resultOpenOpt("host_chan_atomic"))
+        return 1;
+
     // Find and connect to the accelerator
     accel_handle = connectToAccel(AFU_ACCEL_UUID, &target);
     assert(NULL != accel_handle);
@@ -169,7 +180,8 @@ int main(int argc, char *argv[])
         printf("Running in ASE mode\n");
     }
 
-    t_csr_handle_p csr_handle = csrAllocHandle(accel_handle, 0);
+    t_csr_handle_p csr_handle = csrAllocHandleMode(accel_handle, 0,
+                                                   is_ase ? CSR_MMIO_API : CSR_MMIO_DIRECT);
     assert(csr_handle != NULL);
 
     printf("AFU ID:  %016" PRIx64 " %016" PRIx64 "\n",
@@ -183,5 +195,7 @@ int main(int argc, char *argv[])
     csrReleaseHandle(csr_handle);
     fpgaClose(accel_handle);
 
+    resultClose();
+
     return status;
 }
@@ -20,7 +20,6 @@
 #include <uuid/uuid.h>
 #include <time.h>
 #include <immintrin.h>
-#include <cpuid.h>
 #include <numa.h>
 
 #include <opae/fpga.h>
@@ -32,27 +31,13 @@
 // State from the AFU's JSON file, extracted using OPAE's afu_json_mgr script
 #include "afu_json_info.h"
 #include "test_host_chan_atomic.h"
+#include "buffer_pool.h"
 
 #define CACHELINE_BYTES 64
 #define CL(x) ((x) * CACHELINE_BYTES)
 #define KB(x) ((x) * 1024)
 #define MB(x) ((x) * 1048576)
 
-#define PROTECTION (PROT_READ | PROT_WRITE)
-
-#ifndef MAP_HUGETLB
-#define MAP_HUGETLB 0x40000
-#endif
-#ifndef MAP_HUGE_SHIFT
-#define MAP_HUGE_SHIFT 26
-#endif
-
-#define MAP_1G_HUGEPAGE (0x1e << MAP_HUGE_SHIFT) /* 2 ^ 0x1e = 1G */
-
-#define FLAGS_4K (MAP_PRIVATE | MAP_ANONYMOUS)
-#define FLAGS_2M (FLAGS_4K | MAP_HUGETLB)
-#define FLAGS_1G (FLAGS_2M | MAP_1G_HUGEPAGE)
-
 
 // Engine's address mode
 typedef enum
@@ -83,15 +68,12 @@ typedef struct
 
     volatile uint64_t *atomic_buf;
     uint64_t atomic_buf_ioaddr;
-    uint64_t atomic_wsid;
 
     volatile uint64_t *rd_buf;
     uint64_t rd_buf_ioaddr;
-    uint64_t rd_wsid;
 
     volatile uint64_t *wb_buf;
     uint64_t wb_buf_ioaddr;
-    uint64_t wb_wsid;
 
     struct bitmask* numa_rd_mem_mask;
     struct bitmask* numa_wr_mem_mask;
@@ -120,77 +102,9 @@ static char *engine_type[] =
 
 
 //
-// Taken from https://github.com/pmem/pmdk/blob/master/src/libpmem2/x86_64/flush.h.
-// The clflushopt instruction was added for Skylake and isn't in <immintrin.h>
-// _mm_clflushopt() in many of the compilers currently in use.
-//
-static inline void
-asm_clflushopt(const void *addr)
-{
-    asm volatile(".byte 0x66; clflush %0" : "+m" \
-        (*(volatile char *)(addr)));
-}
-
-//
-// Flush a range of lines from the cache hierarchy in the entire coherence
-// domain. (All cores all sockets)
-//
-static void
-flushRange(void* start, size_t len)
-{
-    uint8_t* cl = start;
-    uint8_t* end = start + len;
-
-    // Does the CPU support clflushopt?
-    static bool checked_clflushopt = false;
-    static bool supports_clflushopt = false;
-
-    if (! checked_clflushopt)
-    {
-        checked_clflushopt = true;
-        supports_clflushopt = false;
-
-        unsigned int eax, ebx, ecx, edx;
-        if (__get_cpuid_max(0, 0) >= 7)
-        {
-            __cpuid_count(7, 0, eax, ebx, ecx, edx);
-            // bit_CLFLUSHOPT is (1 << 23)
-            supports_clflushopt = (((1 << 23) & ebx) != 0);
-            printf("#  Processor supports clflushopt: %d\n", supports_clflushopt);
-        }
-    }
-    if (! supports_clflushopt) return;
-
-    while (cl < end)
-    {
-        asm_clflushopt(cl);
-        cl += CACHELINE_BYTES;
-    }
-
-    _mm_sfence();
-}
-
-
-//
-// Prefetch a range into the local cache.
-//
-static void
-prefetchRange(void* start, size_t len)
-{
-    uint8_t* cl = start;
-    uint8_t* end = start + len;
-    static volatile uint64_t sum = 0;
-
-    while (cl < end)
-    {
-        sum += *cl;
-        cl += CACHELINE_BYTES;
-    }
-}
-
-
-//
-// Allocate a buffer in I/O memory, shared with the FPGA.
+// Allocate a buffer in I/O memory, shared with the FPGA. Buffers come from
+// a pool of pinned huge pages. They are aligned to their size and released
+// together by bufPoolRelease().
 //
 static void*
 allocSharedBuffer(
@@ -198,72 +112,53 @@ allocSharedBuffer(
     size_t size,
     t_fpga_addr_mode addr_mode,
     struct bitmask *numa_mem_mask,
-    uint64_t *wsid,
     uint64_t *ioaddr)
 {
-    fpga_result r;
+    t_buf_pool_region region;
     void* buf;
 
-    int flags;
-    if (size >= MB(1024))
-        flags = FLAGS_1G;
-    else if (size >= 2 * MB(1))
-        flags = FLAGS_2M;
-    else
-        flags = FLAGS_4K;
-
-    // Preserve current NUMA configuration
-    struct bitmask *numa_mems_preserve;
-    numa_mems_preserve = numa_get_membind();
-
     // Limit NUMA to what the port requests (except in simulation)
-    if (!s_is_ase) numa_set_membind(numa_mem_mask);
-
-    // Allocate a buffer
-    buf = mmap(NULL, size, (PROT_READ | PROT_WRITE), flags, -1, 0);
-    assert(NULL != buf);
-
-    // Pin the buffer
-    r = fpgaPrepareBuffer(accel_handle, size, (void*)&buf, wsid, FPGA_BUF_PREALLOCATED);
-    if (FPGA_OK != r) return NULL;
+    buf = bufPoolAlloc(accel_handle, s_is_ase ? NULL : numa_mem_mask,
+                       size, size, &region);
+    if (NULL == buf) return NULL;
 
-    // Restore NUMA configuration
-    numa_set_membind(numa_mems_preserve);
-    numa_bitmask_free(numa_mems_preserve);
-
-    // Get the physical address of the buffer in the accelerator
-    r = fpgaGetIOAddress(accel_handle, *wsid, ioaddr);
-    assert(FPGA_OK == r);
+    *ioaddr = region.ioaddr;
 
     // Physical addresses? (ASE doesn't support this)
     if ((addr_mode == ADDR_MODE_HOST_PHYSICAL) && !s_is_ase)
     {
+        // Only the page holding the buffer is known to be physically
+        // contiguous. The whole buffer must fit in it.
+        size_t offset = (uint8_t*)buf - (uint8_t*)region.page_va;
+        if (region.page_size < offset + size)
+        {
+            fprintf(stderr,
+                    "Physically addressed %ld byte buffer crosses a %s page. Reserve larger\n"
+                    "huge pages or use a smaller buffer.\n",
+                    size, bufPoolPageSizeStr(region.page_size));
+            exit(1);
+        }
+
 #ifdef FPGA_NEAR_MEM_MAP
         // Call libfpga_near_mem_map from BBB repository for address info.
         // FPGA_NEAR_MEM_MAP has been tested already in initEngine().
+        // Buffers share pages, so translate the page and add the offset.
+        fpga_result r;
         fpga_near_mem_map_buf_info buf_info;
-        r = fpgaNearMemGetPageAddrInfo((void*)buf, &buf_info);
+        r = fpgaNearMemGetPageAddrInfo(region.page_va, &buf_info);
         if (FPGA_OK != r)
         {
             fprintf(stderr,
                     "Physical translation from VA %p failed. Is the fpga_near_mem_map driver from\n"
-                    "the OPAE intel-fpga-bbb repository installed properly?\n", buf);
+                    "the OPAE intel-fpga-bbb repository installed properly?\n", region.page_va);
             exit(1);
         }
 
-        *ioaddr = buf_info.phys_addr - buf_info.phys_space_base;
+        *ioaddr = buf_info.phys_addr - buf_info.phys_space_base +
+                  ((uint8_t*)buf - (uint8_t*)region.page_va);
 #endif
     }
 
-    // The test engines treat a zero buffer IOVA as a hint to disable the engine.
-    // If IOVA is zero, just leave it allocated as a placeholder and get another
-    // buffer.
-    if (0 == *ioaddr)
-    {
-        buf = allocSharedBuffer(accel_handle, size, addr_mode, numa_mem_mask,
-                                wsid, ioaddr);
-    }
-
     return buf;
 }
 
@@ -354,6 +249,13 @@ initEngine(
     printf("#  Engine %d addressing mode: %s\n", e, addr_mode_str[s_eng_bufs[e].addr_mode]);
     printf("#  Engine %d group: %d\n", e, s_eng_bufs[e].group);
 
+    if (e == 0)
+    {
+        const t_cache_features *cf = cacheGetFeatures();
+        printf("#  Processor supports clflushopt: %d, clwb: %d, cldemote: %d\n",
+               cf->clflushopt, cf->clwb, cf->cldemote);
+    }
+
     // 64 bit mask of valid NUMA nodes, according to the FPGA configuration
     struct bitmask* numa_rd_mask;
     struct bitmask* numa_wr_mask;
@@ -388,38 +290,35 @@ initEngine(
     s_eng_bufs[e].atomic_buf = allocSharedBuffer(accel_handle, KB(4),
                                                  s_eng_bufs[e].addr_mode,
                                                  s_eng_bufs[e].numa_wr_mem_mask,
-                                                 &s_eng_bufs[e].atomic_wsid,
                                                  &s_eng_bufs[e].atomic_buf_ioaddr);
     assert(NULL != s_eng_bufs[e].atomic_buf);
     printf("#  Engine %d atomic buffer: VA %p, DMA address %p\n", e,
            s_eng_bufs[e].atomic_buf, (void*)s_eng_bufs[e].atomic_buf_ioaddr);
     // Flush to guarantee that the values reach RAM
-    flushRange((void*)s_eng_bufs[e].atomic_buf, KB(4));
+    cacheFlushRange((void*)s_eng_bufs[e].atomic_buf, KB(4));
     // Read back to the local cache. Some engine types may benefit from reading
-    // cached memory. This doesn't undo the flushRange() above, which was needed
+    // cached memory. This doesn't undo the cacheFlushRange() above, which was needed
     // only to guarantee that RAM and cache are consistent.
-    prefetchRange((void*)s_eng_bufs[e].atomic_buf, KB(4));
+    cachePrefetchRange((void*)s_eng_bufs[e].atomic_buf, KB(4));
 
     s_eng_bufs[e].rd_buf = allocSharedBuffer(accel_handle, KB(4),
                                              s_eng_bufs[e].addr_mode,
                                              s_eng_bufs[e].numa_rd_mem_mask,
-                                             &s_eng_bufs[e].rd_wsid,
                                              &s_eng_bufs[e].rd_buf_ioaddr);
     assert(NULL != s_eng_bufs[e].rd_buf);
     printf("#  Engine %d read buffer: VA %p, DMA address %p\n", e,
            s_eng_bufs[e].rd_buf, (void*)s_eng_bufs[e].rd_buf_ioaddr);
     initReadBuf(s_eng_bufs[e].rd_buf, KB(4), s_eng_bufs[e].data_bus_bytes);
     // Flush to guarantee that the values reach RAM
-    flushRange((void*)s_eng_bufs[e].rd_buf, KB(4));
+    cacheFlushRange((void*)s_eng_bufs[e].rd_buf, KB(4));
     // Read back to the local cache. Some engine types may benefit from reading
-    // cached memory. This doesn't undo the flushRange() above, which was needed
+    // cached memory. This doesn't undo the cacheFlushRange() above, which was needed
     // only to guarantee that RAM and cache are consistent.
-    prefetchRange((void*)s_eng_bufs[e].rd_buf, KB(4));
+    cachePrefetchRange((void*)s_eng_bufs[e].rd_buf, KB(4));
 
     s_eng_bufs[e].wb_buf = allocSharedBuffer(accel_handle, KB(4),
                                              s_eng_bufs[e].addr_mode,
                                              s_eng_bufs[e].numa_wr_mem_mask,
-                                             &s_eng_bufs[e].wb_wsid,
                                              &s_eng_bufs[e].wb_buf_ioaddr);
     assert(NULL != s_eng_bufs[e].wb_buf);
     printf("#  Engine %d write buffer: VA %p, DMA address %p\n", e,
@@ -534,24 +433,11 @@ testAtomicEngine(
     // Start the engine
     csrEnableEngines(csr_handle, emask);
     
-    // Wait for engine to complete. Checking csrGetEnginesEnabled()
-    // resolves a race between the request to start an engine
-    // and the engine active flag going high. Execution is done when
-    // the engine is enabled and the active flag goes low.
-    struct timespec wait_time;
-    wait_time.tv_sec = (s_is_ase ? 2 : 0);
-    wait_time.tv_nsec = 1000000;
-    uint64_t wait_nsec = 0;
-    while ((csrGetEnginesEnabled(csr_handle) == 0) ||
-           csrGetEnginesActive(csr_handle))
+    // Wait for engine to complete
+    if (engWait(csr_handle, ENG_WAIT_DONE,
+                (s_is_ase ? 20 : 5) * (uint64_t)1000000000L))
     {
-        nanosleep(&wait_time, NULL);
-
-        wait_nsec += wait_time.tv_nsec + wait_time.tv_sec * (uint64_t)1000000000L;
-        if ((wait_nsec / (uint64_t)1000000000L) > (s_is_ase ? 20 : 5))
-        {
-            engineErrorAndExit(num_engines, emask);
-        }
+        engineErrorAndExit(num_engines, emask);
     }
 
     // Stop the engine
@@ -672,6 +558,14 @@ testAtomicEngine(
     else
         printf("PASS\n");
 
+    resultBegin("atomic");
+    resultInt("engine", e);
+    resultInt("width", mode_64bit ? 64 : 32);
+    resultInt("num_atomics", num_atomic_writes);
+    resultInt("errors", num_errors);
+    resultBool("pass", num_errors == 0);
+    resultEnd();
+
     return num_errors;
 }
 
@@ -688,6 +582,11 @@ testHostChanAtomic(
     int result = 0;
     s_is_ase = is_ase;
 
+    // Simulation mirrors every pinned byte. Avoid 1GB pages.
+    if (is_ase) bufPoolSetMaxPageSize(MB(2));
+    // Poll less often in simulation
+    engWaitSetMaxPollNs(is_ase ? 2000000000 : 0);
+
     printf("# Test ID: %016" PRIx64 " %016" PRIx64 " (%ld)\n",
            csrEngGlobRead(csr_handle, 1),
            csrEngGlobRead(csr_handle, 0),
@@ -735,12 +634,7 @@ testHostChanAtomic(
 
     // Release buffers
   done:
-    for (uint32_t e = 0; e < num_engines; e += 1)
-    {
-        fpgaReleaseBuffer(accel_handle, s_eng_bufs[e].atomic_wsid);
-        fpgaReleaseBuffer(accel_handle, s_eng_bufs[e].rd_wsid);
-        fpgaReleaseBuffer(accel_handle, s_eng_bufs[e].wb_wsid);
-    }
+    bufPoolRelease(accel_handle);
 
     return result;
 }
@@ -155,6 +155,11 @@ testHostChanIntr(
             printf("ID %d: pass\n", id);
         }
 
+        resultBegin("interrupt");
+        resultInt("id", id);
+        resultBool("pass", NULL == retval);
+        resultEnd();
+
         result = fpgaUnregisterEvent(s_accel_handle, FPGA_EVENT_INTERRUPT,
                                      ehandles[id]);
         assert(FPGA_OK == result);
@@ -190,5 +195,12 @@ testHostChanIntr(
         error_count += 1;
     }
 
+    resultBegin("interrupt_responses");
+    resultInt("num_ids", num_intr_ids);
+    resultInt("num_responses", num_resp);
+    resultInt("response_mask", resp_mask);
+    resultBool("pass", error_count == 0);
+    resultEnd();
+
     return error_count;
 }
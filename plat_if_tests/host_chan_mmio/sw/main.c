@@ -27,6 +27,7 @@ help(void)
     printf("\n"
            "Usage:\n"
            "    test_chan_mmio [-h] [-B <bus>] [-D <device>] [-F <function>] [-S <socket-id>]\n"
+           "                   [--results=<file>]\n"
            "\n"
            "        -h,--help           Print this help\n"
            "        -B,--bus            Set target bus number\n"
@@ -34,6 +35,8 @@ help(void)
            "        -F,--function       Set target function number\n"
            "        -S,--socket-id      Set target socket number\n"
            "        --segment           Set target segment number\n"
+           "\n"
+           RESULT_OPT_HELP
            "\n");
 }
 
@@ -52,6 +55,7 @@ parse_args(int argc, char *argv[])
         {"function",  required_argument, NULL, 'F'},
         {"socket-id", required_argument, NULL, 'S'},
         {"segment",   required_argument, NULL, 0xe},
+        RESULT_LONGOPT,
         {0, 0, 0, 0}
     };
 
@@ -138,6 +142,10 @@ parse_args(int argc, char *argv[])
             }
             break;
 
+        case RESULT_OPT: /* results */
+            resultParseOpt(tmp_optarg);
+            break;
+
         case ':': /* missing option argument */
             fprintf(stderr, "Missing option argument\n");
             return -1;
@@ -167,6 +175,9 @@ int main(int argc, char *argv[])
     if (parse_args(argc, argv) < 0)
         return 1;
 
+    if (resultOpenOpt("host_chan_mmio"))
+        return 1;
+
     // Find and connect to the accelerator
     accel_handle = connectToAccel(AFU_ACCEL_UUID, &target);
     assert(NULL != accel_handle);
@@ -176,7 +187,8 @@ int main(int argc, char *argv[])
         printf("Running in ASE mode\n");
     }
 
-    t_csr_handle_p csr_handle = csrAllocHandle(accel_handle, 0);
+    t_csr_handle_p csr_handle = csrAllocHandleMode(accel_handle, 0,
+                                                   is_ase ? CSR_MMIO_API : CSR_MMIO_DIRECT);
     assert(csr_handle != NULL);
 
     printf("AFU ID:  %016" PRIx64 " %016" PRIx64 "\n",
@@ -190,5 +202,7 @@ int main(int argc, char *argv[])
     csrReleaseHandle(csr_handle);
     fpgaClose(accel_handle);
 
+    resultClose();
+
     return status;
 }
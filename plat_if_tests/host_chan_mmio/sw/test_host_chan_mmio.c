@@ -15,6 +15,7 @@
 #include <unistd.h>
 #include <assert.h>
 #include <inttypes.h>
+#include <time.h>
 
 #include <opae/fpga.h>
 
@@ -105,6 +106,92 @@ mmio_write512(fpga_handle accel_handle, uint64_t word_idx, const uint64_t *data)
 }
 
 
+static double
+secondsSince(const struct timespec *start)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - start->tv_sec) + (now.tv_nsec - start->tv_nsec) * 1e-9;
+}
+
+
+//
+// Compare the rate of CSR accesses through the OPAE MMIO API with the rate
+// through a directly mapped MMIO pointer.
+//
+static void
+testCsrAccessRate(fpga_handle accel_handle)
+{
+    const uint32_t num_iter = 100000;
+    const char *mode_name[2] = { "OPAE API", "Direct" };
+    t_csr_handle_p handles[2];
+
+    handles[0] = csrAllocHandleMode(accel_handle, 0, CSR_MMIO_API);
+    handles[1] = csrAllocHandleMode(accel_handle, 0, CSR_MMIO_DIRECT);
+    assert((handles[0] != NULL) && (handles[1] != NULL));
+
+    if (handles[1]->mmio_ptr == NULL)
+    {
+        printf("  Direct MMIO mapping not available\n");
+        goto done;
+    }
+
+    for (int m = 0; m < 2; m += 1)
+    {
+        struct timespec start;
+
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        for (uint32_t i = 0; i < num_iter; i += 1)
+        {
+            csrRead(handles[m], CSR_AFU_ID_L);
+        }
+        double rd_secs = secondsSince(&start);
+
+        // Writes land in the same 64 bit register as the write tests above.
+        // The final read waits for the posted writes to drain.
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        for (uint32_t i = 0; i < num_iter; i += 1)
+        {
+            csrWrite(handles[m], 0x7f, i);
+        }
+        csrRead(handles[m], CSR_AFU_ID_L);
+        double wr_secs = secondsSince(&start);
+
+        printf("  %-8s  read %6.2f M/s (%5.0f ns),  write %6.2f M/s (%5.0f ns)\n",
+               mode_name[m],
+               num_iter / rd_secs / 1e6, rd_secs * 1e9 / num_iter,
+               num_iter / wr_secs / 1e6, wr_secs * 1e9 / num_iter);
+
+        resultBegin("csr_access_rate");
+        resultStr("mode", mode_name[m]);
+        resultDouble("read_mops", num_iter / rd_secs / 1e6);
+        resultDouble("read_ns", rd_secs * 1e9 / num_iter);
+        resultDouble("write_mops", num_iter / wr_secs / 1e6);
+        resultDouble("write_ns", wr_secs * 1e9 / num_iter);
+        resultEnd();
+    }
+
+  done:
+    csrReleaseHandle(handles[1]);
+    csrReleaseHandle(handles[0]);
+}
+
+
+//
+// Result record for the functional tests
+//
+static void
+writeMmioResult(uint64_t afu_status, bool pass)
+{
+    resultBegin("mmio");
+    resultInt("rd_bus_width", ((afu_status >> 14) & 3) ? 512 : 64);
+    resultBool("mmio512_wr_supported", (afu_status >> 4) & 1);
+    resultInt("pclk_mhz", (afu_status >> 16) & 0xffff);
+    resultBool("pass", pass);
+    resultEnd();
+}
+
+
 int
 testHostChanMMIO(
     int argc,
@@ -403,9 +490,18 @@ testHostChanMMIO(
     }
 
     printf("  PASS\n");
+    writeMmioResult(afu_status, true);
+
+    // Simulated MMIO is far too slow for a meaningful rate
+    if (! is_ase)
+    {
+        printf("\nCSR access rate:\n");
+        testCsrAccessRate(accel_handle);
+    }
 
     return 0;
 
   error:
+    writeMmioResult(afu_status, false);
     return 1;
 }
@@ -110,7 +110,9 @@ module afu
       #(
         .INSTANCE_ID(AFU_INSTANCE_ID),
         .NUM_ENGINES(NUM_ENGINES),
-        .MMIO_ADDR_WIDTH(mmio64_if.ADDR_WIDTH)
+        .MMIO_ADDR_WIDTH(mmio64_if.ADDR_WIDTH),
+        // Bandwidth sampling reads the line counters (CSRs 2 and 3)
+        .SNAPSHOT_CSR_MASK(16'h000c)
         )
       csr_mgr
        (
@@ -97,7 +97,9 @@ module afu
     csr_mgr_axi
       #(
         .INSTANCE_ID(AFU_INSTANCE_ID),
-        .NUM_ENGINES(NUM_ENGINES)
+        .NUM_ENGINES(NUM_ENGINES),
+        // Bandwidth sampling reads the line counters (CSRs 2 and 3)
+        .SNAPSHOT_CSR_MASK(16'h000c)
         )
       csr_mgr
        (
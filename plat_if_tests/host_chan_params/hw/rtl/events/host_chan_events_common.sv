@@ -11,7 +11,10 @@ module host_chan_events_common
   #(
     // Width of the read event counter updates
     parameter READ_CNT_WIDTH = 3,
-    parameter UNIT_IS_DWORDS = 0
+    parameter UNIT_IS_DWORDS = 0,
+    // Maximum number of cycles with read requests in flight tracked by
+    // the latency histogram. Must be a power of 2.
+    parameter LAT_FIFO_DEPTH = 512
     )
    (
     input  logic clk,
@@ -101,6 +104,41 @@ module host_chan_events_common
         );
 
 
+    //
+    // Read latency histogram
+    //
+    logic [4:0] lat_hist_sel;
+    ofs_plat_prim_clock_crossing_reg#(.WIDTH(5)) cc_lat_hist_sel
+       (
+        .clk_src(events.eng_clk),
+        .clk_dst(rdClk),
+        .r_in(events.lat_hist_sel),
+        .r_out(lat_hist_sel)
+        );
+
+    logic [4:0] lat_hist_bin;
+    t_counter lat_hist_count;
+    logic lat_overflow;
+
+    host_chan_events_lat_hist
+      #(
+        .READ_CNT_WIDTH(READ_CNT_WIDTH),
+        .COUNTER_WIDTH(COUNTER_WIDTH),
+        .LAT_FIFO_DEPTH(LAT_FIFO_DEPTH)
+        )
+      lat_hist
+       (
+        .clk(rdClk),
+        .reset_n(rd_reset_n && eng_reset_n),
+        .rdReqCnt,
+        .rdRespCnt,
+        .hist_sel(lat_hist_sel),
+        .hist_bin(lat_hist_bin),
+        .hist_count(lat_hist_count),
+        .overflow(lat_overflow)
+        );
+
+
     //
     // Forward event info to the engine, crossing to its clock domain.
     //
@@ -138,6 +176,15 @@ module host_chan_events_common
         );
 
 
+    ofs_plat_prim_clock_crossing_reg#(.WIDTH(1 + 5 + COUNTER_WIDTH)) cc_lat_hist
+       (
+        .clk_src(rdClk),
+        .clk_dst(events.eng_clk),
+        .r_in({ lat_overflow, lat_hist_bin, lat_hist_count }),
+        .r_out({ events.lat_hist_overflow, events.lat_hist_bin, events.lat_hist_count })
+        );
+
+
     //
     // Cycle counters, used for determining the FIM interface frequency.
     //
@@ -38,17 +38,31 @@ interface host_chan_events_if
 
     logic unit_is_dwords;
 
+    // Histogram of read latency in host channel clock cycles, counted in
+    // read elements. Bin 0 holds latencies of 0 or 1 cycle and bin i
+    // latencies in [2^i, 2^(i+1)). The engine selects a bin with
+    // lat_hist_sel. lat_hist_count is the count of bin lat_hist_bin, which
+    // follows lat_hist_sel a few cycles later.
+    logic [4:0] lat_hist_sel;
+    logic [4:0] lat_hist_bin;
+    t_counter lat_hist_count;
+    // Set when too many requests were in flight to track them all. The
+    // histogram is incomplete.
+    logic lat_hist_overflow;
+
     // Interface for the host channel monitor
     modport monitor
        (
         input  eng_clk,
         input  eng_reset_n,
         input  enable_cycle_counter,
+        input  lat_hist_sel,
 
         output notEmpty,
         output fim_clk_cycle_count, eng_clk_cycle_count,
         output num_rd_reqs, active_rd_req_sum, max_active_rd_reqs,
-        output unit_is_dwords
+        output unit_is_dwords,
+        output lat_hist_bin, lat_hist_count, lat_hist_overflow
         );
 
     // Interface for the host channel monitor
@@ -57,11 +71,13 @@ interface host_chan_events_if
         output eng_clk,
         output eng_reset_n,
         output enable_cycle_counter,
+        output lat_hist_sel,
 
         input  notEmpty,
         input  fim_clk_cycle_count, eng_clk_cycle_count,
         input  num_rd_reqs, active_rd_req_sum, max_active_rd_reqs,
-        input  unit_is_dwords
+        input  unit_is_dwords,
+        input  lat_hist_bin, lat_hist_count, lat_hist_overflow
         );
 
 endinterface // host_chan_events_if
@@ -0,0 +1,181 @@
+// Copyright (C) 2022 Intel Corporation
+// SPDX-License-Identifier: MIT
+
+//
+// Read latency histogram. Each cycle with new requests pushes a timestamp
+// and the request count into a FIFO. Responses are matched to requests
+// in order: once enough responses have arrived to cover the oldest
+// entry, the entry is retired and its count is added to the histogram
+// bin of its latency. Out of order responses move latency between
+// requests, much like the Little's Law average in host_chan_events_common.
+//
+// Bin 0 counts latencies of 0 and 1 cycles. Bin i > 0 counts latencies
+// from 2^i to 2^(i+1)-1 cycles.
+//
+// The FIFO is block RAM with a registered read, so a new entry reaches
+// the head a few cycles after it is pushed. Latencies shorter than that
+// are reported as the FIFO latency. Host channel latencies are far
+// longer.
+//
+
+`include "ofs_plat_if.vh"
+
+module host_chan_events_lat_hist
+  #(
+    parameter READ_CNT_WIDTH = 3,
+    parameter COUNTER_WIDTH = 48,
+    // Maximum number of cycles with read requests in flight. Must be a
+    // power of 2.
+    parameter LAT_FIFO_DEPTH = 512
+    )
+   (
+    input  logic clk,
+    // Clears the histogram and the overflow flag
+    input  logic reset_n,
+
+    input  logic [READ_CNT_WIDTH-1 : 0] rdReqCnt,
+    input  logic [READ_CNT_WIDTH-1 : 0] rdRespCnt,
+
+    // hist_count is the count of bin hist_bin, which follows hist_sel
+    // one cycle later.
+    input  logic [4:0] hist_sel,
+    output logic [4:0] hist_bin,
+    output logic [COUNTER_WIDTH-1 : 0] hist_count,
+
+    // Set when the FIFO filled. The histogram stops updating until reset.
+    output logic overflow
+    );
+
+    localparam LAT_HIST_BINS = 32;
+    typedef logic [COUNTER_WIDTH-1 : 0] t_counter;
+    typedef logic [31:0] t_timestamp;
+    typedef logic [READ_CNT_WIDTH-1 : 0] t_read_cnt;
+
+    typedef struct packed
+    {
+        t_timestamp ts;
+        t_read_cnt cnt;
+    }
+    t_lat_entry;
+
+    t_timestamp rd_timestamp;
+    always_ff @(posedge clk)
+    begin
+        rd_timestamp <= rd_timestamp + 1;
+
+        if (!reset_n)
+        begin
+            rd_timestamp <= '0;
+        end
+    end
+
+    logic lat_fifo_notFull, lat_fifo_notEmpty;
+    t_lat_entry lat_head;
+    logic lat_retire;
+
+    // Tracking can't recover from a lost entry. The FIFO is held in reset
+    // after an overflow.
+    ofs_plat_prim_fifo_bram
+      #(
+        .N_DATA_BITS($bits(t_lat_entry)),
+        .N_ENTRIES(LAT_FIFO_DEPTH)
+        )
+      lat_fifo
+       (
+        .clk,
+        .reset_n(reset_n && !overflow),
+
+        .enq_data({ rd_timestamp, rdReqCnt }),
+        .enq_en(|(rdReqCnt) && lat_fifo_notFull && !overflow),
+        .notFull(lat_fifo_notFull),
+        .almostFull(),
+
+        .first(lat_head),
+        .deq_en(lat_retire),
+        .notEmpty(lat_fifo_notEmpty)
+        );
+
+    // Responses not yet matched to a FIFO entry. Retirement depends only
+    // on registered state: the FIFO head and the pending count.
+    t_counter rd_rsp_pending;
+    assign lat_retire = lat_fifo_notEmpty &&
+                        (rd_rsp_pending >= COUNTER_WIDTH'(lat_head.cnt));
+
+    always_ff @(posedge clk)
+    begin
+        rd_rsp_pending <= rd_rsp_pending + COUNTER_WIDTH'(rdRespCnt) -
+                          (lat_retire ? COUNTER_WIDTH'(lat_head.cnt) : '0);
+
+        if (|(rdReqCnt) && !lat_fifo_notFull)
+        begin
+            overflow <= 1'b1;
+        end
+
+        if (!reset_n || overflow)
+        begin
+            rd_rsp_pending <= '0;
+        end
+
+        if (!reset_n)
+        begin
+            overflow <= 1'b0;
+        end
+    end
+
+    // Compute the latency of retired entries and then the histogram bin
+    logic lat_valid_q, lat_valid_qq;
+    t_timestamp lat_q;
+    t_read_cnt lat_cnt_q, lat_cnt_qq;
+    logic [4:0] lat_bin_qq;
+
+    function automatic logic [4:0] latency_bin(t_timestamp lat);
+        logic [4:0] bin = '0;
+        for (int i = 1; i < LAT_HIST_BINS; i = i + 1)
+        begin
+            if (lat[i]) bin = 5'(i);
+        end
+        return bin;
+    endfunction // latency_bin
+
+    always_ff @(posedge clk)
+    begin
+        lat_valid_q <= lat_retire && !overflow;
+        lat_q <= rd_timestamp - lat_head.ts;
+        lat_cnt_q <= lat_head.cnt;
+
+        lat_valid_qq <= lat_valid_q;
+        lat_bin_qq <= latency_bin(lat_q);
+        lat_cnt_qq <= lat_cnt_q;
+
+        if (!reset_n)
+        begin
+            lat_valid_q <= 1'b0;
+            lat_valid_qq <= 1'b0;
+        end
+    end
+
+    t_counter lat_hist[LAT_HIST_BINS];
+
+    always_ff @(posedge clk)
+    begin
+        if (lat_valid_qq)
+        begin
+            lat_hist[lat_bin_qq] <= lat_hist[lat_bin_qq] + COUNTER_WIDTH'(lat_cnt_qq);
+        end
+
+        if (!reset_n)
+        begin
+            for (int i = 0; i < LAT_HIST_BINS; i = i + 1)
+            begin
+                lat_hist[i] <= '0;
+            end
+        end
+    end
+
+    always_ff @(posedge clk)
+    begin
+        hist_bin <= hist_sel;
+        hist_count <= lat_hist[hist_sel];
+    end
+
+endmodule // host_chan_events_lat_hist
@@ -15,5 +15,8 @@ module host_chan_events_none
     assign events.fim_clk_cycle_count = '0;
     assign events.num_rd_reqs = '0;
     assign events.active_rd_req_sum = '0;
+    assign events.lat_hist_bin = events.lat_hist_sel;
+    assign events.lat_hist_count = '0;
+    assign events.lat_hist_overflow = 1'b0;
 
 endmodule // host_chan_events_none
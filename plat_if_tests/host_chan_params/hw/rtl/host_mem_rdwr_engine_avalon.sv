@@ -32,6 +32,8 @@
 //      register supports data bus width greater than 64 bytes by shifting
 //      the previous write data mask left 64 bytes each time it is written.
 //
+//   7: Select the read latency histogram bin returned by read register 7.
+//
 //
 // Read status registers:
 //
@@ -64,6 +66,15 @@
 //       [63:32] - Simple checksum portions of lines read (for OOO memory)
 //       [31: 0] - Hash of portions of lines read (for ordered memory interfaces)
 //
+//   7: Read latency histogram bin, measured at the FIM boundary. The bin is
+//      selected by write register 7. Bin 0 counts latencies of 0 or 1 FIM
+//      clock cycles and bin i latencies in [2^i, 2^(i+1)). Units are the
+//      same as register 10.
+//       [63]    - Overflow. Too many requests were in flight to track them
+//                 all and the histogram is incomplete.
+//       [52:48] - Bin index
+//       [47: 0] - Count
+//
 //   8: Total active read lines in flight summed over each active cycle. This is
 //      used to compute latency using Little's Law.
 //
@@ -196,6 +207,7 @@ module host_mem_rdwr_engine_avalon
                         // in order to support bus sizes larger than 64 bytes.
                         wr_data_mask <= $bits(wr_data_mask)'({ wr_data_mask, csrs.wr_data });
                     end
+                4'h7: host_chan_events_if.lat_hist_sel <= csrs.wr_data[4:0];
             endcase // case (csrs.wr_idx)
         end
 
@@ -249,6 +261,9 @@ module host_mem_rdwr_engine_avalon
         csrs.rd_data[3] = 64'(wr_lines_req);
         csrs.rd_data[4] = 64'(wr_bursts_resp);
         csrs.rd_data[5] = { rd_data_sum, rd_data_hash };
+        csrs.rd_data[7] = { host_chan_events_if.lat_hist_overflow, 10'h0,
+                            host_chan_events_if.lat_hist_bin,
+                            48'(host_chan_events_if.lat_hist_count) };
 
         csrs.rd_data[8] = 64'(rd_total_active_lines);
         csrs.rd_data[9] = 64'(wr_total_active_lines);
@@ -38,6 +38,8 @@
 //       [63:32] - B mask
 //       [31: 0] - R mask
 //
+//   7: Select the read latency histogram bin returned by read register 7.
+//
 //
 // Read status registers:
 //
@@ -72,6 +74,15 @@
 //
 //   6: Number of read burst responses (using AXI RLAST flag)
 //
+//   7: Read latency histogram bin, measured at the FIM boundary. The bin is
+//      selected by write register 7. Bin 0 counts latencies of 0 or 1 FIM
+//      clock cycles and bin i latencies in [2^i, 2^(i+1)). Units are the
+//      same as register 10.
+//       [63]    - Overflow. Too many requests were in flight to track them
+//                 all and the histogram is incomplete.
+//       [52:48] - Bin index
+//       [47: 0] - Count
+//
 //   8: Total active read lines in flight summed over each active cycle. This is
 //      used to compute latency using Little's Law.
 //
@@ -219,6 +230,7 @@ module host_mem_rdwr_engine_axi
                         wr_data_mask <= $bits(wr_data_mask)'({ wr_data_mask, csrs.wr_data });
                     end
                 4'h6: ready_mask <= csrs.wr_data;
+                4'h7: host_chan_events_if.lat_hist_sel <= csrs.wr_data[4:0];
             endcase // case (csrs.wr_idx)
         end
 
@@ -274,6 +286,9 @@ module host_mem_rdwr_engine_axi
         csrs.rd_data[4] = 64'(wr_bursts_resp);
         csrs.rd_data[5] = { rd_data_sum, rd_data_hash };
         csrs.rd_data[6] = 64'(rd_bursts_resp);
+        csrs.rd_data[7] = { host_chan_events_if.lat_hist_overflow, 10'h0,
+                            host_chan_events_if.lat_hist_bin,
+                            48'(host_chan_events_if.lat_hist_count) };
 
         csrs.rd_data[8] = 64'(rd_total_active_lines);
         csrs.rd_data[9] = 64'(wr_total_active_lines);
@@ -0,0 +1,204 @@
+// Copyright (C) 2022 Intel Corporation
+// SPDX-License-Identifier: MIT
+
+//
+// Unit testbench for host_chan_events_lat_hist. Phases of read requests
+// are answered in order after a fixed number of cycles. Each latency is
+// chosen well inside one histogram bin, so the bins that must count each
+// phase are known exactly. After all phases, every bin is read back
+// through hist_sel and compared with the expected counts. A final phase
+// fills the FIFO and checks that overflow is flagged and that the
+// histogram stops updating.
+//
+// Run with run_tb.sh in this directory.
+//
+
+`timescale 1ps/1ps
+
+module host_chan_events_lat_hist_tb;
+
+    localparam READ_CNT_WIDTH = 3;
+    localparam COUNTER_WIDTH = 48;
+    localparam LAT_FIFO_DEPTH = 64;
+
+    typedef logic [READ_CNT_WIDTH-1 : 0] t_read_cnt;
+
+    logic clk = 1'b0;
+    always #5000 clk = ~clk;
+
+    logic reset_n;
+    t_read_cnt rdReqCnt, rdRespCnt;
+    logic [4:0] hist_sel, hist_bin;
+    logic [COUNTER_WIDTH-1 : 0] hist_count;
+    logic overflow;
+
+    host_chan_events_lat_hist
+      #(
+        .READ_CNT_WIDTH(READ_CNT_WIDTH),
+        .COUNTER_WIDTH(COUNTER_WIDTH),
+        .LAT_FIFO_DEPTH(LAT_FIFO_DEPTH)
+        )
+      dut
+       (
+        .clk,
+        .reset_n,
+        .rdReqCnt,
+        .rdRespCnt,
+        .hist_sel,
+        .hist_bin,
+        .hist_count,
+        .overflow
+        );
+
+    //
+    // Responses are queued by the request driver with the cycle in which
+    // they are due. Requests of a phase share one latency, so the queue
+    // stays in cycle order.
+    //
+    typedef struct
+    {
+        longint due;
+        t_read_cnt cnt;
+    }
+    t_rsp;
+
+    t_rsp rsp_queue[$];
+    longint cycle;
+
+    always_ff @(posedge clk)
+    begin
+        cycle <= cycle + 1;
+        if (!reset_n) cycle <= 0;
+    end
+
+    always @(negedge clk)
+    begin
+        rdRespCnt <= '0;
+        if ((rsp_queue.size() != 0) && (rsp_queue[0].due <= cycle))
+        begin
+            rdRespCnt <= rsp_queue[0].cnt;
+            void'(rsp_queue.pop_front());
+        end
+    end
+
+    longint expected[32];
+    int num_errors;
+
+    function automatic int latency_bin(longint lat);
+        int bin = 0;
+        for (int i = 1; i < 32; i = i + 1)
+        begin
+            if (lat[i]) bin = i;
+        end
+        return bin;
+    endfunction
+
+    //
+    // Issue num_reqs requests of cnt lines, one per cycle, each answered
+    // latency cycles later. The histogram measures from the cycle a
+    // request is presented to the cycle after its response is counted,
+    // so the expected bin is that of latency + 1.
+    //
+    task automatic run_phase(int num_reqs, t_read_cnt cnt, int latency,
+                             bit expect_counted);
+        $display("Phase: %0d requests of %0d lines, latency %0d cycles",
+                 num_reqs, cnt, latency);
+
+        for (int i = 0; i < num_reqs; i = i + 1)
+        begin
+            @(negedge clk);
+            rdReqCnt <= cnt;
+            rsp_queue.push_back('{ cycle + latency, cnt });
+            if (expect_counted)
+                expected[latency_bin(latency + 1)] += cnt;
+        end
+
+        @(negedge clk);
+        rdReqCnt <= '0;
+
+        // Drain
+        repeat (latency + 20) @(posedge clk);
+    endtask
+
+    task automatic check_bins();
+        for (int b = 0; b < 32; b = b + 1)
+        begin
+            @(negedge clk);
+            hist_sel <= 5'(b);
+            repeat (2) @(posedge clk);
+            #1;
+
+            if ((hist_bin != 5'(b)) || (hist_count != expected[b]))
+            begin
+                $display("ERROR: bin %0d: read bin %0d count %0d, expected %0d",
+                         b, hist_bin, hist_count, expected[b]);
+                num_errors += 1;
+            end
+            else if (expected[b] != 0)
+            begin
+                $display("  Bin %0d: %0d", b, hist_count);
+            end
+        end
+    endtask
+
+    initial
+    begin
+        num_errors = 0;
+        for (int b = 0; b < 32; b = b + 1) expected[b] = 0;
+
+        reset_n = 1'b0;
+        rdReqCnt = '0;
+        hist_sel = '0;
+        repeat (10) @(posedge clk);
+        @(negedge clk);
+        reset_n <= 1'b1;
+        repeat (5) @(posedge clk);
+
+        // Latencies are far from bin boundaries, leaving room for the
+        // FIFO's read latency.
+        run_phase(10, 1, 9, 1);     // bin 3 (8-15)
+        run_phase(20, 1, 22, 1);    // bin 4 (16-31)
+        run_phase(7, 3, 45, 1);     // bin 5 (32-63), 3 lines each
+        run_phase(30, 2, 90, 1);    // bin 6 (64-127)
+        run_phase(5, 1, 700, 1);    // bin 9 (512-1023)
+        check_bins();
+
+        if (overflow)
+        begin
+            $display("ERROR: unexpected overflow");
+            num_errors += 1;
+        end
+
+        // More requests in flight than FIFO entries. Nothing more is
+        // counted once the FIFO overflows.
+        run_phase(4 * LAT_FIFO_DEPTH, 1, 2 * LAT_FIFO_DEPTH, 0);
+        if (!overflow)
+        begin
+            $display("ERROR: overflow not flagged");
+            num_errors += 1;
+        end
+        check_bins();
+
+        // Reset clears the histogram and the overflow flag
+        @(negedge clk);
+        reset_n <= 1'b0;
+        repeat (2) @(posedge clk);
+        @(negedge clk);
+        reset_n <= 1'b1;
+        for (int b = 0; b < 32; b = b + 1) expected[b] = 0;
+        run_phase(10, 1, 150, 1);   // bin 7 (128-255)
+        check_bins();
+        if (overflow)
+        begin
+            $display("ERROR: overflow not cleared by reset");
+            num_errors += 1;
+        end
+
+        if (num_errors == 0)
+            $display("PASS");
+        else
+            $display("FAIL: %0d errors", num_errors);
+        $finish;
+    end
+
+endmodule // host_chan_events_lat_hist_tb
@@ -0,0 +1,59 @@
+#!/bin/bash
+# Copyright (C) 2022 Intel Corporation
+# SPDX-License-Identifier: MIT
+
+#
+# Run the host_chan_events_lat_hist unit testbench with Questa/ModelSim
+# or VCS. The FIFO primitive is built on the Quartus scfifo, so the
+# Quartus simulation library is required. The PIM's ofs_plat_if.vh is
+# suppressed: it needs a configured platform and nothing here uses it.
+#
+# Usage: run_tb.sh [vcs|questa]
+#
+
+set -e
+
+SCRIPT_DIR="$(dirname "$(readlink -f "${BASH_SOURCE[0]}")")"
+REPO_DIR="$(readlink -f "${SCRIPT_DIR}/../../../../..")"
+
+if [ -z "$QUARTUS_HOME" ]; then
+   QUARTUS_HOME="${QUARTUS_ROOTDIR}"
+fi
+if [ -z "$QUARTUS_HOME" ]; then
+   echo "Set QUARTUS_HOME to the Quartus install path"
+   exit 1
+fi
+
+sim="$1"
+if [ -z "$sim" ]; then
+   if [ -x "$(command -v vsim)" ]; then
+      sim="questa"
+   elif [ -x "$(command -v vcs)" ]; then
+      sim="vcs"
+   fi
+fi
+
+SRCS=(
+   "${QUARTUS_HOME}/eda/sim_lib/altera_mf.v"
+   "${REPO_DIR}/plat_if_develop/ofs_plat_if/src/rtl/utils/prims/ofs_plat_prim_fifo_bram.sv"
+   "${REPO_DIR}/plat_if_tests/host_chan_params/hw/rtl/events/host_chan_events_lat_hist.sv"
+   "${SCRIPT_DIR}/host_chan_events_lat_hist_tb.sv"
+)
+DEFS="+define+__OFS_PLAT_IF_VH__"
+
+mkdir -p work
+cd work
+
+if [ "$sim" == "questa" ] || [ "$sim" == "modelsim" ]; then
+   vlib work
+   vlog -sv ${DEFS} "${SRCS[@]}"
+   vsim -c -do "run -all; quit -f" host_chan_events_lat_hist_tb | tee sim.log
+elif [ "$sim" == "vcs" ]; then
+   vcs -sverilog ${DEFS} -top host_chan_events_lat_hist_tb "${SRCS[@]}" -o simv
+   ./simv | tee sim.log
+else
+   echo "No RTL simulator detected. Usage: $0 [vcs|questa]"
+   exit 1
+fi
+
+grep -q "^PASS" sim.log
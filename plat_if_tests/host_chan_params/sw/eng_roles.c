@@ -0,0 +1,202 @@
+// Copyright (C) 2022 Intel Corporation
+// SPDX-License-Identifier: MIT
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <errno.h>
+
+#include "eng_roles.h"
+
+#define MAX_TOKENS 5
+
+
+int
+engRolesSplitLine(char *line, char **tok, int max_tok)
+{
+    char *comment = strchr(line, '#');
+    if (comment) *comment = '\0';
+
+    int n_tok = 0;
+    for (char *t = strtok(line, " \t\r\n"); t; t = strtok(NULL, " \t\r\n"))
+    {
+        if (n_tok == max_tok) return -1;
+        tok[n_tok++] = t;
+    }
+
+    return n_tok;
+}
+
+
+int
+engRolesFindAccel(
+    const char *spec,
+    uint32_t num_accels,
+    const t_eng_roles_accel *accels)
+{
+    char *endptr;
+    unsigned long idx = strtoul(spec, &endptr, 0);
+    if ((endptr != spec) && (*endptr == '\0'))
+    {
+        return (idx < num_accels) ? (int)idx : -1;
+    }
+
+    for (uint32_t a = 0; a < num_accels; a += 1)
+    {
+        if (0 == strcasecmp(spec, accels[a].name)) return a;
+    }
+
+    return -1;
+}
+
+
+int
+engRolesParseEngines(
+    const char *spec,
+    uint32_t num_engines,
+    uint32_t *first,
+    uint32_t *last)
+{
+    if (0 == strcmp(spec, "*"))
+    {
+        *first = 0;
+        *last = num_engines - 1;
+        return 0;
+    }
+
+    char *endptr;
+    unsigned long f = strtoul(spec, &endptr, 0);
+    if (endptr == spec) return 1;
+
+    unsigned long l = f;
+    if (*endptr == '-')
+    {
+        const char *p = endptr + 1;
+        l = strtoul(p, &endptr, 0);
+        if (endptr == p) return 1;
+    }
+
+    if ((*endptr != '\0') || (f > l) || (l >= num_engines)) return 1;
+
+    *first = f;
+    *last = l;
+    return 0;
+}
+
+
+int
+engRolesParseRole(const char *s, t_eng_role *role)
+{
+    if (0 == strcasecmp(s, "read"))
+        *role = ENG_ROLE_READ;
+    else if (0 == strcasecmp(s, "write"))
+        *role = ENG_ROLE_WRITE;
+    else if ((0 == strcasecmp(s, "rw")) || (0 == strcasecmp(s, "read+write")))
+        *role = ENG_ROLE_RW;
+    else if (0 == strcasecmp(s, "idle"))
+        *role = ENG_ROLE_IDLE;
+    else
+        return 1;
+
+    return 0;
+}
+
+
+uint32_t
+engRolesFirstEngine(const t_eng_roles_accel *accels, uint32_t a)
+{
+    uint32_t first = 0;
+    for (uint32_t i = 0; i < a; i += 1)
+    {
+        first += accels[i].num_engines;
+    }
+    return first;
+}
+
+
+const char *
+engRoleName(t_eng_role role)
+{
+    switch (role)
+    {
+      case ENG_ROLE_READ: return "read";
+      case ENG_ROLE_WRITE: return "write";
+      case ENG_ROLE_RW: return "rw";
+      default: return "idle";
+    }
+}
+
+
+int
+engRolesLoad(
+    const char *path,
+    uint32_t num_accels,
+    t_eng_roles_accel *accels,
+    t_eng_role *roles)
+{
+    FILE *f = fopen(path, "r");
+    if (NULL == f)
+    {
+        fprintf(stderr, "Failed to open roles file %s: %s\n", path, strerror(errno));
+        return 1;
+    }
+
+    uint32_t num_engines = engRolesFirstEngine(accels, num_accels);
+    memset(roles, 0, num_engines * sizeof(t_eng_role));
+
+    char line[256];
+    int line_num = 0;
+    int err = 0;
+    while (! err && fgets(line, sizeof(line), f))
+    {
+        line_num += 1;
+
+        char *tok[MAX_TOKENS];
+        int n_tok = engRolesSplitLine(line, tok, MAX_TOKENS);
+        if (n_tok == 0) continue;
+
+        err = 1;
+        int a = (n_tok > 1) ? engRolesFindAccel(tok[1], num_accels, accels) : -1;
+
+        if ((0 == strcmp(tok[0], "engine")) && (n_tok == 4))
+        {
+            uint32_t first, last;
+            t_eng_role role;
+            if (a < 0)
+                fprintf(stderr, "%s:%d: unknown accelerator %s\n", path, line_num, tok[1]);
+            else if (engRolesParseEngines(tok[2], accels[a].num_engines, &first, &last))
+                fprintf(stderr, "%s:%d: invalid engines %s (accelerator %d has %d)\n",
+                        path, line_num, tok[2], a, accels[a].num_engines);
+            else if (engRolesParseRole(tok[3], &role))
+                fprintf(stderr, "%s:%d: invalid role %s\n", path, line_num, tok[3]);
+            else
+            {
+                uint32_t base = engRolesFirstEngine(accels, a);
+                for (uint32_t e = first; e <= last; e += 1)
+                {
+                    roles[base + e] = role;
+                }
+                err = 0;
+            }
+        }
+        else if ((0 == strcmp(tok[0], "link")) && (n_tok == 3))
+        {
+            if (a < 0)
+                fprintf(stderr, "%s:%d: unknown accelerator %s\n", path, line_num, tok[1]);
+            else
+            {
+                snprintf(accels[a].link, sizeof(accels[a].link), "%s", tok[2]);
+                err = 0;
+            }
+        }
+        else
+        {
+            fprintf(stderr, "%s:%d: expected \"engine <accel> <engines> <role>\" or "
+                            "\"link <accel> <name>\"\n", path, line_num);
+        }
+    }
+
+    fclose(f);
+    return err;
+}
@@ -0,0 +1,93 @@
+// Copyright (C) 2022 Intel Corporation
+// SPDX-License-Identifier: MIT
+
+//
+// Engine roles for multi-accelerator latency tests, loaded from a text
+// file (--roles). Each line is one of:
+//
+//   engine <accel> <engines> <role>
+//   link <accel> <name>
+//
+// <accel> is the accelerator's index, in the order accelerators were
+// opened, or its PCIe address (ssss:bb:dd.f). Software models are named
+// model0, model1, etc. <engines> is an engine index within the
+// accelerator, a range such as 0-7, or * for all of the accelerator's
+// engines. <role> is read, write, rw or idle.
+//
+// Engines that are not listed are idle. Later lines override earlier ones.
+// "link" lines group accelerators for bandwidth reporting, e.g. to combine
+// VFs on one card or to split functions that share a bus. Text following
+// '#' is a comment.
+//
+
+#ifndef __ENG_ROLES_H__
+#define __ENG_ROLES_H__
+
+#include <stdint.h>
+
+#define ENG_ROLES_MAX_NAME 32
+
+//
+// Values match the latency test mode bits: 1 reads, 2 writes.
+//
+typedef enum
+{
+    ENG_ROLE_IDLE = 0,
+    ENG_ROLE_READ = 1,
+    ENG_ROLE_WRITE = 2,
+    ENG_ROLE_RW = 3
+}
+t_eng_role;
+
+//
+// Accelerator description passed to engRolesLoad(). Engines of all
+// accelerators are numbered globally in array order.
+//
+typedef struct
+{
+    // PCIe address or model name, matched against <accel>
+    char name[ENG_ROLES_MAX_NAME];
+    // Link used for reporting. The caller sets a default, which "link"
+    // lines replace.
+    char link[ENG_ROLES_MAX_NAME];
+    uint32_t num_engines;
+}
+t_eng_roles_accel;
+
+//
+// Parse the roles file at path. roles is indexed by global engine and
+// must hold the total number of engines. Returns 0 on success. Errors are
+// reported on stderr with the file and line number.
+//
+int engRolesLoad(
+    const char *path,
+    uint32_t num_accels,
+    t_eng_roles_accel *accels,
+    t_eng_role *roles);
+
+const char *engRoleName(t_eng_role role);
+
+//
+// Parsing helpers, shared with other files that name engines the same way.
+//
+
+// Strip a '#' comment and split line into whitespace separated tokens.
+// Returns the number of tokens or -1 if there are more than max_tok.
+int engRolesSplitLine(char *line, char **tok, int max_tok);
+
+// Index of the accelerator named by spec (index or name), or -1.
+int engRolesFindAccel(const char *spec, uint32_t num_accels,
+                      const t_eng_roles_accel *accels);
+
+// Parse an engine index, range or "*" of an accelerator with num_engines
+// engines. Returns 0 on success.
+int engRolesParseEngines(const char *spec, uint32_t num_engines,
+                         uint32_t *first, uint32_t *last);
+
+// Parse a role name. Returns 0 on success.
+int engRolesParseRole(const char *s, t_eng_role *role);
+
+// Global number of accelerator a's first engine
+uint32_t engRolesFirstEngine(const t_eng_roles_accel *accels, uint32_t a);
+
+#endif // __ENG_ROLES_H__
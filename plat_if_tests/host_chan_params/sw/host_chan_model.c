@@ -0,0 +1,630 @@
+// Copyright (C) 2022 Intel Corporation
+// SPDX-License-Identifier: MIT
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <time.h>
+#include <pthread.h>
+#include <uuid/uuid.h>
+
+#include "afu_json_info.h"
+#include "hash32.h"
+#include "host_chan_model.h"
+
+//
+// Model configuration. Engines look like AXI-MM engines with a 64 byte
+// data bus, virtual addressing and ordered read responses. The clocks
+// are nominal -- cycle counters are derived from elapsed time, so
+// bandwidth and latency reported by the test are those of the model.
+//
+#define MODEL_CLK_MHZ 250
+#define MODEL_PCLK_MHZ 100
+#define MODEL_LINE_BYTES 64
+#define MODEL_MAX_BURST 64
+
+// Test ID of the AXI host_chan_params AFU
+#define MODEL_TEST_ID_L 0x9f5e0d990a3ae963
+#define MODEL_TEST_ID_H 0x548ab9512fc74b7c
+
+typedef struct
+{
+    // Write registers
+    uint64_t rd_base_addr;
+    uint64_t wr_base_addr;
+    uint64_t rd_ctrl;
+    uint64_t wr_ctrl;
+    uint64_t addr_offset_mask;
+    uint64_t wr_data_mask;
+    uint32_t lat_hist_sel;
+
+    // Execution state
+    bool run;
+    bool active;
+    bool rd_done;
+    bool wr_done;
+    bool rd_unlimited;
+    bool wr_unlimited;
+    uint64_t rd_cur_addr_offset;
+    uint64_t wr_cur_addr_offset;
+    uint32_t rd_bursts_left;
+    uint32_t wr_bursts_left;
+
+    // The DMA thread is moving data for the engine without holding the
+    // model lock. Engines stay active until the burst is complete.
+    bool in_flight;
+    // Incremented when the engine is started. Bursts in flight across a
+    // restart are dropped.
+    uint64_t generation;
+
+    // Time active since the engine was started
+    uint64_t active_ns;
+    uint64_t active_start_ns;
+
+    // Read registers. Registers 0, 7, 14 and 15 are computed when read.
+    uint64_t csr[16];
+
+    // Read latency histogram, in log2 bins of FIM cycles
+    uint64_t lat_hist[32];
+}
+t_model_engine;
+
+struct t_host_chan_model
+{
+    t_csr_model csrs;
+    uint32_t num_engines;
+
+    pthread_mutex_t lock;
+    pthread_cond_t work_cv;
+    pthread_t dma_tid;
+    bool shutdown;
+
+    uint64_t afu_id_l;
+    uint64_t afu_id_h;
+
+    uint64_t active_mask;
+
+    // Time with at least one engine active since the cycle counters were
+    // reset. This drives the execution cycle counters.
+    uint64_t active_ns;
+    uint64_t active_start_ns;
+
+    uint64_t snap_count;
+    uint64_t snap_active_ns;
+    uint64_t (*snap_csr)[16];
+
+    t_model_engine eng[];
+};
+
+
+static uint64_t
+nowNs(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static uint64_t
+nsToCycles(uint64_t ns, uint64_t mhz)
+{
+    return ns * mhz / 1000;
+}
+
+static uint64_t
+modelActiveNs(const t_host_chan_model *m, uint64_t now)
+{
+    uint64_t ns = m->active_ns;
+    if (m->active_mask) ns += now - m->active_start_ns;
+    return ns;
+}
+
+static uint64_t
+engineActiveNs(const t_model_engine *eng, uint64_t now)
+{
+    uint64_t ns = eng->active_ns;
+    if (eng->active) ns += now - eng->active_start_ns;
+    return ns;
+}
+
+
+//
+// Update an engine's active flag, along with the time counters that run
+// only while engines are active. Called with the lock held.
+//
+static void
+setEngineActive(t_host_chan_model *m, uint32_t e, bool active, uint64_t now)
+{
+    t_model_engine *eng = &m->eng[e];
+    if (eng->active == active) return;
+
+    if (active)
+    {
+        eng->active_start_ns = now;
+        if (! m->active_mask) m->active_start_ns = now;
+        m->active_mask |= (uint64_t)1 << e;
+    }
+    else
+    {
+        eng->active_ns += now - eng->active_start_ns;
+        m->active_mask &= ~((uint64_t)1 << e);
+        if (! m->active_mask) m->active_ns += now - m->active_start_ns;
+    }
+
+    eng->active = active;
+}
+
+
+//
+// Engine read register. Called with the lock held.
+//
+static uint64_t
+engineCsr(const t_host_chan_model *m, uint32_t e, uint32_t idx, uint64_t now)
+{
+    const t_model_engine *eng = &m->eng[e];
+
+    switch (idx)
+    {
+      case 0:
+        return ((uint64_t)(MODEL_LINE_BYTES / 64) << 51) |
+               ((uint64_t)1 << 50) |            // Masked writes
+               ((uint64_t)(e & 31) << 42) |
+               ((uint64_t)3 << 40) |            // Virtual addresses
+               ((uint64_t)1 << 39) |            // Ordered read responses
+               ((uint64_t)2 << 35) |            // AXI-MM
+               ((uint64_t)eng->active << 34) |
+               ((uint64_t)eng->run << 33) |
+               ((uint64_t)32 << 16) |           // Address offset width
+               MODEL_MAX_BURST;
+      case 7:
+        // Latency histogram bin selected by write register 7
+        return ((uint64_t)eng->lat_hist_sel << 48) | eng->lat_hist[eng->lat_hist_sel];
+      case 14:
+      case 15:
+        // FIM and engine clock cycles. The FIM runs at the engine clock.
+        return nsToCycles(engineActiveNs(eng, now), MODEL_CLK_MHZ);
+      default:
+        return eng->csr[idx];
+    }
+}
+
+
+//
+// Reset an engine's counters and start it, like the state_reset then
+// state_run sequence in the CSR manager. Called with the lock held.
+//
+static void
+startEngine(t_host_chan_model *m, uint32_t e, uint64_t now)
+{
+    t_model_engine *eng = &m->eng[e];
+
+    memset(eng->csr, 0, sizeof(eng->csr));
+    memset(eng->lat_hist, 0, sizeof(eng->lat_hist));
+    // The read hash resets to its initial value, the sum to 0
+    eng->csr[5] = HASH32_DEFAULT_INIT;
+    eng->generation += 1;
+    eng->active_ns = 0;
+    eng->active_start_ns = now;
+
+    eng->rd_cur_addr_offset = (eng->rd_ctrl >> 16) & 0xffff;
+    eng->rd_bursts_left = (eng->rd_ctrl >> 32) & 0xffff;
+    eng->rd_unlimited = (eng->rd_bursts_left == 0);
+    eng->rd_done = (eng->rd_base_addr == 0);
+
+    eng->wr_cur_addr_offset = (eng->wr_ctrl >> 16) & 0xffff;
+    eng->wr_bursts_left = (eng->wr_ctrl >> 32) & 0xffff;
+    eng->wr_unlimited = (eng->wr_bursts_left == 0);
+    eng->wr_done = (eng->wr_base_addr == 0);
+
+    eng->run = true;
+    setEngineActive(m, e, ! (eng->rd_done && eng->wr_done), now);
+}
+
+
+static uint32_t
+burstLen(uint64_t ctrl)
+{
+    uint32_t len = ctrl & 0xffff;
+    if ((len == 0) || (len > MODEL_MAX_BURST)) len = MODEL_MAX_BURST;
+    return len;
+}
+
+// Histogram bin of a latency. Bin 0 holds latencies of 0 or 1 cycles and
+// bin i latencies in [2^i, 2^(i+1)).
+static uint32_t
+latencyBin(uint64_t cycles)
+{
+    if (cycles < 2) return 0;
+    uint32_t bin = 63 - __builtin_clzll(cycles);
+    return (bin < 31) ? bin : 31;
+}
+
+static void*
+linePtr(uint64_t line_addr)
+{
+    return (void*)(uintptr_t)(line_addr * MODEL_LINE_BYTES);
+}
+
+
+//
+// Move one read burst and one write burst for an engine. The lock is held
+// on entry and exit but released while data moves.
+//
+static void
+stepEngine(t_host_chan_model *m, uint32_t e)
+{
+    t_model_engine *eng = &m->eng[e];
+    if (! eng->run) return;
+
+    // Capture the state of the bursts
+    uint64_t generation = eng->generation;
+    bool do_rd = ! eng->rd_done;
+    bool do_wr = ! eng->wr_done;
+    uint64_t mask = eng->addr_offset_mask;
+    uint64_t rd_line = eng->rd_base_addr + eng->rd_cur_addr_offset;
+    uint32_t rd_len = burstLen(eng->rd_ctrl);
+    uint64_t wr_base = eng->wr_base_addr;
+    uint64_t wr_offset = eng->wr_cur_addr_offset;
+    uint32_t wr_len = burstLen(eng->wr_ctrl);
+    uint64_t wr_data_mask = eng->wr_data_mask;
+    uint32_t rd_hash = eng->csr[5];
+    uint32_t rd_sum = eng->csr[5] >> 32;
+    eng->in_flight = true;
+    pthread_mutex_unlock(&m->lock);
+
+    uint64_t rd_ns = 0;
+    uint64_t wr_ns = 0;
+    uint64_t t0 = nowNs();
+
+    if (do_rd)
+    {
+        // Hash the high 16 bits and the low 16 bits of each line, as the
+        // engine does.
+        for (uint32_t i = 0; i < rd_len; i += 1)
+        {
+            const volatile uint16_t *line = linePtr(rd_line + i);
+            uint32_t v = ((uint32_t)line[MODEL_LINE_BYTES/2 - 1] << 16) | line[0];
+            rd_hash = hash32(rd_hash, v);
+            rd_sum += v;
+        }
+
+        uint64_t t1 = nowNs();
+        rd_ns = t1 - t0;
+        t0 = t1;
+    }
+
+    if (do_wr)
+    {
+        // The low 64 bits of each line hold the line address and the high
+        // 64 bits are 0xdeadbeef. Bytes outside the data mask are left
+        // unchanged.
+        uint64_t data[MODEL_LINE_BYTES / 8];
+        memset(data, 0, sizeof(data));
+        data[MODEL_LINE_BYTES/8 - 1] = 0xdeadbeef;
+
+        for (uint32_t i = 0; i < wr_len; i += 1)
+        {
+            data[0] = wr_base + wr_offset;
+            uint8_t *dst = linePtr(wr_base + wr_offset);
+
+            if (wr_data_mask == ~(uint64_t)0)
+            {
+                memcpy(dst, data, MODEL_LINE_BYTES);
+            }
+            else
+            {
+                const uint8_t *src = (const uint8_t*)data;
+                for (uint32_t b = 0; b < MODEL_LINE_BYTES; b += 1)
+                {
+                    if ((wr_data_mask >> b) & 1) dst[b] = src[b];
+                }
+            }
+
+            wr_offset = (wr_offset + 1) & mask;
+        }
+
+        wr_ns = nowNs() - t0;
+    }
+
+    pthread_mutex_lock(&m->lock);
+    eng->in_flight = false;
+
+    // Restarted while the burst was in flight?
+    if (generation != eng->generation) return;
+
+    if (do_rd)
+    {
+        // Every line is in flight until the burst completes. The FIM
+        // boundary counters match the engine's, since there is no FIM.
+        uint64_t rd_cycles = nsToCycles(rd_ns, MODEL_CLK_MHZ);
+        uint64_t active = rd_len * rd_cycles;
+        eng->csr[1] += 1;
+        eng->csr[2] += rd_len;
+        eng->csr[5] = ((uint64_t)rd_sum << 32) | rd_hash;
+        eng->csr[6] += 1;
+        eng->csr[8] += active;
+        eng->csr[10] += rd_len;
+        eng->csr[11] += active;
+        if (eng->csr[12] < rd_len) eng->csr[12] = rd_len;
+        if (eng->csr[13] < rd_len) eng->csr[13] = rd_len;
+        eng->lat_hist[latencyBin(rd_cycles)] += rd_len;
+
+        eng->rd_cur_addr_offset = (eng->rd_cur_addr_offset + rd_len) & mask;
+        eng->rd_bursts_left -= 1;
+        eng->rd_done = ! eng->rd_unlimited && (eng->rd_bursts_left == 0);
+    }
+
+    if (do_wr)
+    {
+        eng->csr[3] += wr_len;
+        eng->csr[4] += 1;
+        eng->csr[9] += wr_len * nsToCycles(wr_ns, MODEL_CLK_MHZ);
+
+        eng->wr_cur_addr_offset = wr_offset;
+        eng->wr_bursts_left -= 1;
+        eng->wr_done = ! eng->wr_unlimited && (eng->wr_bursts_left == 0);
+    }
+
+    if (! eng->run || (eng->rd_done && eng->wr_done))
+    {
+        setEngineActive(m, e, false, nowNs());
+    }
+}
+
+
+//
+// The DMA thread moves data for all active engines, round robin, one
+// burst at a time.
+//
+static void*
+dmaThread(void *args)
+{
+    t_host_chan_model *m = (t_host_chan_model*)args;
+
+    pthread_mutex_lock(&m->lock);
+    while (! m->shutdown)
+    {
+        if (! m->active_mask)
+        {
+            pthread_cond_wait(&m->work_cv, &m->lock);
+            continue;
+        }
+
+        for (uint32_t e = 0; e < m->num_engines; e += 1)
+        {
+            if (m->active_mask & ((uint64_t)1 << e))
+            {
+                stepEngine(m, e);
+            }
+        }
+    }
+    pthread_mutex_unlock(&m->lock);
+
+    return NULL;
+}
+
+
+static uint64_t
+modelRead(void *ctx, uint64_t idx)
+{
+    t_host_chan_model *m = (t_host_chan_model*)ctx;
+    uint64_t now = nowNs();
+    uint64_t v = 0;
+
+    pthread_mutex_lock(&m->lock);
+
+    if ((idx >= CSR_ENG_BASE) && (idx < CSR_ENG_SNAP_BASE))
+    {
+        uint32_t e = (idx >> 4) & 63;
+        if (e < m->num_engines) v = engineCsr(m, e, idx & 15, now);
+    }
+    else if ((idx >= CSR_ENG_SNAP_BASE) && (idx < CSR_ENG_SNAP_BASE + 0x400))
+    {
+        uint32_t e = (idx >> 4) & 63;
+        if (e < m->num_engines) v = m->snap_csr[e][idx & 15];
+    }
+    else
+    {
+        switch (idx)
+        {
+          case CSR_AFU_DFH:
+            // AFU feature type, end of list
+            v = ((uint64_t)1 << 60) | ((uint64_t)1 << 40);
+            break;
+          case CSR_AFU_ID_L:
+            v = m->afu_id_l;
+            break;
+          case CSR_AFU_ID_H:
+            v = m->afu_id_h;
+            break;
+          case CSR_RD_CTRL_CONFIG_INFO:
+            v = (MODEL_PCLK_MHZ << 8) | m->num_engines;
+            break;
+          case CSR_RD_CTRL_ENG_RUN_MASK:
+            for (uint32_t e = 0; e < m->num_engines; e += 1)
+            {
+                if (m->eng[e].run) v |= (uint64_t)1 << e;
+            }
+            break;
+          case CSR_RD_CTRL_ENG_ACTIVE_MASK:
+            v = m->active_mask;
+            break;
+          case CSR_RD_CTRL_ENG_CYCLES:
+            v = nsToCycles(modelActiveNs(m, now), MODEL_CLK_MHZ);
+            break;
+          case CSR_RD_CTRL_ENG_PCLK_CYCLES:
+            v = nsToCycles(modelActiveNs(m, now), MODEL_PCLK_MHZ);
+            break;
+          case CSR_RD_CTRL_SNAP_CYCLES:
+            v = nsToCycles(m->snap_active_ns, MODEL_CLK_MHZ);
+            break;
+          case CSR_RD_CTRL_SNAP_PCLK_CYCLES:
+            v = nsToCycles(m->snap_active_ns, MODEL_PCLK_MHZ);
+            break;
+          case CSR_RD_CTRL_SNAP_COUNT:
+            v = m->snap_count;
+            break;
+          case CSR_ENG_GLOB_BASE + 0:
+            v = MODEL_TEST_ID_L;
+            break;
+          case CSR_ENG_GLOB_BASE + 1:
+            v = MODEL_TEST_ID_H;
+            break;
+          case CSR_ENG_GLOB_BASE + 2:
+            v = m->num_engines;
+            break;
+        }
+    }
+
+    pthread_mutex_unlock(&m->lock);
+    return v;
+}
+
+
+static void
+modelWrite(void *ctx, uint64_t idx, uint64_t value)
+{
+    t_host_chan_model *m = (t_host_chan_model*)ctx;
+    uint64_t now = nowNs();
+
+    pthread_mutex_lock(&m->lock);
+
+    if ((idx >= CSR_ENG_BASE) && (idx < CSR_ENG_SNAP_BASE))
+    {
+        uint32_t e = (idx >> 4) & 63;
+        if (e < m->num_engines)
+        {
+            t_model_engine *eng = &m->eng[e];
+            switch (idx & 15)
+            {
+              case 0: eng->rd_base_addr = value; break;
+              case 1: eng->wr_base_addr = value; break;
+              case 2: eng->rd_ctrl = value; break;
+              case 3: eng->wr_ctrl = value; break;
+              case 4: eng->addr_offset_mask = value & 0xffffffff; break;
+              // The data bus is 64 bytes, so one write holds the whole mask
+              case 5: eng->wr_data_mask = value; break;
+              case 7: eng->lat_hist_sel = value & 31; break;
+            }
+        }
+    }
+    else if (idx == CSR_WR_CTRL_ENG_ENABLE_MASK)
+    {
+        uint64_t run_mask = 0;
+        for (uint32_t e = 0; e < m->num_engines; e += 1)
+        {
+            if (m->eng[e].run) run_mask |= (uint64_t)1 << e;
+        }
+
+        // Cycle counters are reset when starting from no engines running
+        if (! run_mask)
+        {
+            m->active_ns = 0;
+            m->active_start_ns = now;
+        }
+
+        for (uint32_t e = 0; e < m->num_engines; e += 1)
+        {
+            if (value & ((uint64_t)1 << e)) startEngine(m, e, now);
+        }
+
+        pthread_cond_signal(&m->work_cv);
+    }
+    else if (idx == CSR_WR_CTRL_ENG_DISABLE_MASK)
+    {
+        for (uint32_t e = 0; e < m->num_engines; e += 1)
+        {
+            if (value & ((uint64_t)1 << e))
+            {
+                m->eng[e].run = false;
+                if (! m->eng[e].in_flight) setEngineActive(m, e, false, now);
+            }
+        }
+    }
+    else if (idx == CSR_WR_CTRL_SNAPSHOT)
+    {
+        for (uint32_t e = 0; e < m->num_engines; e += 1)
+        {
+            for (uint32_t i = 0; i < 16; i += 1)
+            {
+                m->snap_csr[e][i] = engineCsr(m, e, i, now);
+            }
+        }
+        m->snap_active_ns = modelActiveNs(m, now);
+        m->snap_count += 1;
+    }
+
+    pthread_mutex_unlock(&m->lock);
+}
+
+
+t_host_chan_model*
+hostChanModelCreate(uint32_t num_engines)
+{
+    if ((num_engines == 0) || (num_engines > 64)) return NULL;
+
+    t_host_chan_model *m = calloc(1, sizeof(t_host_chan_model) +
+                                     num_engines * sizeof(t_model_engine));
+    if (m == NULL) return NULL;
+
+    m->snap_csr = calloc(num_engines, sizeof(m->snap_csr[0]));
+    if (m->snap_csr == NULL)
+    {
+        free(m);
+        return NULL;
+    }
+
+    m->csrs.read = modelRead;
+    m->csrs.write = modelWrite;
+    m->csrs.ctx = m;
+    m->num_engines = num_engines;
+
+    uuid_t afu_id;
+    if (0 == uuid_parse(AFU_ACCEL_UUID, afu_id))
+    {
+        for (int i = 0; i < 8; i += 1)
+        {
+            m->afu_id_h = (m->afu_id_h << 8) | afu_id[i];
+            m->afu_id_l = (m->afu_id_l << 8) | afu_id[8 + i];
+        }
+    }
+
+    for (uint32_t e = 0; e < num_engines; e += 1)
+    {
+        m->eng[e].wr_data_mask = ~(uint64_t)0;
+    }
+
+    pthread_mutex_init(&m->lock, NULL);
+    pthread_cond_init(&m->work_cv, NULL);
+    int r = pthread_create(&m->dma_tid, NULL, dmaThread, m);
+    assert(0 == r);
+
+    return m;
+}
+
+
+void
+hostChanModelDestroy(t_host_chan_model *model)
+{
+    if (model == NULL) return;
+
+    pthread_mutex_lock(&model->lock);
+    model->shutdown = true;
+    pthread_cond_signal(&model->work_cv);
+    pthread_mutex_unlock(&model->lock);
+    pthread_join(model->dma_tid, NULL);
+
+    pthread_cond_destroy(&model->work_cv);
+    pthread_mutex_destroy(&model->lock);
+    free(model->snap_csr);
+    free(model);
+}
+
+
+const t_csr_model*
+hostChanModelCsrs(t_host_chan_model *model)
+{
+    return &model->csrs;
+}
@@ -0,0 +1,32 @@
+// Copyright (C) 2022 Intel Corporation
+// SPDX-License-Identifier: MIT
+
+//
+// Software model of the host_chan_params AFU. The model implements the CSR
+// manager and the engine CSR map of host_mem_rdwr_engine_axi.sv. A DMA
+// thread moves data between the engines and host memory, so the full host
+// side of the test (buffer management, cache flushing, checking and
+// reporting) runs without an FPGA.
+//
+// Model engines use virtual addresses. Buffer "DMA" addresses are just
+// pointers in the test's address space.
+//
+
+#ifndef __HOST_CHAN_MODEL_H__
+#define __HOST_CHAN_MODEL_H__
+
+#include "csr_mgr.h"
+
+typedef struct t_host_chan_model t_host_chan_model;
+
+// Create a model with num_engines engines (up to 64) and start its DMA
+// thread.
+t_host_chan_model *hostChanModelCreate(uint32_t num_engines);
+
+// Stop the DMA thread and free the model.
+void hostChanModelDestroy(t_host_chan_model *model);
+
+// CSR interface, for passing to csrAllocModelHandle().
+const t_csr_model *hostChanModelCsrs(t_host_chan_model *model);
+
+#endif // __HOST_CHAN_MODEL_H__
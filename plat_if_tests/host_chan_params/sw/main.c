@@ -16,10 +16,21 @@
 #include "afu_json_info.h"
 #include "tests_common.h"
 #include "test_host_chan_params.h"
+#include "host_chan_model.h"
 
 static t_target_bdf target;
 static bool latency_mode;
-static uint32_t latency_engine_mask;
+static uint64_t latency_engine_mask;
+static bool footprint_mode;
+static uint64_t footprint_max = (uint64_t)1 << 30;
+static bool numa_mode;
+static const char *workload_path;
+static bool hash_bench_mode;
+static uint32_t bench_max_threads;
+static bool cache_bench_mode;
+static bool write_chk_bench_mode;
+static bool model_mode;
+static uint32_t model_num_engines = 2;
 
 const uint32_t max_allowed_accels = 16;
 static uint32_t max_accels = 1;
@@ -33,7 +44,16 @@ help(void)
     printf("\n"
            "Usage:\n"
            "    host_chan_params [-h] [-B <bus>] [-D <device>] [-F <function>] [-S <socket-id>]\n"
-           "                     [--latency=<engine mask>]\n"
+           "                     [--latency=<engine mask>] [--hash-bench=<max threads>]\n"
+           "                     [--cache-bench=<max threads>]\n"
+           "                     [--write-check-bench=<max threads>]\n"
+           "                     [--run-time=<ms>] [--sample-interval=<usec>]\n"
+           "                     [--rel-err=<fraction>] [--max-runs=<n>]\n"
+           "                     [--knee-search=<tolerance>] [--footprint=<bytes>]\n"
+           "                     [--numa-sweep] [--cache-state=<state>]\n"
+           "                     [--roles=<file>] [--workload=<file>]\n"
+           "                     [--model=<engines>]\n"
+           "                     [--results=<file>]\n"
            "\n"
            "        -h,--help           Print this help\n"
            "        -B,--bus            Set target bus number\n"
@@ -46,9 +66,73 @@ help(void)
            "                            With no arguments, run on all available engines.\n"
            "                            An optional numeric bitmask selects engines.\n"
            "                            E.g., 6 skips engine 0 and runs engines 2 and 3.\n"
+           "                            Engines of all accelerators are numbered in\n"
+           "                            order. The mask covers only the first 64.\n"
            "        --max-accels        Maximum number of accelerators to open. An\n"
            "                            accelerator is a unique AFU. This parameter is\n"
-           "                            relevant only in --latency mode.\n"
+           "                            relevant only in --latency and --workload modes.\n"
+           "        --roles             Run --latency once with per-engine read, write,\n"
+           "                            rw or idle roles from <file>, which may also\n"
+           "                            group accelerators into links. With multiple\n"
+           "                            accelerators, bandwidth is also reported per\n"
+           "                            link (PCIe segment and bus by default).\n"
+           "        --workload          Run the phases of a workload <file> back-to-back.\n"
+           "                            Each phase sets per-engine direction, burst size,\n"
+           "                            maximum outstanding lines, buffer NUMA placement\n"
+           "                            and footprint, and optionally its duration. See\n"
+           "                            workload.h for the format.\n"
+           "\n"
+           "        --run-time          Milliseconds engines run in each bandwidth test.\n"
+           "                            The default is 100 (10 seconds in ASE).\n"
+           "        --sample-interval   Print a time series of per-engine read and write\n"
+           "                            bandwidth, sampled every <usec> microseconds while\n"
+           "                            bandwidth tests run. Samples are on \"# Sample\" lines.\n"
+           "        --rel-err           Repeat each bandwidth test until the 95%% confidence\n"
+           "                            interval of the mean is within this fraction of\n"
+           "                            the mean (e.g. 0.01). Each run defaults to 10 ms\n"
+           "                            (1 second in ASE) unless --run-time is set.\n"
+           "        --max-runs          Limit on repetitions with --rel-err. Default 30.\n"
+           "        --knee-search       In --latency mode, find the bandwidth and latency\n"
+           "                            knees with a coarse sweep and bisection instead\n"
+           "                            of measuring every offered load. Intervals are\n"
+           "                            split while the curve deviates from linear by\n"
+           "                            more than the optional tolerance, a fraction of\n"
+           "                            the curve's maximum (default 0.02), and by more\n"
+           "                            than the 95%% CI of runs with --rel-err.\n"
+           "        --footprint         Sweep the engine buffer footprint from 4KB up to\n"
+           "                            <bytes> (K, M and G suffixes are allowed; default\n"
+           "                            1G) with 4KB, 2MB and 1GB pages, measuring\n"
+           "                            bandwidth and latency of all engines together.\n"
+           "        --numa-sweep        Place read and write buffers on each NUMA node\n"
+           "                            and interleaved across nodes, measuring bandwidth\n"
+           "                            and latency of all engines together and the\n"
+           "                            penalty relative to the FPGA's local node.\n"
+           "        --cache-state       Host cache state of read buffers before each\n"
+           "                            --latency run: local (prefetched by the test\n"
+           "                            thread, the default), flushed, llc (prefetched\n"
+           "                            and demoted to the LLC, requires cldemote) or\n"
+           "                            remote-dirty (modified by a thread on another\n"
+           "                            core, preferably on another socket).\n"
+           "\n"
+           RESULT_OPT_HELP
+           "\n"
+           "        --model             Run against an in-process software model of the\n"
+           "                            AFU instead of an FPGA. The optional argument\n"
+           "                            sets the number of engines (default 2). With\n"
+           "                            --max-accels, one model per accelerator.\n"
+           "\n"
+           "        --hash-bench        Check the fast hash32 paths against the RTL\n"
+           "                            reference, then measure host-side expected read\n"
+           "                            hash throughput with increasing thread counts and\n"
+           "                            exit. No FPGA is used. The optional argument\n"
+           "                            limits threads.\n"
+           "        --cache-bench       Measure host cache flush, write-back, demote and\n"
+           "                            prefetch throughput and exit. No FPGA is used.\n"
+           "                            The optional argument limits threads.\n"
+           "        --write-check-bench Measure host-side write buffer check throughput,\n"
+           "                            comparing the SIMD and multi-threaded check with\n"
+           "                            a line by line loop, and exit. No FPGA is used.\n"
+           "                            The optional argument limits threads.\n"
            "\n");
 }
 
@@ -69,6 +153,21 @@ parse_args(int argc, char *argv[])
         {"segment",    required_argument, NULL, 0xe},
         {"latency",    optional_argument, NULL, 0xf},
         {"max-accels", required_argument, NULL, 0x10},
+        {"hash-bench", optional_argument, NULL, 0x11},
+        {"run-time",   required_argument, NULL, 0x12},
+        {"sample-interval", required_argument, NULL, 0x13},
+        {"rel-err",    required_argument, NULL, 0x14},
+        {"max-runs",   required_argument, NULL, 0x15},
+        {"model",      optional_argument, NULL, 0x16},
+        {"knee-search", optional_argument, NULL, 0x17},
+        RESULT_LONGOPT,
+        {"footprint",  optional_argument, NULL, 0x19},
+        {"numa-sweep", no_argument,       NULL, 0x1a},
+        {"cache-bench", optional_argument, NULL, 0x1b},
+        {"cache-state", required_argument, NULL, 0x1c},
+        {"write-check-bench", optional_argument, NULL, 0x1d},
+        {"roles",      required_argument, NULL, 0x1e},
+        {"workload",   required_argument, NULL, 0x1f},
         {0, 0, 0, 0}
     };
 
@@ -114,7 +213,7 @@ parse_args(int argc, char *argv[])
             {
                 endptr = NULL;
                 latency_engine_mask =
-                    (uint32_t)strtoul(tmp_optarg, &endptr, 0);
+                    (uint64_t)strtoull(tmp_optarg, &endptr, 0);
                 if (endptr != tmp_optarg + strlen(tmp_optarg)) {
                     fprintf(stderr, "invalid latency engine mask: %s\n",
                             tmp_optarg);
@@ -141,6 +240,104 @@ parse_args(int argc, char *argv[])
             }
             break;
 
+        case 0x11: /* hash-bench */
+            hash_bench_mode = true;
+
+            if (NULL == tmp_optarg)
+                break;
+            endptr = NULL;
+            bench_max_threads =
+                (uint32_t)strtoul(tmp_optarg, &endptr, 0);
+            if (endptr != tmp_optarg + strlen(tmp_optarg)) {
+                fprintf(stderr, "invalid number of threads: %s\n",
+                    tmp_optarg);
+                return -1;
+            }
+            break;
+
+        case 0x12: /* run-time */
+            if (NULL == tmp_optarg)
+                break;
+            endptr = NULL;
+            host_chan_params_opts.run_time_ms =
+                (uint32_t)strtoul(tmp_optarg, &endptr, 0);
+            if (endptr != tmp_optarg + strlen(tmp_optarg)) {
+                fprintf(stderr, "invalid run time: %s\n",
+                    tmp_optarg);
+                return -1;
+            }
+            break;
+
+        case 0x13: /* sample-interval */
+            if (NULL == tmp_optarg)
+                break;
+            endptr = NULL;
+            host_chan_params_opts.sample_interval_us =
+                (uint32_t)strtoul(tmp_optarg, &endptr, 0);
+            if (endptr != tmp_optarg + strlen(tmp_optarg)) {
+                fprintf(stderr, "invalid sample interval: %s\n",
+                    tmp_optarg);
+                return -1;
+            }
+            break;
+
+        case 0x14: /* rel-err */
+            if (NULL == tmp_optarg)
+                break;
+            endptr = NULL;
+            host_chan_params_opts.rel_err = strtod(tmp_optarg, &endptr);
+            if ((endptr != tmp_optarg + strlen(tmp_optarg)) ||
+                (host_chan_params_opts.rel_err < 0)) {
+                fprintf(stderr, "invalid relative error: %s\n",
+                    tmp_optarg);
+                return -1;
+            }
+            break;
+
+        case 0x15: /* max-runs */
+            if (NULL == tmp_optarg)
+                break;
+            endptr = NULL;
+            host_chan_params_opts.max_runs =
+                (uint32_t)strtoul(tmp_optarg, &endptr, 0);
+            if (endptr != tmp_optarg + strlen(tmp_optarg)) {
+                fprintf(stderr, "invalid max runs: %s\n",
+                    tmp_optarg);
+                return -1;
+            }
+            break;
+
+        case 0x16: /* model */
+            model_mode = true;
+
+            if (NULL == tmp_optarg)
+                break;
+            endptr = NULL;
+            model_num_engines =
+                (uint32_t)strtoul(tmp_optarg, &endptr, 0);
+            if ((endptr != tmp_optarg + strlen(tmp_optarg)) ||
+                (model_num_engines == 0) || (model_num_engines > 64)) {
+                fprintf(stderr, "invalid number of model engines: %s\n",
+                    tmp_optarg);
+                return -1;
+            }
+            break;
+
+        case 0x17: /* knee-search */
+            host_chan_params_opts.knee_tol = 0.02;
+
+            if (NULL == tmp_optarg)
+                break;
+            endptr = NULL;
+            host_chan_params_opts.knee_tol = strtod(tmp_optarg, &endptr);
+            if ((endptr != tmp_optarg + strlen(tmp_optarg)) ||
+                (host_chan_params_opts.knee_tol <= 0)) {
+                fprintf(stderr, "invalid knee search tolerance: %s\n",
+                    tmp_optarg);
+                return -1;
+            }
+            break;
+
         case 'B': /* bus */
             if (NULL == tmp_optarg)
                 break;
@@ -193,6 +390,103 @@ parse_args(int argc, char *argv[])
             }
             break;
 
+        case RESULT_OPT: /* results */
+            resultParseOpt(tmp_optarg);
+            break;
+
+        case 0x19: /* footprint */
+            footprint_mode = true;
+
+            if (NULL == tmp_optarg)
+                break;
+            endptr = NULL;
+            footprint_max = strtoull(tmp_optarg, &endptr, 0);
+            if (endptr && *endptr)
+            {
+                switch (*endptr)
+                {
+                  case 'K': case 'k': footprint_max <<= 10; endptr += 1; break;
+                  case 'M': case 'm': footprint_max <<= 20; endptr += 1; break;
+                  case 'G': case 'g': footprint_max <<= 30; endptr += 1; break;
+                }
+            }
+            if ((endptr != tmp_optarg + strlen(tmp_optarg)) ||
+                (footprint_max < 4096)) {
+                fprintf(stderr, "invalid footprint: %s\n",
+                    tmp_optarg);
+                return -1;
+            }
+            break;
+
+        case 0x1a: /* numa-sweep */
+            numa_mode = true;
+            break;
+
+        case 0x1b: /* cache-bench */
+            cache_bench_mode = true;
+
+            if (NULL == tmp_optarg)
+                break;
+            endptr = NULL;
+            bench_max_threads =
+                (uint32_t)strtoul(tmp_optarg, &endptr, 0);
+            if (endptr != tmp_optarg + strlen(tmp_optarg)) {
+                fprintf(stderr, "invalid number of threads: %s\n",
+                    tmp_optarg);
+                return -1;
+            }
+            break;
+
+        case 0x1c: /* cache-state */
+            {
+                t_rd_cache_state state;
+                for (state = RD_CACHE_LOCAL; state <= RD_CACHE_REMOTE_DIRTY;
+                     state++) {
+                    if (0 == strcmp(tmp_optarg, rdCacheStateName(state)))
+                        break;
+                }
+                if (state > RD_CACHE_REMOTE_DIRTY) {
+                    fprintf(stderr, "invalid cache state: %s\n",
+                        tmp_optarg);
+                    return -1;
+                }
+                // Without cldemote, llc would silently be local
+                if ((state == RD_CACHE_LLC) &&
+                    ! cacheGetFeatures()->cldemote) {
+                    fprintf(stderr, "cache state llc requires cldemote, "
+                        "which this processor lacks\n");
+                    return -1;
+                }
+                host_chan_params_opts.rd_cache_state = state;
+            }
+            break;
+
+        case 0x1d: /* write-check-bench */
+            write_chk_bench_mode = true;
+
+            if (NULL == tmp_optarg)
+                break;
+            endptr = NULL;
+            bench_max_threads =
+                (uint32_t)strtoul(tmp_optarg, &endptr, 0);
+            if (endptr != tmp_optarg + strlen(tmp_optarg)) {
+                fprintf(stderr, "invalid number of threads: %s\n",
+                    tmp_optarg);
+                return -1;
+            }
+            break;
+
+        case 0x1e: /* roles */
+            // Roles pick the engines, so the numeric mask is unused
+            latency_mode = true;
+            latency_engine_mask = ~(uint64_t)0;
+            host_chan_params_opts.roles_path = tmp_optarg;
+            break;
+
+        case 0x1f: /* workload */
+            workload_path = tmp_optarg;
+            break;
+
         case ':': /* missing option argument */
             fprintf(stderr, "Missing option argument\n");
             return -1;
@@ -224,21 +518,61 @@ int main(int argc, char *argv[])
     if (parse_args(argc, argv) < 0)
         return 1;
 
-    // Find and connect to the accelerator(s)
-    num_accels = max_accels;
-    r = connectToMatchingAccels(AFU_ACCEL_UUID, &target,
-                                &num_accels, accel_handles);
-    assert(FPGA_OK == r);
-    if (0 == num_accels) return 0;
-    bool is_ase = probeForASE(&target);
-    if (is_ase)
+    if (resultOpenOpt("host_chan_params"))
+        return 1;
+
+    if (hash_bench_mode)
     {
-        printf("# Running in ASE mode\n");
+        return testHostChanHashBench(bench_max_threads);
+    }
+
+    if (cache_bench_mode)
+    {
+        return testHostChanCacheBench(bench_max_threads);
+    }
+
+    if (write_chk_bench_mode)
+    {
+        return testHostChanWriteChkBench(bench_max_threads);
+    }
+
+    bool is_ase = false;
+    t_host_chan_model *models[max_allowed_accels];
+    memset(models, 0, sizeof(models));
+    if (model_mode)
+    {
+        // Software models stand in for the accelerators
+        printf("# Running with the software model\n");
+        num_accels = max_accels;
+        for (uint32_t a = 0; a < num_accels; a += 1)
+        {
+            models[a] = hostChanModelCreate(model_num_engines);
+            assert(NULL != models[a]);
+            accel_handles[a] = NULL;
+        }
+    }
+    else
+    {
+        // Find and connect to the accelerator(s)
+        num_accels = max_accels;
+        r = connectToMatchingAccels(AFU_ACCEL_UUID, &target,
+                                    &num_accels, accel_handles);
+        assert(FPGA_OK == r);
+        if (0 == num_accels) return 0;
+        is_ase = probeForASE(&target);
+        if (is_ase)
+        {
+            printf("# Running in ASE mode\n");
+        }
     }
 
     for (uint32_t a = 0; a < num_accels; a += 1)
     {
-        csr_handles[a] = csrAllocHandle(accel_handles[a], 0);
+        if (models[a])
+            csr_handles[a] = csrAllocModelHandle(hostChanModelCsrs(models[a]));
+        else
+            csr_handles[a] = csrAllocHandleMode(accel_handles[a], 0,
+                                                is_ase ? CSR_MMIO_API : CSR_MMIO_DIRECT);
         assert(csr_handles[a] != NULL);
 
         printf("# AFU ID:  %016" PRIx64 " %016" PRIx64 " (%d)\n",
@@ -249,7 +583,21 @@ int main(int argc, char *argv[])
 
     // Run tests
     int status;
-    if (! latency_mode)
+    if (footprint_mode)
+    {
+        status = testHostChanFootprint(argc, argv, accel_handles[0], csr_handles[0], is_ase,
+                                       footprint_max);
+    }
+    else if (numa_mode)
+    {
+        status = testHostChanNuma(argc, argv, accel_handles[0], csr_handles[0], is_ase);
+    }
+    else if (workload_path)
+    {
+        status = testHostChanWorkload(argc, argv, num_accels, accel_handles, csr_handles, is_ase,
+                                      workload_path);
+    }
+    else if (! latency_mode)
     {
         status = testHostChanParams(argc, argv, accel_handles[0], csr_handles[0], is_ase);
     }
@@ -263,8 +611,11 @@ int main(int argc, char *argv[])
     for (uint32_t a = 0; a < num_accels; a += 1)
     {
         csrReleaseHandle(csr_handles[a]);
-        fpgaClose(accel_handles[a]);
+        if (accel_handles[a]) fpgaClose(accel_handles[a]);
+        hostChanModelDestroy(models[a]);
     }
 
+    resultClose();
+
     return status;
 }
@@ -21,8 +21,10 @@
 #include <uuid/uuid.h>
 #include <time.h>
 #include <immintrin.h>
-#include <cpuid.h>
 #include <numa.h>
+#include <math.h>
+#include <pthread.h>
+#include <sys/syscall.h>
 
 #include <opae/fpga.h>
 
@@ -33,25 +35,18 @@
 // State from the AFU's JSON file, extracted using OPAE's afu_json_mgr script
 #include "afu_json_info.h"
 #include "test_host_chan_params.h"
+#include "buffer_pool.h"
+#include "eng_roles.h"
+#include "workload.h"
 
 #define CACHELINE_BYTES 64
 #define CL(x) ((x) * CACHELINE_BYTES)
+#define KB(x) ((x) * 1024)
 #define MB(x) ((x) * 1048576)
 
-#define PROTECTION (PROT_READ | PROT_WRITE)
-
-#ifndef MAP_HUGETLB
-#define MAP_HUGETLB 0x40000
-#endif
-#ifndef MAP_HUGE_SHIFT
-#define MAP_HUGE_SHIFT 26
-#endif
-
-#define MAP_1G_HUGEPAGE (0x1e << MAP_HUGE_SHIFT) /* 2 ^ 0x1e = 1G */
-
-#define FLAGS_4K (MAP_PRIVATE | MAP_ANONYMOUS)
-#define FLAGS_2M (FLAGS_4K | MAP_HUGETLB)
-#define FLAGS_1G (FLAGS_2M | MAP_1G_HUGEPAGE)
+// Limit on engines across all accelerators
+#define MAX_ENGINES 256
+#define MAX_ACCELS 16
 
 
 // Engine's address mode
@@ -80,19 +75,29 @@ typedef struct
     fpga_handle accel_handle;
     t_csr_handle_p csr_handle;
     uint32_t accel_eng_idx;
+    // The CSR manager supports csrSnapshot()
+    bool hw_snapshot;
+    // The engine implements the FIM read latency histogram
+    bool lat_hist;
 
     volatile uint64_t *rd_buf;
     uint64_t rd_buf_ioaddr;
     uint64_t rd_buf_ioaddr_enc;     // IOADDR divided by data bus width
-    uint64_t rd_wsid;
 
     volatile uint64_t *wr_buf;
     uint64_t wr_buf_ioaddr;
     uint64_t wr_buf_ioaddr_enc;     // IOADDR divided by data bus width
-    uint64_t wr_wsid;
+    // Second 2MB write buffer, used by pipelined small region tests
+    volatile uint64_t *wr_buf_alt;
+    uint64_t wr_buf_alt_ioaddr_enc;
+    size_t buf_bytes;               // Size of each of rd_buf and wr_buf
+    size_t buf_page_size;
 
     struct bitmask* numa_rd_mem_mask;
     struct bitmask* numa_wr_mem_mask;
+    // Interleave buffer pages across the mask instead of binding to it
+    bool numa_rd_interleave;
+    bool numa_wr_interleave;
     uint32_t data_bus_bytes;
     uint32_t max_burst_size;
     uint32_t group;
@@ -106,165 +111,234 @@ typedef struct
 }
 t_engine_buf;
 
+t_host_chan_params_opts host_chan_params_opts;
+
+//
+// Bandwidth of one configuration, averaged over one or more runs
+//
+typedef struct
+{
+    uint32_t num_runs;
+    double read_gbs;
+    double write_gbs;
+    double eng_read_gbs[MAX_ENGINES];
+    double eng_write_gbs[MAX_ENGINES];
+
+    // Standard deviation of read+write bandwidth across runs and the half
+    // width of the 95% confidence interval of its mean
+    double stddev;
+    double ci95;
+}
+t_bw_stats;
+
 static bool s_is_ase;
+// Connected to the software model instead of an FPGA
+static bool s_is_model;
 static t_engine_buf* s_eng_bufs;
 static uint32_t s_num_engines;
 static double s_afu_mhz;
 
-static char *engine_type[] = 
+//
+// Accelerators under test. Engines are numbered globally in accelerator
+// order. Accelerators on the same PCIe link (or in the same link group of
+// a --roles file) are reported together.
+//
+typedef struct
 {
-    "CCI-P",
-    "Avalon-MM",
-    "AXI-MM",
-    NULL
-};
+    fpga_handle accel_handle;
+    t_csr_handle_p csr_handle;
+    uint32_t first_engine;
+    uint32_t num_engines;
+    uint32_t link;
+}
+t_accel_info;
+
+static t_accel_info s_accels[MAX_ACCELS];
+static uint32_t s_num_accels;
+// Accelerator names and link names, as matched in roles and workload files
+static t_eng_roles_accel s_accel_desc[MAX_ACCELS];
+static char s_link_names[MAX_ACCELS][ENG_ROLES_MAX_NAME];
+static uint32_t s_num_links;
+
+// Engine roles from a --roles file, indexed by global engine
+static t_eng_role s_eng_roles[MAX_ENGINES];
 
 
 //
-// Taken from https://github.com/pmem/pmdk/blob/master/src/libpmem2/x86_64/flush.h.
-// The clflushopt instruction was added for Skylake and isn't in <immintrin.h>
-// _mm_clflushopt() in many of the compilers currently in use.
+// Set of engines, indexed by global engine number. Masks are passed by
+// value.
 //
-static inline void
-asm_clflushopt(const void *addr)
+typedef struct
 {
-    asm volatile(".byte 0x66; clflush %0" : "+m" \
-        (*(volatile char *)(addr)));
+    uint64_t w[MAX_ENGINES / 64];
 }
+t_engine_mask;
 
-//
-// Flush a range of lines from the cache hierarchy in the entire coherence
-// domain. (All cores all sockets)
-//
-static void
-flushRange(void* start, size_t len)
+static inline t_engine_mask
+engMaskNone(void)
+{
+    t_engine_mask m;
+    memset(&m, 0, sizeof(m));
+    return m;
+}
+
+static inline bool
+engMaskTest(t_engine_mask m, uint32_t e)
 {
-    uint8_t* cl = start;
-    uint8_t* end = start + len;
+    return (e < MAX_ENGINES) && ((m.w[e / 64] >> (e % 64)) & 1);
+}
 
-    // Does the CPU support clflushopt?
-    static bool checked_clflushopt = false;
-    static bool supports_clflushopt = false;
+static inline void
+engMaskSet(t_engine_mask *m, uint32_t e)
+{
+    assert(e < MAX_ENGINES);
+    m->w[e / 64] |= (uint64_t)1 << (e % 64);
+}
 
-    if (! checked_clflushopt)
-    {
-        checked_clflushopt = true;
-        supports_clflushopt = false;
+static inline t_engine_mask
+engMaskOne(uint32_t e)
+{
+    t_engine_mask m = engMaskNone();
+    engMaskSet(&m, e);
+    return m;
+}
 
-        unsigned int eax, ebx, ecx, edx;
-        if (__get_cpuid_max(0, 0) >= 7)
-        {
-            __cpuid_count(7, 0, eax, ebx, ecx, edx);
-            // bit_CLFLUSHOPT is (1 << 23)
-            supports_clflushopt = (((1 << 23) & ebx) != 0);
-            printf("#  Processor supports clflushopt: %d\n", supports_clflushopt);
-        }
+// Engines 0 through n-1
+static inline t_engine_mask
+engMaskFirstN(uint32_t n)
+{
+    t_engine_mask m = engMaskNone();
+    for (uint32_t e = 0; e < n; e += 1)
+    {
+        engMaskSet(&m, e);
     }
-    if (! supports_clflushopt) return;
+    return m;
+}
+
+// Engines 0 through 63 from a numeric mask
+static inline t_engine_mask
+engMaskFromU64(uint64_t v)
+{
+    t_engine_mask m = engMaskNone();
+    m.w[0] = v;
+    return m;
+}
 
-    while (cl < end)
+static inline bool
+engMaskIsEmpty(t_engine_mask m)
+{
+    for (uint32_t i = 0; i < MAX_ENGINES / 64; i += 1)
     {
-        asm_clflushopt(cl);
-        cl += CACHELINE_BYTES;
+        if (m.w[i]) return false;
     }
-
-    _mm_sfence();
+    return true;
 }
 
+//
+// Mask in the local engine numbering of accelerator a, as written to its
+// enable and disable CSRs.
+//
+static uint64_t
+engMaskAccel(t_engine_mask m, uint32_t a)
+{
+    uint64_t local = 0;
+    for (uint32_t e = 0; e < s_accels[a].num_engines; e += 1)
+    {
+        if (engMaskTest(m, s_accels[a].first_engine + e))
+            local |= (uint64_t)1 << e;
+    }
+    return local;
+}
 
 //
-// Prefetch a range into the local cache.
+// Hex string of a mask, without leading zeros.
 //
-static void
-prefetchRange(void* start, size_t len)
+static const char *
+engMaskStr(t_engine_mask m, char *buf, size_t len)
 {
-    uint8_t* cl = start;
-    uint8_t* end = start + len;
-    static volatile uint64_t sum = 0;
+    int i = MAX_ENGINES / 64 - 1;
+    while ((i > 0) && (0 == m.w[i])) i -= 1;
 
-    while (cl < end)
+    int n = snprintf(buf, len, "0x%" PRIx64, m.w[i]);
+    while ((--i >= 0) && (n > 0) && ((size_t)n < len))
     {
-        sum += *cl;
-        cl += CACHELINE_BYTES;
+        n += snprintf(buf + n, len - n, "%016" PRIx64, m.w[i]);
     }
+    return buf;
 }
 
+static char *engine_type[] = 
+{
+    "CCI-P",
+    "Avalon-MM",
+    "AXI-MM",
+    NULL
+};
+
 
 //
-// Allocate a buffer in I/O memory, shared with the FPGA.
+// Allocate a buffer in I/O memory, shared with the FPGA. Buffers come from
+// a pool of pinned huge pages and are released together by bufPoolRelease().
 //
 static void*
 allocSharedBuffer(
     fpga_handle accel_handle,
     size_t size,
+    size_t align,
     t_fpga_addr_mode addr_mode,
     struct bitmask *numa_mem_mask,
-    uint64_t *wsid,
-    uint64_t *ioaddr)
+    bool numa_interleave,
+    t_buf_pool_region *region)
 {
-    fpga_result r;
     void* buf;
 
-    int flags;
-    if (size >= MB(1024))
-        flags = FLAGS_1G;
-    else if (size >= 2 * MB(1))
-        flags = FLAGS_2M;
+    // The model needs no pinning and uses virtual addresses. Model buffers
+    // are pooled under a NULL handle. Limit NUMA to what the port requests
+    // (except in simulation).
+    if (numa_interleave && !s_is_ase)
+        buf = bufPoolAllocInterleaved(s_is_model ? NULL : accel_handle,
+                                      numa_mem_mask, size, align, region);
     else
-        flags = FLAGS_4K;
-
-    // Preserve current NUMA configuration
-    struct bitmask *numa_mems_preserve;
-    numa_mems_preserve = numa_get_membind();
-
-    // Limit NUMA to what the port requests (except in simulation)
-    if (!s_is_ase) numa_set_membind(numa_mem_mask);
-
-    // Allocate a buffer
-    buf = mmap(NULL, size, (PROT_READ | PROT_WRITE), flags, -1, 0);
-    assert(NULL != buf);
-
-    // Pin the buffer
-    r = fpgaPrepareBuffer(accel_handle, size, (void*)&buf, wsid, FPGA_BUF_PREALLOCATED);
-    if (FPGA_OK != r) return NULL;
-
-    // Restore NUMA configuration
-    numa_set_membind(numa_mems_preserve);
-    numa_bitmask_free(numa_mems_preserve);
-
-    // Get the physical address of the buffer in the accelerator
-    r = fpgaGetIOAddress(accel_handle, *wsid, ioaddr);
-    assert(FPGA_OK == r);
+        buf = bufPoolAlloc(s_is_model ? NULL : accel_handle,
+                           s_is_ase ? NULL : numa_mem_mask,
+                           size, align, region);
+    if (NULL == buf) return NULL;
 
     // Physical addresses? (ASE doesn't support this)
-    if ((addr_mode == ADDR_MODE_HOST_PHYSICAL) && !s_is_ase)
+    if ((addr_mode == ADDR_MODE_HOST_PHYSICAL) && !s_is_ase && !s_is_model)
     {
+        // Only the page holding the buffer is known to be physically
+        // contiguous. The whole buffer must fit in it.
+        size_t offset = (uint8_t*)buf - (uint8_t*)region->page_va;
+        if (region->page_size < offset + size)
+        {
+            fprintf(stderr,
+                    "Physically addressed %ld byte buffer crosses a %s page. Reserve larger\n"
+                    "huge pages or use a smaller buffer.\n",
+                    size, bufPoolPageSizeStr(region->page_size));
+            exit(1);
+        }
+
 #ifdef FPGA_NEAR_MEM_MAP
         // Call libfpga_near_mem_map from BBB repository for address info.
         // FPGA_NEAR_MEM_MAP has been tested already in initEngine().
+        // Buffers share pages, so translate the page and add the offset.
+        fpga_result r;
         fpga_near_mem_map_buf_info buf_info;
-        r = fpgaNearMemGetPageAddrInfo((void*)buf, &buf_info);
+        r = fpgaNearMemGetPageAddrInfo(region->page_va, &buf_info);
         if (FPGA_OK != r)
         {
             fprintf(stderr,
                     "Physical translation from VA %p failed. Is the fpga_near_mem_map driver from\n"
-                    "the OPAE intel-fpga-bbb repository installed properly?\n", buf);
+                    "the OPAE intel-fpga-bbb repository installed properly?\n", region->page_va);
             exit(1);
         }
 
-        *ioaddr = buf_info.phys_addr - buf_info.phys_space_base;
+        region->ioaddr = buf_info.phys_addr - buf_info.phys_space_base +
+                         ((uint8_t*)buf - (uint8_t*)region->page_va);
 #endif
     }
 
-    // The test engines treat a zero buffer IOVA as a hint to disable the engine.
-    // If IOVA is zero, just leave it allocated as a placeholder and get another
-    // buffer.
-    if (0 == *ioaddr)
-    {
-        buf = allocSharedBuffer(accel_handle, size, addr_mode, numa_mem_mask,
-                                wsid, ioaddr);
-    }
-
     return buf;
 }
 
@@ -285,31 +359,76 @@ initReadBuf(
 }
 
 
+//
+// Engine request and response counters, reported on failure
+//
+typedef struct
+{
+    uint64_t rd_burst_reqs;
+    uint64_t rd_burst_rsps;
+    uint64_t rd_line_rsps;
+    uint64_t wr_burst_reqs;
+    uint64_t wr_burst_rsps;
+}
+t_engine_counters;
+
+static void
+readEngineCounters(
+    uint32_t glob_e,
+    t_engine_counters *cnt
+)
+{
+    t_csr_handle_p csr_handle = s_eng_bufs[glob_e].csr_handle;
+    uint32_t e = s_eng_bufs[glob_e].accel_eng_idx;
+
+    cnt->rd_burst_reqs = csrEngRead(csr_handle, e, 1);
+    cnt->rd_burst_rsps = 0;
+    if (s_eng_bufs[glob_e].eng_type == 2)
+    {
+        cnt->rd_burst_rsps = csrEngRead(csr_handle, e, 6);
+    }
+    cnt->rd_line_rsps = csrEngRead(csr_handle, e, 2);
+    cnt->wr_burst_reqs = csrEngRead(csr_handle, e, 3);
+    cnt->wr_burst_rsps = csrEngRead(csr_handle, e, 4);
+}
+
+
+//
+// Print the state of the engines in emask and exit. The counters are read
+// from the engines unless saved, indexed by engine, is non-NULL. Pipelined
+// tests pass the counters saved when the failing run completed, since the
+// engines have run again since.
+//
 static void
 engineErrorAndExit(
     uint32_t num_engines,
-    uint64_t emask
+    t_engine_mask emask,
+    const t_engine_counters *saved
 )
 {
-    printf("\nEngine mask 0x%lx failure:\n", emask);
+    char mask_str[80];
+    printf("\nEngine mask %s failure:\n", engMaskStr(emask, mask_str, sizeof(mask_str)));
     for (uint32_t glob_e = 0; glob_e < num_engines; glob_e += 1)
     {
-        t_csr_handle_p csr_handle = s_eng_bufs[glob_e].csr_handle;
-
-        if (emask & ((uint64_t)1 << glob_e))
+        if (engMaskTest(emask, glob_e))
         {
             printf("  Engine %d state:\n", glob_e);
 
-            uint32_t e = s_eng_bufs[glob_e].accel_eng_idx;
-            printf("    Read burst requests: %ld\n", csrEngRead(csr_handle, e, 1));
-            if (s_eng_bufs[e].eng_type == 2)
+            t_engine_counters cnt;
+            if (saved)
+                cnt = saved[glob_e];
+            else
+                readEngineCounters(glob_e, &cnt);
+
+            printf("    Read burst requests: %ld\n", cnt.rd_burst_reqs);
+            if (s_eng_bufs[glob_e].eng_type == 2)
             {
-                printf("    Read burst responses: %ld\n", csrEngRead(csr_handle, e, 6));
+                printf("    Read burst responses: %ld\n", cnt.rd_burst_rsps);
             }
-            printf("    Read lines responses: %ld\n", csrEngRead(csr_handle, e, 2));
+            printf("    Read lines responses: %ld\n", cnt.rd_line_rsps);
 
-            printf("    Write burst requests: %ld\n", csrEngRead(csr_handle, e, 3));
-            printf("    Write burst responses: %ld\n", csrEngRead(csr_handle, e, 4));
+            printf("    Write burst requests: %ld\n", cnt.wr_burst_reqs);
+            printf("    Write burst responses: %ld\n", cnt.wr_burst_rsps);
         }
     }
 
@@ -317,6 +436,102 @@ engineErrorAndExit(
 }
 
 
+//
+// Allocate engine e's read and write buffers and set the engine's address
+// mask. Buffers are buf_bytes, aligned to align. The engine wraps at
+// mask_bytes, which must be a power of 2 and leave room in the buffer for
+// the largest burst. Returns non-zero if allocation fails.
+//
+static int
+allocEngineBuffers(
+    uint32_t e,
+    size_t buf_bytes,
+    size_t align,
+    size_t mask_bytes,
+    bool verbose)
+{
+    t_buf_pool_region region;
+
+    s_eng_bufs[e].rd_buf = allocSharedBuffer(s_eng_bufs[e].accel_handle, buf_bytes, align,
+                                             s_eng_bufs[e].addr_mode,
+                                             s_eng_bufs[e].numa_rd_mem_mask,
+                                             s_eng_bufs[e].numa_rd_interleave,
+                                             &region);
+    if (NULL == s_eng_bufs[e].rd_buf) return 1;
+    s_eng_bufs[e].rd_buf_ioaddr = region.ioaddr;
+    s_eng_bufs[e].rd_buf_ioaddr_enc = s_eng_bufs[e].rd_buf_ioaddr / s_eng_bufs[e].data_bus_bytes;
+    s_eng_bufs[e].buf_page_size = region.page_size;
+    if (verbose)
+    {
+        printf("#  Engine %d read buffer: VA %p, DMA address %p, %s pages%s\n", e,
+               s_eng_bufs[e].rd_buf, (void*)s_eng_bufs[e].rd_buf_ioaddr,
+               bufPoolPageSizeStr(region.page_size),
+               region.iova_contiguous ? "" : ", IOVA may not be contiguous");
+    }
+    initReadBuf(s_eng_bufs[e].rd_buf, buf_bytes);
+    // Flush to guarantee that the values reach RAM
+    cacheFlushRange((void*)s_eng_bufs[e].rd_buf, buf_bytes);
+    // Read back to the local cache. Some engine types may benefit from reading
+    // cached memory. This doesn't undo the cacheFlushRange() above, which was needed
+    // only to guarantee that RAM and cache are consistent.
+    cachePrefetchRange((void*)s_eng_bufs[e].rd_buf, buf_bytes);
+
+    s_eng_bufs[e].wr_buf = allocSharedBuffer(s_eng_bufs[e].accel_handle, buf_bytes, align,
+                                             s_eng_bufs[e].addr_mode,
+                                             s_eng_bufs[e].numa_wr_mem_mask,
+                                             s_eng_bufs[e].numa_wr_interleave,
+                                             &region);
+    if (NULL == s_eng_bufs[e].wr_buf) return 1;
+    s_eng_bufs[e].wr_buf_ioaddr = region.ioaddr;
+    s_eng_bufs[e].wr_buf_ioaddr_enc = s_eng_bufs[e].wr_buf_ioaddr / s_eng_bufs[e].data_bus_bytes;
+    // Report the smaller page size if the buffers differ
+    if (s_eng_bufs[e].buf_page_size > region.page_size)
+        s_eng_bufs[e].buf_page_size = region.page_size;
+    if (verbose)
+    {
+        printf("#  Engine %d write buffer: VA %p, DMA address %p, %s pages%s\n", e,
+               s_eng_bufs[e].wr_buf, (void*)s_eng_bufs[e].wr_buf_ioaddr,
+               bufPoolPageSizeStr(region.page_size),
+               region.iova_contiguous ? "" : ", IOVA may not be contiguous");
+    }
+
+    s_eng_bufs[e].buf_bytes = buf_bytes;
+
+    // Set the buffer size mask
+    csrEngWrite(s_eng_bufs[e].csr_handle, s_eng_bufs[e].accel_eng_idx, 4,
+                (mask_bytes / s_eng_bufs[e].data_bus_bytes) - 1);
+
+    return 0;
+}
+
+
+//
+// Does the engine implement the FIM read latency histogram? Engines without
+// it read 0 from register 7, which looks like an echo of bin 0, so the probe
+// selects the last bin.
+//
+static bool
+probeLatencyHistogram(
+    t_csr_handle_p csr_handle,
+    uint32_t accel_eng_idx)
+{
+    bool found = false;
+
+    csrEngWrite(csr_handle, accel_eng_idx, 7, 31);
+    for (uint32_t trips = 0; trips < 1000; trips += 1)
+    {
+        if (((csrEngRead(csr_handle, accel_eng_idx, 7) >> 48) & 0x1f) == 31)
+        {
+            found = true;
+            break;
+        }
+    }
+    csrEngWrite(csr_handle, accel_eng_idx, 7, 0);
+
+    return found;
+}
+
+
 static void
 initEngine(
     uint32_t e,
@@ -327,6 +542,16 @@ initEngine(
     s_eng_bufs[e].accel_handle = accel_handle;
     s_eng_bufs[e].csr_handle = csr_handle;
     s_eng_bufs[e].accel_eng_idx = accel_eng_idx;
+    s_eng_bufs[e].wr_buf_alt = NULL;
+
+    // Probe for snapshot support once per accelerator, while its engines
+    // are idle. Engines of an accelerator are initialized together.
+    if ((e > 0) && (s_eng_bufs[e - 1].csr_handle == csr_handle))
+        s_eng_bufs[e].hw_snapshot = s_eng_bufs[e - 1].hw_snapshot;
+    else
+        s_eng_bufs[e].hw_snapshot = (FPGA_OK == csrSnapshot(csr_handle));
+
+    s_eng_bufs[e].lat_hist = probeLatencyHistogram(csr_handle, accel_eng_idx);
 
     // Get the maximum burst size for the engine.
     uint64_t r = csrEngRead(csr_handle, accel_eng_idx, 0);
@@ -351,6 +576,13 @@ initEngine(
     printf("#  Engine %d addressing mode: %s\n", e, addr_mode_str[s_eng_bufs[e].addr_mode]);
     printf("#  Engine %d group: %d\n", e, s_eng_bufs[e].group);
 
+    if (e == 0)
+    {
+        const t_cache_features *cf = cacheGetFeatures();
+        printf("#  Processor supports clflushopt: %d, clwb: %d, cldemote: %d\n",
+               cf->clflushopt, cf->clwb, cf->cldemote);
+    }
+
     // 64 bit mask of valid NUMA nodes, according to the FPGA configuration
     struct bitmask* numa_rd_mask;
     struct bitmask* numa_wr_mask;
@@ -380,144 +612,494 @@ initEngine(
     }
     s_eng_bufs[e].numa_rd_mem_mask = numa_rd_mask;
     s_eng_bufs[e].numa_wr_mem_mask = numa_wr_mask;
-
-    // Separate 2MB read and write buffers
-    s_eng_bufs[e].rd_buf = allocSharedBuffer(accel_handle, MB(2),
-                                             s_eng_bufs[e].addr_mode,
-                                             s_eng_bufs[e].numa_rd_mem_mask,
-                                             &s_eng_bufs[e].rd_wsid,
-                                             &s_eng_bufs[e].rd_buf_ioaddr);
-    assert(NULL != s_eng_bufs[e].rd_buf);
-    s_eng_bufs[e].rd_buf_ioaddr_enc = s_eng_bufs[e].rd_buf_ioaddr / s_eng_bufs[e].data_bus_bytes;
-    printf("#  Engine %d read buffer: VA %p, DMA address %p\n", e,
-           s_eng_bufs[e].rd_buf, (void*)s_eng_bufs[e].rd_buf_ioaddr);
-    initReadBuf(s_eng_bufs[e].rd_buf, MB(2));
-    // Flush to guarantee that the values reach RAM
-    flushRange((void*)s_eng_bufs[e].rd_buf, MB(2));
-    // Read back to the local cache. Some engine types may benefit from reading
-    // cached memory. This doesn't undo the flushRange() above, which was needed
-    // only to guarantee that RAM and cache are consistent.
-    prefetchRange((void*)s_eng_bufs[e].rd_buf, MB(2));
-
-    s_eng_bufs[e].wr_buf = allocSharedBuffer(accel_handle, MB(2),
-                                             s_eng_bufs[e].addr_mode,
-                                             s_eng_bufs[e].numa_wr_mem_mask,
-                                             &s_eng_bufs[e].wr_wsid,
-                                             &s_eng_bufs[e].wr_buf_ioaddr);
-    assert(NULL != s_eng_bufs[e].wr_buf);
-    s_eng_bufs[e].wr_buf_ioaddr_enc = s_eng_bufs[e].wr_buf_ioaddr / s_eng_bufs[e].data_bus_bytes;
-    printf("#  Engine %d write buffer: VA %p, DMA address %p\n", e,
-           s_eng_bufs[e].wr_buf, (void*)s_eng_bufs[e].wr_buf_ioaddr);
+    s_eng_bufs[e].numa_rd_interleave = false;
+    s_eng_bufs[e].numa_wr_interleave = false;
 
     // Will be determined later
     s_eng_bufs[e].fim_ifc_mhz = 0;
 
-    // Set the buffer size mask. The buffer is 2MB but the mask covers
-    // only 1MB. This allows bursts to flow a bit beyond the mask
-    // without concern for overflow.
-    csrEngWrite(csr_handle, accel_eng_idx, 4, (MB(1) / s_eng_bufs[e].data_bus_bytes) - 1);
+    // Separate 2MB read and write buffers. The mask covers only 1MB. This
+    // allows bursts to flow a bit beyond the mask without concern for
+    // overflow.
+    if (allocEngineBuffers(e, MB(2), MB(2), MB(1), true))
+    {
+        fprintf(stderr, "Failed to allocate engine %d buffers\n", e);
+        exit(1);
+    }
 }
 
 
-// The same hash is implemented in the read path in the hardware.
-static uint32_t
-computeExpectedReadHash(
-    uint16_t *buf,
+//
+// Expected read hashes of long regions are computed in chunks, spread
+// across the thread pool. The hash is linear, so chunks are hashed
+// independently from a zero state and combined in order. Regions shorter
+// than a chunk are hashed inline.
+//
+#define READ_CHK_CHUNK_LINES 16384
+
+typedef struct
+{
+    const uint16_t *buf;
+    uint32_t line_bytes;
+    uint64_t num_lines;
+    uint32_t *chunk_hash;
+    uint32_t *chunk_sum;
+}
+t_read_chk_job;
+
+
+//
+// Update the hash and sum with a contiguous group of lines. The hash of the
+// low and high 16 bits of each line is the same hash that is implemented in
+// the read path in the hardware. The sum is used when hardware reads may
+// arrive out of order.
+//
+static void
+hashReadLines(
+    const uint16_t *buf,
     uint32_t line_bytes,
-    uint32_t num_bursts,
-    uint32_t burst_size)
+    uint64_t num_lines,
+    uint32_t *hash,
+    uint32_t *sum)
 {
-    uint32_t hash = HASH32_DEFAULT_INIT;
+    uint32_t line_vals[32];
+    uint32_t h = *hash;
+    uint32_t s = *sum;
 
-    while (num_bursts--)
+    while (num_lines)
     {
-        uint32_t num_lines = burst_size;
-        while (num_lines--)
+        // Values are collected and hashed in groups
+        uint32_t n_vals = (num_lines < 32) ? num_lines : 32;
+        for (uint32_t i = 0; i < n_vals; i += 1)
         {
-            // Hash the low and high 16 bits of each line
-            hash = hash32(hash, ((buf[line_bytes/2 - 1]) << 16) | buf[0]);
+            line_vals[i] = ((uint32_t)(buf[line_bytes/2 - 1]) << 16) | buf[0];
+            s += line_vals[i];
             buf += line_bytes/2;
         }
+
+        h = hash32Stream(h, line_vals, n_vals);
+        num_lines -= n_vals;
     }
 
-    return hash;
+    *hash = h;
+    *sum = s;
 }
 
 
-// Checksum is used when hardware reads may arrive out of order.
-static uint32_t
-computeExpectedReadSum(
-    uint16_t *buf,
+static void
+hashReadChunk(void *arg, uint32_t chunk)
+{
+    t_read_chk_job *job = (t_read_chk_job*)arg;
+    uint64_t first_line = (uint64_t)chunk * READ_CHK_CHUNK_LINES;
+    uint64_t num_lines = job->num_lines - first_line;
+    if (num_lines > READ_CHK_CHUNK_LINES) num_lines = READ_CHK_CHUNK_LINES;
+
+    job->chunk_hash[chunk] = 0;
+    job->chunk_sum[chunk] = 0;
+    hashReadLines(job->buf + first_line * (job->line_bytes / 2),
+                  job->line_bytes, num_lines,
+                  &job->chunk_hash[chunk], &job->chunk_sum[chunk]);
+}
+
+
+//
+// Compute the expected hash and sum of num_lines lines read from buf.
+//
+static void
+computeExpectedRead(
+    const uint16_t *buf,
     uint32_t line_bytes,
-    uint32_t num_bursts,
-    uint32_t burst_size)
+    uint64_t num_lines,
+    uint32_t *expected_hash,
+    uint32_t *expected_sum)
 {
+    uint32_t hash = HASH32_DEFAULT_INIT;
     uint32_t sum = 0;
 
-    while (num_bursts--)
+    if ((num_lines <= READ_CHK_CHUNK_LINES) || (threadPoolNumThreads() == 1))
     {
-        uint32_t num_lines = burst_size;
-        while (num_lines--)
+        hashReadLines(buf, line_bytes, num_lines, &hash, &sum);
+    }
+    else
+    {
+        uint32_t num_chunks = (num_lines + READ_CHK_CHUNK_LINES - 1) /
+                              READ_CHK_CHUNK_LINES;
+
+        t_read_chk_job job;
+        job.buf = buf;
+        job.line_bytes = line_bytes;
+        job.num_lines = num_lines;
+        job.chunk_hash = malloc(2 * num_chunks * sizeof(uint32_t));
+        assert(NULL != job.chunk_hash);
+        job.chunk_sum = job.chunk_hash + num_chunks;
+
+        threadPoolRun(num_chunks, hashReadChunk, &job);
+
+        for (uint32_t c = 0; c < num_chunks; c += 1)
         {
-            // Hash the low and high 16 bits of each line
-            sum += ((buf[line_bytes/2 - 1] << 16) | buf[0]);
-            buf += line_bytes/2;
+            uint64_t chunk_lines = num_lines - (uint64_t)c * READ_CHK_CHUNK_LINES;
+            if (chunk_lines > READ_CHK_CHUNK_LINES) chunk_lines = READ_CHK_CHUNK_LINES;
+
+            hash = hash32Combine(hash, job.chunk_hash[c], chunk_lines);
+            sum += job.chunk_sum[c];
         }
+
+        free(job.chunk_hash);
     }
 
-    return sum;
+    *expected_hash = hash;
+    *expected_sum = sum;
 }
 
 
-// Check a write buffer to confirm that the FPGA engine wrote the
-// expected values.
-static bool
-testExpectedWrites(
-    uint64_t *buf,
-    uint64_t buf_ioaddr,
+//
+// Written lines are checked in chunks of this many lines, which are spread
+// across the thread pool. Groups of lines within a chunk are compared with
+// SIMD kernels.
+//
+#define WRITE_CHK_CHUNK_LINES 16384
+#define WRITE_CHK_NO_ERROR (~(uint64_t)0)
+
+//
+// Find the first of num_lines lines in buf that doesn't hold the expected
+// write pattern: the low word is the IOADDR, starting with ioaddr and
+// incremented each line, and the high word is 0xdeadbeef. Returns the line
+// index or WRITE_CHK_NO_ERROR.
+//
+static uint64_t
+findWriteErrorScalar(
+    const uint64_t *buf,
+    uint64_t ioaddr,
     uint32_t line_bytes,
-    uint32_t num_bursts,
-    uint32_t burst_size,
-    uint32_t *line_index)
+    uint64_t num_lines)
 {
-    *line_index = 0;
+    const uint32_t line_words = line_bytes / 8;
 
-    while (num_bursts--)
+    for (uint64_t i = 0; i < num_lines; i += 1)
     {
-        uint32_t num_lines = burst_size;
-        while (num_lines--)
-        {
-            // The low word is the IOADDR
-            if (buf[0] != buf_ioaddr++) return false;
-            // The high word is 0xdeadbeef
-            if (buf[line_bytes/8 - 1] != 0xdeadbeef) return false;
+        // The low word is the IOADDR
+        if (buf[0] != ioaddr + i) return i;
+        // The high word is 0xdeadbeef
+        if (buf[line_words - 1] != 0xdeadbeef) return i;
 
-            *line_index += 1;
-            buf += line_bytes/8;
-        }
+        buf += line_words;
     }
 
-    // Confirm that the next line is 0. This is the first line not
-    // written by the FPGA.
-    if (buf[0] != 0) return false;
-    if (buf[line_bytes/8 - 1] != 0) return false;
-
-    return true;
+    return WRITE_CHK_NO_ERROR;
 }
 
+#ifdef __x86_64__
 
-static int
-testMaskedWrite(
-    uint32_t e
-)
+//
+// The SIMD kernels compare groups of 4 lines and pass groups with an error
+// and any remainder to the scalar kernel, which finds the exact line. Each
+// line is read with a vector load from its start and one ending at its end,
+// so lines must be at least one vector wide.
+//
+__attribute__((target("avx2")))
+static uint64_t
+findWriteErrorAvx2(
+    const uint64_t *buf,
+    uint64_t ioaddr,
+    uint32_t line_bytes,
+    uint64_t num_lines)
 {
-    int num_errors = 0;
-    uint64_t emask = (uint64_t)1 << e;
-    t_csr_handle_p csr_handle = s_eng_bufs[e].csr_handle;
-    uint32_t line_bytes = s_eng_bufs[e].data_bus_bytes;
+    const uint32_t line_words = line_bytes / 8;
+    // Lanes 0 and 3 are checked. The low word is in lane 0 of a load at the
+    // start of a line and the high word is in lane 3 of a load ending the line.
+    const __m256i chk_mask = _mm256_set_epi64x(-1, 0, 0, -1);
+    const __m256i one = _mm256_set_epi64x(0, 0, 0, 1);
+    uint64_t i = 0;
 
-    // No support for masked writes?
-    if (! s_eng_bufs[e].masked_writes)
+    __m256i expected = _mm256_set_epi64x(0xdeadbeef, 0, 0, ioaddr);
+
+    for (; i + 4 <= num_lines; i += 4)
+    {
+        const uint64_t *p = buf + i * line_words;
+        __m256i eq = chk_mask;
+
+        for (int l = 0; l < 4; l += 1)
+        {
+            __m256i lo = _mm256_loadu_si256((const __m256i*)p);
+            __m256i hi = _mm256_loadu_si256((const __m256i*)(p + line_words - 4));
+            __m256i v = _mm256_and_si256(_mm256_blend_epi32(lo, hi, 0xc0), chk_mask);
+            eq = _mm256_and_si256(eq, _mm256_cmpeq_epi64(v, expected));
+
+            expected = _mm256_add_epi64(expected, one);
+            p += line_words;
+        }
+
+        if (_mm256_movemask_pd(_mm256_castsi256_pd(eq)) != 0x9)
+        {
+            return i + findWriteErrorScalar(buf + i * line_words, ioaddr + i,
+                                            line_bytes, 4);
+        }
+    }
+
+    uint64_t r = findWriteErrorScalar(buf + i * line_words, ioaddr + i,
+                                      line_bytes, num_lines - i);
+    return (r == WRITE_CHK_NO_ERROR) ? r : i + r;
+}
+
+__attribute__((target("avx512f")))
+static uint64_t
+findWriteErrorAvx512(
+    const uint64_t *buf,
+    uint64_t ioaddr,
+    uint32_t line_bytes,
+    uint64_t num_lines)
+{
+    const uint32_t line_words = line_bytes / 8;
+    const __m512i one = _mm512_set_epi64(0, 0, 0, 0, 0, 0, 0, 1);
+    uint64_t i = 0;
+
+    // Low word in lane 0, high word in lane 7
+    __m512i expected = _mm512_set_epi64(0xdeadbeef, 0, 0, 0, 0, 0, 0, ioaddr);
+
+    for (; i + 4 <= num_lines; i += 4)
+    {
+        const uint64_t *p = buf + i * line_words;
+        __mmask8 ne = 0;
+
+        for (int l = 0; l < 4; l += 1)
+        {
+            __m512i lo = _mm512_loadu_si512((const void*)p);
+            __m512i hi = _mm512_loadu_si512((const void*)(p + line_words - 8));
+            __m512i v = _mm512_mask_blend_epi64(0x80, lo, hi);
+            ne |= _mm512_mask_cmpneq_epi64_mask(0x81, v, expected);
+
+            expected = _mm512_add_epi64(expected, one);
+            p += line_words;
+        }
+
+        if (ne)
+        {
+            return i + findWriteErrorScalar(buf + i * line_words, ioaddr + i,
+                                            line_bytes, 4);
+        }
+    }
+
+    uint64_t r = findWriteErrorScalar(buf + i * line_words, ioaddr + i,
+                                      line_bytes, num_lines - i);
+    return (r == WRITE_CHK_NO_ERROR) ? r : i + r;
+}
+
+#endif // __x86_64__
+
+//
+// Write check kernels supported by the CPU, widest first. A kernel is used
+// for lines of at least min_line_bytes.
+//
+typedef struct
+{
+    uint64_t (*fn)(const uint64_t *buf, uint64_t ioaddr,
+                   uint32_t line_bytes, uint64_t num_lines);
+    const char *name;
+    uint32_t min_line_bytes;
+}
+t_write_chk_kernel;
+
+#define MAX_WRITE_CHK_KERNELS 3
+static t_write_chk_kernel s_write_chk_kernels[MAX_WRITE_CHK_KERNELS];
+static uint32_t s_num_write_chk_kernels;
+
+// Set by the write check benchmark to run a specific kernel
+static const t_write_chk_kernel *s_write_chk_forced;
+
+__attribute__((constructor))
+static void
+findWriteErrorInit(void)
+{
+    uint32_t n = 0;
+
+#ifdef __x86_64__
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f"))
+    {
+        s_write_chk_kernels[n++] =
+            (t_write_chk_kernel){ findWriteErrorAvx512, "avx512", 64 };
+    }
+    if (__builtin_cpu_supports("avx2"))
+    {
+        s_write_chk_kernels[n++] =
+            (t_write_chk_kernel){ findWriteErrorAvx2, "avx2", 32 };
+    }
+#endif
+
+    s_write_chk_kernels[n++] =
+        (t_write_chk_kernel){ findWriteErrorScalar, "scalar", 8 };
+    s_num_write_chk_kernels = n;
+}
+
+//
+// The widest kernel for line_bytes, unless the benchmark forced one.
+//
+static const t_write_chk_kernel *
+writeChkKernel(uint32_t line_bytes)
+{
+    if (s_write_chk_forced) return s_write_chk_forced;
+
+    uint32_t k = 0;
+    while (s_write_chk_kernels[k].min_line_bytes > line_bytes) k += 1;
+    return &s_write_chk_kernels[k];
+}
+
+
+typedef struct
+{
+    const t_write_chk_kernel *kernel;
+    const uint64_t *buf;
+    uint64_t ioaddr;
+    uint32_t line_bytes;
+    uint64_t num_lines;
+    uint64_t *chunk_error;
+}
+t_write_chk_job;
+
+static void
+findWriteErrorChunk(void *arg, uint32_t chunk)
+{
+    t_write_chk_job *job = (t_write_chk_job*)arg;
+    uint64_t first_line = (uint64_t)chunk * WRITE_CHK_CHUNK_LINES;
+    uint64_t num_lines = job->num_lines - first_line;
+    if (num_lines > WRITE_CHK_CHUNK_LINES) num_lines = WRITE_CHK_CHUNK_LINES;
+
+    uint64_t r = job->kernel->fn(job->buf + first_line * (job->line_bytes / 8),
+                                 job->ioaddr + first_line,
+                                 job->line_bytes, num_lines);
+    job->chunk_error[chunk] = (r == WRITE_CHK_NO_ERROR) ? r : first_line + r;
+}
+
+
+//
+// Find the first line with an error, using the thread pool for large
+// regions.
+//
+static uint64_t
+findWriteError(
+    const uint64_t *buf,
+    uint64_t ioaddr,
+    uint32_t line_bytes,
+    uint64_t num_lines)
+{
+    const t_write_chk_kernel *kernel = writeChkKernel(line_bytes);
+    if ((num_lines <= WRITE_CHK_CHUNK_LINES) || (threadPoolNumThreads() == 1))
+    {
+        return kernel->fn(buf, ioaddr, line_bytes, num_lines);
+    }
+
+    uint32_t num_chunks = (num_lines + WRITE_CHK_CHUNK_LINES - 1) /
+                          WRITE_CHK_CHUNK_LINES;
+
+    t_write_chk_job job;
+    job.kernel = kernel;
+    job.buf = buf;
+    job.ioaddr = ioaddr;
+    job.line_bytes = line_bytes;
+    job.num_lines = num_lines;
+    job.chunk_error = malloc(num_chunks * sizeof(uint64_t));
+    assert(NULL != job.chunk_error);
+
+    threadPoolRun(num_chunks, findWriteErrorChunk, &job);
+
+    // The first chunk with an error holds the first error
+    uint64_t r = WRITE_CHK_NO_ERROR;
+    for (uint32_t c = 0; c < num_chunks; c += 1)
+    {
+        if (job.chunk_error[c] != WRITE_CHK_NO_ERROR)
+        {
+            r = job.chunk_error[c];
+            break;
+        }
+    }
+
+    free(job.chunk_error);
+    return r;
+}
+
+
+//
+// Original line by line check, kept as the reference for the write check
+// benchmark.
+//
+static bool
+testExpectedWritesScalar(
+    uint64_t *buf,
+    uint64_t buf_ioaddr,
+    uint32_t line_bytes,
+    uint32_t num_bursts,
+    uint32_t burst_size,
+    uint32_t *line_index)
+{
+    *line_index = 0;
+
+    while (num_bursts--)
+    {
+        uint32_t num_lines = burst_size;
+        while (num_lines--)
+        {
+            // The low word is the IOADDR
+            if (buf[0] != buf_ioaddr++) return false;
+            // The high word is 0xdeadbeef
+            if (buf[line_bytes/8 - 1] != 0xdeadbeef) return false;
+
+            *line_index += 1;
+            buf += line_bytes/8;
+        }
+    }
+
+    // Confirm that the next line is 0. This is the first line not
+    // written by the FPGA.
+    if (buf[0] != 0) return false;
+    if (buf[line_bytes/8 - 1] != 0) return false;
+
+    return true;
+}
+
+
+// Check a write buffer to confirm that the FPGA engine wrote the
+// expected values. On error, *line_index is the first bad line.
+static bool
+testExpectedWrites(
+    uint64_t *buf,
+    uint64_t buf_ioaddr,
+    uint32_t line_bytes,
+    uint32_t num_bursts,
+    uint32_t burst_size,
+    uint32_t *line_index)
+{
+    uint64_t num_lines = (uint64_t)num_bursts * burst_size;
+
+    uint64_t r = findWriteError(buf, buf_ioaddr, line_bytes, num_lines);
+    if (r != WRITE_CHK_NO_ERROR)
+    {
+        *line_index = r;
+        return false;
+    }
+
+    // Confirm that the next line is 0. This is the first line not
+    // written by the FPGA.
+    *line_index = num_lines;
+    buf += num_lines * (line_bytes / 8);
+    if (buf[0] != 0) return false;
+    if (buf[line_bytes/8 - 1] != 0) return false;
+
+    return true;
+}
+
+
+static int
+testMaskedWrite(
+    uint32_t e
+)
+{
+    int num_errors = 0;
+    uint64_t emask = (uint64_t)1 << e;
+    t_csr_handle_p csr_handle = s_eng_bufs[e].csr_handle;
+    uint32_t line_bytes = s_eng_bufs[e].data_bus_bytes;
+
+    // No support for masked writes?
+    if (! s_eng_bufs[e].masked_writes)
     {
         printf("  Engine %d does not support masked writes\n", e);
         return 0;
@@ -561,20 +1143,13 @@ testMaskedWrite(
 
     // Set the line to all ones to make it easier to observe the mask
     memset((void*)s_eng_bufs[e].wr_buf, ~0, line_bytes);
-    flushRange((void*)s_eng_bufs[e].wr_buf, line_bytes);
+    cacheFlushRange((void*)s_eng_bufs[e].wr_buf, line_bytes);
 
     // Start engine
     csrEnableEngines(csr_handle, emask);
 
-    // Wait for it to start
-    struct timespec wait_time;
-    wait_time.tv_sec = 0;
-    wait_time.tv_nsec = 1000000;
-    while ((csrGetEnginesEnabled(csr_handle) == 0) ||
-           csrGetEnginesActive(csr_handle))
-    {
-        nanosleep(&wait_time, NULL);
-    }
+    // Wait for it to complete
+    engWait(csr_handle, ENG_WAIT_DONE, 0);
 
     csrDisableEngines(csr_handle, emask);
 
@@ -606,197 +1181,328 @@ testMaskedWrite(
 }
 
 
-static int
-testSmallRegions(
+//
+// One configuration run by testSmallRegions(). Results are checked while
+// the engines run the next configuration, so the two runs in flight write
+// to alternate buffers.
+//
+typedef struct
+{
+    int mode;
+    uint64_t num_bursts;
+    uint64_t burst_size;
+    // Write buffer slot (0: wr_buf, 1: wr_buf_alt)
+    uint32_t wr_slot;
+    // Read hash (low) and sum (high) reported by each engine
+    uint64_t check_val[64];
+    // Engine counters at completion, reported if the check fails
+    t_engine_counters counters[64];
+}
+t_small_region_run;
+
+static volatile uint64_t *
+smallRegionWrBuf(uint32_t e, uint32_t slot)
+{
+    return slot ? s_eng_bufs[e].wr_buf_alt : s_eng_bufs[e].wr_buf;
+}
+
+static uint64_t
+smallRegionWrBufIOAddrEnc(uint32_t e, uint32_t slot)
+{
+    return slot ? s_eng_bufs[e].wr_buf_alt_ioaddr_enc : s_eng_bufs[e].wr_buf_ioaddr_enc;
+}
+
+
+//
+// Configure and start the engines in emask.
+//
+static void
+startSmallRegionRun(
     uint32_t num_engines,
-    uint64_t emask
+    uint64_t emask,
+    const t_small_region_run *run
 )
 {
-    int num_errors = 0;
-
-    // What is the maximum burst size for the engines? It is encoded in CSR 0.
-    uint64_t max_burst_size = 1024;
-    bool natural_bursts = false;
     for (uint32_t e = 0; e < num_engines; e += 1)
     {
+        t_csr_handle_p csr_handle = s_eng_bufs[e].csr_handle;
+
         if (emask & ((uint64_t)1 << e))
         {
-            if (max_burst_size > s_eng_bufs[e].max_burst_size)
-                max_burst_size = s_eng_bufs[e].max_burst_size;
+            // Read buffer base address (0 disables reads)
+            if (run->mode & 1)
+                csrEngWrite(csr_handle, e, 0, s_eng_bufs[e].rd_buf_ioaddr_enc);
+            else
+                csrEngWrite(csr_handle, e, 0, 0);
 
-            natural_bursts |= s_eng_bufs[e].natural_bursts;
+            // Write buffer base address (0 disables writes)
+            if (run->mode & 2)
+                csrEngWrite(csr_handle, e, 1, smallRegionWrBufIOAddrEnc(e, run->wr_slot));
+            else
+                csrEngWrite(csr_handle, e, 1, 0);
+
+            // Configure engine burst details
+            csrEngWrite(csr_handle, e, 2,
+                        (run->num_bursts << 32) | run->burst_size);
+            csrEngWrite(csr_handle, e, 3,
+                        (run->num_bursts << 32) | run->burst_size);
         }
     }
 
-    printf("Testing emask 0x%lx, maximum burst size %ld:\n", emask, max_burst_size);
+    // Start your engines
+    csrEnableEngines(s_eng_bufs[0].csr_handle, emask);
+}
 
-    uint64_t burst_size = 1;
-    while (burst_size <= max_burst_size)
+
+//
+// Wait for a run to complete, stop the engines and save the read checks
+// and counters.
+//
+static void
+finishSmallRegionRun(
+    uint32_t num_engines,
+    uint64_t emask,
+    t_small_region_run *run
+)
+{
+    // Wait for engine to complete
+    if (engWait(s_eng_bufs[0].csr_handle, ENG_WAIT_DONE,
+                (s_is_ase ? 20 : 5) * (uint64_t)1000000000L))
     {
-        uint64_t num_bursts = 1;
-        while (num_bursts < 100)
+        engineErrorAndExit(num_engines, engMaskFromU64(emask), NULL);
+    }
+
+    // Stop the engine
+    csrDisableEngines(s_eng_bufs[0].csr_handle, emask);
+
+    for (uint32_t e = 0; e < num_engines; e += 1)
+    {
+        if (! (emask & ((uint64_t)1 << e))) continue;
+
+        if (run->mode & 1)
         {
-            //
-            // Test only reads (mode 1), only writes (mode 2) and
-            // read+write (mode 3).
-            //
-            for (int mode = 1; mode <= 3; mode += 1)
-            {
-                for (uint32_t e = 0; e < num_engines; e += 1)
-                {
-                    t_csr_handle_p csr_handle = s_eng_bufs[e].csr_handle;
+            run->check_val[e] = csrEngRead(s_eng_bufs[e].csr_handle, e, 5);
+        }
 
-                    if (emask & ((uint64_t)1 << e))
-                    {
-                        // Read buffer base address (0 disables reads)
-                        if (mode & 1)
-                            csrEngWrite(csr_handle, e, 0, s_eng_bufs[e].rd_buf_ioaddr_enc);
-                        else
-                            csrEngWrite(csr_handle, e, 0, 0);
-
-                        // Write buffer base address (0 disables writes)
-                        if (mode & 2)
-                            csrEngWrite(csr_handle, e, 1, s_eng_bufs[e].wr_buf_ioaddr_enc);
-                        else
-                            csrEngWrite(csr_handle, e, 1, 0);
-
-                        // Clear the write buffer
-                        memset((void*)s_eng_bufs[e].wr_buf, 0, MB(2));
-                        flushRange((void*)s_eng_bufs[e].wr_buf, MB(2));
-
-                        // Configure engine burst details
-                        csrEngWrite(csr_handle, e, 2,
-                                    (num_bursts << 32) | burst_size);
-                        csrEngWrite(csr_handle, e, 3,
-                                    (num_bursts << 32) | burst_size);
-                    }
-                }
+        // The next run resets the counters before this run is checked
+        readEngineCounters(e, &run->counters[e]);
+    }
+}
 
-                char *mode_str = "R+W:  ";
-                if (mode == 1)
-                    mode_str = "Read: ";
-                if (mode == 2)
-                {
-                    mode_str = "Write:";
-                }
 
-                printf("  %s %2ld bursts of %2ld lines", mode_str,
-                       num_bursts, burst_size);
-
-                // Start your engines
-                csrEnableEngines(s_eng_bufs[0].csr_handle, emask);
-
-                // Wait for engine to complete. Checking csrGetEnginesEnabled()
-                // resolves a race between the request to start an engine
-                // and the engine active flag going high. Execution is done when
-                // the engine is enabled and the active flag goes low.
-                struct timespec wait_time;
-                wait_time.tv_sec = 0;
-                wait_time.tv_nsec = 1000000;
-                uint64_t wait_nsec = 0;
-                while ((csrGetEnginesEnabled(s_eng_bufs[0].csr_handle) == 0) ||
-                       csrGetEnginesActive(s_eng_bufs[0].csr_handle))
-                {
-                    nanosleep(&wait_time, NULL);
+//
+// Check a completed run and clear its write buffers for reuse. Returns the
+// number of errors. *fatal is set on read errors, after which testing
+// stops.
+//
+static int
+checkSmallRegionRun(
+    uint32_t num_engines,
+    uint64_t emask,
+    const t_small_region_run *run,
+    bool *fatal
+)
+{
+    int num_errors = 0;
+    *fatal = false;
 
-                    wait_nsec += wait_time.tv_nsec + wait_time.tv_sec * (uint64_t)1000000000L;
-                    if ((wait_nsec / (uint64_t)1000000000L) > (s_is_ase ? 20 : 5))
-                    {
-                        engineErrorAndExit(num_engines, emask);
-                    }
-                }
+    char *mode_str = "R+W:  ";
+    if (run->mode == 1)
+        mode_str = "Read: ";
+    if (run->mode == 2)
+    {
+        mode_str = "Write:";
+    }
 
-                // Stop the engine
-                csrDisableEngines(s_eng_bufs[0].csr_handle, emask);
+    printf("  %s %2ld bursts of %2ld lines", mode_str,
+           run->num_bursts, run->burst_size);
 
-                bool pass = true;
-                for (uint32_t e = 0; e < num_engines; e += 1)
-                {
-                    t_csr_handle_p csr_handle = s_eng_bufs[e].csr_handle;
+    for (uint32_t e = 0; e < num_engines; e += 1)
+    {
+        if (! (emask & ((uint64_t)1 << e))) continue;
 
-                    if (emask & ((uint64_t)1 << e))
-                    {
-                        // Compute the expected hash and sum
-                        uint32_t expected_hash = 0;
-                        uint32_t expected_sum = 0;
-                        if (mode & 1)
-                        {
-                            expected_hash = computeExpectedReadHash(
-                                (uint16_t*)s_eng_bufs[e].rd_buf,
-                                s_eng_bufs[e].data_bus_bytes,
-                                num_bursts, burst_size);
-
-                            expected_sum = computeExpectedReadSum(
-                                (uint16_t*)s_eng_bufs[e].rd_buf,
-                                s_eng_bufs[e].data_bus_bytes,
-                                num_bursts, burst_size);
-                        }
-
-                        // Get the actual hash
-                        uint32_t actual_hash = 0;
-                        uint32_t actual_sum = 0;
-                        if (mode & 1)
-                        {
-                            uint64_t check_val = csrEngRead(csr_handle, e, 5);
-                            actual_hash = (uint32_t)check_val;
-                            actual_sum = check_val >> 32;
-                        }
-
-                        // Test that writes arrived
-                        bool writes_ok = true;
-                        uint32_t write_error_line;
-                        if (mode & 2)
-                        {
-                            flushRange((void*)s_eng_bufs[e].wr_buf, MB(2));
-
-                            writes_ok = testExpectedWrites(
-                                (uint64_t*)s_eng_bufs[e].wr_buf,
-                                s_eng_bufs[e].wr_buf_ioaddr_enc,
-                                s_eng_bufs[e].data_bus_bytes,
-                                num_bursts, burst_size, &write_error_line);
-                        }
-
-                        if (expected_sum != actual_sum)
-                        {
-                            pass = false;
-                            num_errors += 1;
-                            printf("\n - FAIL %d: read ERROR expected sum 0x%08x found 0x%08x\n",
-                                   e, expected_sum, actual_sum);
-                            engineErrorAndExit(num_engines, emask);
-                        }
-                        else if ((expected_hash != actual_hash) &&
-                                 s_eng_bufs[e].ordered_read_responses)
-                        {
-                            pass = false;
-                            num_errors += 1;
-                            printf("\n - FAIL %d: read ERROR expected hash 0x%08x found 0x%08x\n",
-                                   e, expected_hash, actual_hash);
-                            engineErrorAndExit(num_engines, emask);
-                        }
-                        else if (! writes_ok)
-                        {
-                            pass = false;
-                            num_errors += 1;
-                            printf("\n - FAIL %d: write ERROR line index 0x%x\n", e, write_error_line);
-                        }
-                    }
-                }
+        volatile uint64_t *wr_buf = smallRegionWrBuf(e, run->wr_slot);
 
-                if (pass) printf(" - PASS\n");
-            }
+        // Compute the expected hash and sum
+        uint32_t expected_hash = 0;
+        uint32_t expected_sum = 0;
+        if (run->mode & 1)
+        {
+            computeExpectedRead(
+                (uint16_t*)s_eng_bufs[e].rd_buf,
+                s_eng_bufs[e].data_bus_bytes,
+                run->num_bursts * run->burst_size,
+                &expected_hash, &expected_sum);
+        }
 
-            num_bursts = (num_bursts * 2) + 1;
+        // Get the actual hash
+        uint32_t actual_hash = 0;
+        uint32_t actual_sum = 0;
+        if (run->mode & 1)
+        {
+            actual_hash = (uint32_t)run->check_val[e];
+            actual_sum = run->check_val[e] >> 32;
         }
 
-        if (natural_bursts)
+        // Test that writes arrived
+        bool writes_ok = true;
+        uint32_t write_error_line;
+        if (run->mode & 2)
         {
-            // Natural burst sizes -- test powers of 2
-            burst_size <<= 1;
+            cacheFlushRange((void*)wr_buf, MB(2));
+
+            writes_ok = testExpectedWrites(
+                (uint64_t*)wr_buf,
+                smallRegionWrBufIOAddrEnc(e, run->wr_slot),
+                s_eng_bufs[e].data_bus_bytes,
+                run->num_bursts, run->burst_size, &write_error_line);
+
+            // Clear the write buffer for the run after next
+            memset((void*)wr_buf, 0, MB(2));
+            cacheFlushRange((void*)wr_buf, MB(2));
         }
-        else
+
+        if (expected_sum != actual_sum)
         {
-            // Test every burst size up to 4 and then sparsely after that
-            if ((burst_size < 4) || (burst_size == max_burst_size))
+            num_errors += 1;
+            printf("\n - FAIL %d: read ERROR expected sum 0x%08x found 0x%08x\n",
+                   e, expected_sum, actual_sum);
+            *fatal = true;
+            return num_errors;
+        }
+        else if ((expected_hash != actual_hash) &&
+                 s_eng_bufs[e].ordered_read_responses)
+        {
+            num_errors += 1;
+            printf("\n - FAIL %d: read ERROR expected hash 0x%08x found 0x%08x\n",
+                   e, expected_hash, actual_hash);
+            *fatal = true;
+            return num_errors;
+        }
+        else if (! writes_ok)
+        {
+            num_errors += 1;
+            printf("\n - FAIL %d: write ERROR line index 0x%x\n", e, write_error_line);
+        }
+    }
+
+    if (num_errors == 0) printf(" - PASS\n");
+    return num_errors;
+}
+
+
+//
+// Test every combination of burst count, burst size and mode. Runs are
+// pipelined: the host checks the results of one run while the engines
+// execute the next.
+//
+static int
+testSmallRegions(
+    uint32_t num_engines,
+    uint64_t emask
+)
+{
+    int num_errors = 0;
+
+    // What is the maximum burst size for the engines? It is encoded in CSR 0.
+    uint64_t max_burst_size = 1024;
+    bool natural_bursts = false;
+    for (uint32_t e = 0; e < num_engines; e += 1)
+    {
+        if (emask & ((uint64_t)1 << e))
+        {
+            if (max_burst_size > s_eng_bufs[e].max_burst_size)
+                max_burst_size = s_eng_bufs[e].max_burst_size;
+
+            natural_bursts |= s_eng_bufs[e].natural_bursts;
+
+            // Second write buffer, written while the first is checked
+            if (NULL == s_eng_bufs[e].wr_buf_alt)
+            {
+                t_buf_pool_region region;
+                s_eng_bufs[e].wr_buf_alt =
+                    allocSharedBuffer(s_eng_bufs[e].accel_handle, MB(2), MB(2),
+                                      s_eng_bufs[e].addr_mode,
+                                      s_eng_bufs[e].numa_wr_mem_mask,
+                                      s_eng_bufs[e].numa_wr_interleave,
+                                      &region);
+                if (NULL == s_eng_bufs[e].wr_buf_alt)
+                {
+                    printf("FAIL: engine %d alternate write buffer allocation\n", e);
+                    return 1;
+                }
+                s_eng_bufs[e].wr_buf_alt_ioaddr_enc =
+                    region.ioaddr / s_eng_bufs[e].data_bus_bytes;
+            }
+
+            // Clear both write buffers
+            for (uint32_t slot = 0; slot < 2; slot += 1)
+            {
+                memset((void*)smallRegionWrBuf(e, slot), 0, MB(2));
+                cacheFlushRange((void*)smallRegionWrBuf(e, slot), MB(2));
+            }
+        }
+    }
+
+    printf("Testing emask 0x%lx, maximum burst size %ld:\n", emask, max_burst_size);
+
+    t_small_region_run runs[2];
+    t_small_region_run *prev_run = NULL;
+    uint32_t run_idx = 0;
+    bool fatal;
+
+    uint64_t burst_size = 1;
+    while (burst_size <= max_burst_size)
+    {
+        uint64_t num_bursts = 1;
+        while (num_bursts < 100)
+        {
+            //
+            // Test only reads (mode 1), only writes (mode 2) and
+            // read+write (mode 3).
+            //
+            for (int mode = 1; mode <= 3; mode += 1)
+            {
+                t_small_region_run *run = &runs[run_idx & 1];
+                run->mode = mode;
+                run->num_bursts = num_bursts;
+                run->burst_size = burst_size;
+                run->wr_slot = run_idx & 1;
+                run_idx += 1;
+
+                startSmallRegionRun(num_engines, emask, run);
+
+                // Check the previous run while this one executes
+                if (prev_run)
+                {
+                    num_errors += checkSmallRegionRun(num_engines, emask,
+                                                      prev_run, &fatal);
+                    if (fatal)
+                    {
+                        // Drain the run in flight and report the state
+                        // saved when the failing run completed
+                        finishSmallRegionRun(num_engines, emask, run);
+                        engineErrorAndExit(num_engines, engMaskFromU64(emask),
+                                           prev_run->counters);
+                    }
+                }
+
+                finishSmallRegionRun(num_engines, emask, run);
+                prev_run = run;
+            }
+
+            num_bursts = (num_bursts * 2) + 1;
+        }
+
+        if (natural_bursts)
+        {
+            // Natural burst sizes -- test powers of 2
+            burst_size <<= 1;
+        }
+        else
+        {
+            // Test every burst size up to 4 and then sparsely after that
+            if ((burst_size < 4) || (burst_size == max_burst_size))
                 burst_size += 1;
             else
             {
@@ -806,6 +1512,16 @@ testSmallRegions(
         }
     }
 
+    if (prev_run)
+    {
+        num_errors += checkSmallRegionRun(num_engines, emask, prev_run, &fatal);
+        if (fatal)
+        {
+            engineErrorAndExit(num_engines, engMaskFromU64(emask),
+                               prev_run->counters);
+        }
+    }
+
     return num_errors;
 }
 
@@ -845,6 +1561,131 @@ configBandwidth(
 }
 
 
+//
+// Line counters and pClk cycles of the engines in emask, sampled as close
+// together as possible.
+//
+typedef struct
+{
+    struct timespec time;
+    uint64_t pclk_cycles[MAX_ENGINES];
+    uint64_t lines[MAX_ENGINES][2];
+}
+t_bw_sample;
+
+static void
+takeBandwidthSample(
+    uint32_t num_engines,
+    t_engine_mask emask,
+    t_bw_sample *sample
+)
+{
+    t_csr_handle_p csr_handle = NULL;
+    bool use_snapshot = false;
+    uint64_t pclk_cycles = 0;
+
+    clock_gettime(CLOCK_MONOTONIC, &sample->time);
+
+    for (uint32_t glob_e = 0; glob_e < num_engines; glob_e += 1)
+    {
+        if (! engMaskTest(emask, glob_e)) continue;
+
+        uint32_t e = s_eng_bufs[glob_e].accel_eng_idx;
+
+        // Record all the counters of an accelerator at once when the AFU
+        // supports snapshots. Otherwise, read the live counters. A snapshot
+        // can still fail while the CSR manager is starting engines.
+        if (s_eng_bufs[glob_e].csr_handle != csr_handle)
+        {
+            csr_handle = s_eng_bufs[glob_e].csr_handle;
+            use_snapshot = s_eng_bufs[glob_e].hw_snapshot &&
+                           (FPGA_OK == csrSnapshot(csr_handle));
+            if (use_snapshot)
+                pclk_cycles = csrGetSnapshotPClkCycles(csr_handle);
+            else
+                pclk_cycles = csrRead(csr_handle, CSR_RD_CTRL_ENG_PCLK_CYCLES);
+        }
+
+        sample->pclk_cycles[glob_e] = pclk_cycles;
+        if (use_snapshot)
+        {
+            sample->lines[glob_e][0] = csrEngSnapRead(csr_handle, e, 2);
+            sample->lines[glob_e][1] = csrEngSnapRead(csr_handle, e, 3);
+        }
+        else
+        {
+            csrEngReadBlock(csr_handle, e, 2, 2, sample->lines[glob_e]);
+        }
+    }
+}
+
+
+//
+// Print engine bandwidth every sample interval while engines run. The time
+// series is printed on "# Sample" lines, keeping it out of the plotted data.
+// Rates come from the change in line counters and pClk cycles since the
+// previous sample.
+//
+static void
+sampleBandwidth(
+    uint32_t num_engines,
+    t_engine_mask emask,
+    uint64_t run_usec
+)
+{
+    static t_bw_sample samples[2];
+    uint32_t cur = 0;
+    double pclk_mhz = csrGetPClkMHz(s_eng_bufs[0].csr_handle);
+
+    printf("# Sample ms");
+    for (uint32_t glob_e = 0; glob_e < num_engines; glob_e += 1)
+    {
+        if (engMaskTest(emask, glob_e))
+        {
+            printf(", Eng%d Read GB/s, Eng%d Write GB/s", glob_e, glob_e);
+        }
+    }
+    printf("\n");
+
+    struct timespec interval;
+    interval.tv_sec = host_chan_params_opts.sample_interval_us / 1000000;
+    interval.tv_nsec = (host_chan_params_opts.sample_interval_us % 1000000) * 1000;
+
+    takeBandwidthSample(num_engines, emask, &samples[cur]);
+    struct timespec start = samples[cur].time;
+
+    while (true)
+    {
+        nanosleep(&interval, NULL);
+
+        t_bw_sample *prev = &samples[cur];
+        cur ^= 1;
+        t_bw_sample *s = &samples[cur];
+        takeBandwidthSample(num_engines, emask, s);
+
+        uint64_t elapsed_usec = (s->time.tv_sec - start.tv_sec) * 1000000 +
+                                (s->time.tv_nsec - start.tv_nsec) / 1000;
+
+        printf("# Sample %0.3f", elapsed_usec / 1000.0);
+        for (uint32_t glob_e = 0; glob_e < num_engines; glob_e += 1)
+        {
+            if (! engMaskTest(emask, glob_e)) continue;
+
+            uint64_t cycles = s->pclk_cycles[glob_e] - prev->pclk_cycles[glob_e];
+            for (int d = 0; d < 2; d += 1)
+            {
+                uint64_t bytes = (s->lines[glob_e][d] - prev->lines[glob_e][d]) *
+                                 s_eng_bufs[glob_e].data_bus_bytes;
+                printf(" %0.2f", cycles ? bytes * pclk_mhz / (1000.0 * cycles) : 0.0);
+            }
+        }
+        printf("\n");
+
+        if (elapsed_usec >= run_usec) break;
+    }
+}
+
+
 //
 // Run a bandwidth test (configured already with configBandwidth) on the set
 // of engines indicated by emask.
@@ -852,57 +1693,58 @@ configBandwidth(
 static int
 runBandwidth(
     uint32_t num_engines,
-    uint64_t emask
+    t_engine_mask emask
 )
 {
-    assert(emask != 0);
+    assert(! engMaskIsEmpty(emask));
 
-    // Start engines. In some modes, there may be multiple accelerator controllers
-    // connected. Enable them all.
-    t_csr_handle_p csr_handle = NULL;
-    for (uint32_t c = 0; c < num_engines; c += 1)
+    // Start engines. There may be multiple accelerators connected. Each is
+    // enabled with its own engines from the mask.
+    for (uint32_t a = 0; a < s_num_accels; a += 1)
     {
-        if (s_eng_bufs[c].csr_handle != csr_handle)
-        {
-            csr_handle = s_eng_bufs[c].csr_handle;
-            csrEnableEngines(csr_handle, emask);
-        }
+        uint64_t accel_mask = engMaskAccel(emask, a);
+        if (accel_mask) csrEnableEngines(s_accels[a].csr_handle, accel_mask);
     }
 
     // Wait for them to start.
-    struct timespec wait_time;
-    wait_time.tv_sec = 0;
-    wait_time.tv_nsec = 1000000;
-    while (csrGetEnginesEnabled(s_eng_bufs[num_engines-1].csr_handle) == 0)
+    for (uint32_t a = 0; a < s_num_accels; a += 1)
+    {
+        if (engMaskAccel(emask, a))
+            engWait(s_accels[a].csr_handle, ENG_WAIT_STARTED, 0);
+    }
+
+    // Let them run for a while. When repeating runs until the bandwidth
+    // converges, each run is shorter.
+    uint64_t run_usec = s_is_ase ? 10000000 : 100000;
+    if (host_chan_params_opts.run_time_ms)
+    {
+        run_usec = (uint64_t)1000 * host_chan_params_opts.run_time_ms;
+    }
+    else if (host_chan_params_opts.rel_err > 0)
     {
-        nanosleep(&wait_time, NULL);
+        run_usec = s_is_ase ? 1000000 : 10000;
     }
 
-    // Let them run for a while
-    usleep(s_is_ase ? 10000000 : 100000);
+    if (host_chan_params_opts.sample_interval_us)
+    {
+        sampleBandwidth(num_engines, emask, run_usec);
+    }
+    else
+    {
+        usleep(run_usec);
+    }
     
-    csr_handle = NULL;
-    for (uint32_t c = 0; c < num_engines; c += 1)
+    for (uint32_t a = 0; a < s_num_accels; a += 1)
     {
-        if (s_eng_bufs[c].csr_handle != csr_handle)
-        {
-            csr_handle = s_eng_bufs[c].csr_handle;
-            csrDisableEngines(csr_handle, emask);
-        }
+        uint64_t accel_mask = engMaskAccel(emask, a);
+        if (accel_mask) csrDisableEngines(s_accels[a].csr_handle, accel_mask);
     }
 
     // Wait for them to stop
-    csr_handle = NULL;
-    for (uint32_t c = 0; c < num_engines; c += 1)
+    for (uint32_t a = 0; a < s_num_accels; a += 1)
     {
-        if (s_eng_bufs[c].csr_handle != csr_handle)
-        {
-            csr_handle = s_eng_bufs[c].csr_handle;
-            while (csrGetEnginesActive(csr_handle))
-            {
-                nanosleep(&wait_time, NULL);
-            }
-        }
+        if (engMaskAccel(emask, a))
+            engWait(s_accels[a].csr_handle, ENG_WAIT_IDLE, 0);
     }
 
     if (s_afu_mhz == 0)
@@ -915,488 +1757,2890 @@ runBandwidth(
 
 
 //
-// Print bandwidth results after runBandwidth().
+// Bandwidth of each engine in emask during the last runBandwidth(). Each
+// accelerator counts the cycles of its own run.
 //
-static int
-printBandwidth(
+static void
+getRunBandwidth(
     uint32_t num_engines,
-    uint64_t emask
+    t_engine_mask emask,
+    double *eng_read_gbs,
+    double *eng_write_gbs
 )
 {
-    assert(emask != 0);
+    t_csr_handle_p cycles_handle = NULL;
+    uint64_t cycles = 0;
 
-    uint64_t cycles = csrGetClockCycles(s_eng_bufs[0].csr_handle);
-    uint64_t read_bytes = 0;
-    uint64_t write_bytes = 0;
     for (uint32_t glob_e = 0; glob_e < num_engines; glob_e += 1)
     {
         t_csr_handle_p csr_handle = s_eng_bufs[glob_e].csr_handle;
         uint32_t e = s_eng_bufs[glob_e].accel_eng_idx;
 
-        if (emask & ((uint64_t)1 << glob_e))
+        eng_read_gbs[glob_e] = 0;
+        eng_write_gbs[glob_e] = 0;
+        if (! engMaskTest(emask, glob_e)) continue;
+
+        if (csr_handle != cycles_handle)
         {
-            read_bytes += csrEngRead(csr_handle, e, 2) * s_eng_bufs[glob_e].data_bus_bytes;
-            write_bytes += csrEngRead(csr_handle, e, 3) * s_eng_bufs[glob_e].data_bus_bytes;
+            cycles_handle = csr_handle;
+            cycles = csrGetClockCycles(csr_handle);
+        }
+
+        if (cycles)
+        {
+            uint64_t lines[2];
+            fpga_result r = csrEngReadBlock(csr_handle, e, 2, 2, lines);
+            assert(FPGA_OK == r);
+
+            uint32_t bytes = s_eng_bufs[glob_e].data_bus_bytes;
+            eng_read_gbs[glob_e] = lines[0] * bytes * s_afu_mhz / (1000.0 * cycles);
+            eng_write_gbs[glob_e] = lines[1] * bytes * s_afu_mhz / (1000.0 * cycles);
         }
     }
+}
+
+
+//
+// Two-sided 95% quantile of Student's t distribution. Above 30 degrees of
+// freedom the value at the next lower table entry is used, which slightly
+// overstates the interval.
+//
+static double
+tQuantile95(uint32_t dof)
+{
+    static const double t_tbl[30] = {
+        12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228,
+        2.201, 2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101, 2.093, 2.086,
+        2.080, 2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048, 2.045, 2.042
+    };
+
+    assert(dof > 0);
+    if (dof <= 30) return t_tbl[dof - 1];
+    if (dof < 40) return 2.042;
+    if (dof < 60) return 2.021;
+    if (dof < 120) return 2.000;
+    return 1.980;
+}
+
 
-    if (!read_bytes && !write_bytes)
+const char *
+rdCacheStateName(t_rd_cache_state state)
+{
+    switch (state)
     {
-        printf("  FAIL: no memory traffic detected!\n");
-        return 1;
+      case RD_CACHE_FLUSHED: return "flushed";
+      case RD_CACHE_LLC: return "llc";
+      case RD_CACHE_REMOTE_DIRTY: return "remote-dirty";
+      default: return "local";
     }
+}
+
+
+//
+// Remote dirty helper CPU and the test thread CPU and node it was picked
+// for. s_remote_runs and s_remote_moves count runs and new picks since the
+// last printRemoteCpu().
+//
+static int s_remote_cpu = -1;
+static int s_remote_for_cpu = -1;
+static int s_remote_for_node = -1;
+static uint32_t s_remote_runs;
+static uint32_t s_remote_moves;
 
-    double read_bw = read_bytes * s_afu_mhz / (1000.0 * cycles);
-    double write_bw = write_bytes * s_afu_mhz / (1000.0 * cycles);
+//
+// Print the remote dirty helper's CPU as a comment, once per sweep. Does
+// nothing if no run used the helper since the last call.
+//
+static void
+printRemoteCpu(void)
+{
+    if (0 == s_remote_runs) return;
+
+    printf("# Remote dirty helper CPU %d (node %d), test thread CPU %d (node %d)",
+           s_remote_cpu, (s_remote_cpu < 0) ? -1 : numa_node_of_cpu(s_remote_cpu),
+           s_remote_for_cpu, s_remote_for_node);
+    if (s_remote_moves)
+        printf(", moved %d times with the test thread", s_remote_moves);
+    printf("\n");
+
+    s_remote_runs = 0;
+    s_remote_moves = 0;
+}
 
-    if (! write_bytes)
+//
+// Pick a CPU for the remote dirty helper thread: one the test may run on,
+// other than the test thread's CPU and preferably on another NUMA node.
+// Returns -1 if there is no other CPU.
+//
+static int
+pickRemoteCpu(
+    unsigned int cur_cpu,
+    unsigned int cur_node
+)
+{
+    struct bitmask *cpus = numa_allocate_cpumask();
+    numa_sched_getaffinity(0, cpus);
+
+    int pick = -1;
+    for (int cpu = 0; cpu < numa_num_configured_cpus(); cpu += 1)
     {
-        printf("  Read GB/s:  %0.2f\n", read_bw);
+        if (! numa_bitmask_isbitset(cpus, cpu) || (cpu == (int)cur_cpu)) continue;
+
+        if (numa_node_of_cpu(cpu) != (int)cur_node)
+        {
+            pick = cpu;
+            break;
+        }
+        if (pick < 0) pick = cpu;
     }
-    else if (! read_bytes)
+
+    numa_bitmask_free(cpus);
+    return pick;
+}
+
+
+typedef struct
+{
+    int cpu;
+    uint32_t num_engines;
+    t_engine_mask rd_mask;
+}
+t_dirty_helper;
+
+//
+// Helper thread: store to every line of the read buffers so they are
+// modified in the helper's cache. Values are unchanged.
+//
+static void*
+dirtyReadBuffers(void *arg)
+{
+    const t_dirty_helper *h = arg;
+
+    if (h->cpu >= 0)
     {
-        printf("  Write GB/s: %0.2f\n", write_bw);
+        struct bitmask *cpus = numa_allocate_cpumask();
+        numa_bitmask_setbit(cpus, h->cpu);
+        numa_sched_setaffinity(0, cpus);
+        numa_bitmask_free(cpus);
     }
-    else
+
+    for (uint32_t e = 0; e < h->num_engines; e += 1)
     {
-        printf("  R+W GB/s:   %0.2f (read %0.2f, write %0.2f)\n",
-               read_bw + write_bw, read_bw, write_bw);
+        if (engMaskTest(h->rd_mask, e))
+        {
+            volatile uint64_t *p = s_eng_bufs[e].rd_buf;
+            size_t n = s_eng_bufs[e].buf_bytes / sizeof(uint64_t);
+            for (size_t i = 0; i < n; i += CACHELINE_BYTES / sizeof(uint64_t))
+            {
+                p[i] = p[i];
+            }
+        }
     }
 
-    return 0;
+    return NULL;
 }
 
 
 //
-// Print bandwidth results after runBandwidth().
+// Put the read buffers in rd_mask in the cache state selected by
+// host_chan_params_opts.rd_cache_state.
 //
-static int
-printLatencyAndBandwidth(
+static void
+setReadCacheState(
     uint32_t num_engines,
-    uint64_t emask,
-    uint32_t max_active_reqs,
-    uint32_t n_sampled_rd_engines,
-    uint32_t n_sampled_wr_engines,
-    bool print_header
+    t_engine_mask rd_mask
 )
 {
-    assert(emask != 0);
-
-    uint64_t cycles = csrGetClockCycles(s_eng_bufs[0].csr_handle);
-    double afu_ns_per_cycle = 1000.0 / s_afu_mhz;
+    if (engMaskIsEmpty(rd_mask)) return;
 
-    uint64_t total_read_bytes = 0;
-    uint64_t total_write_bytes = 0;
-    double read_avg_lat = 0;
-    double fim_read_avg_lat = 0;
-    double write_avg_lat = 0;
-    uint64_t max_reads_in_flight = 0;
-    uint64_t fim_max_reads_in_flight = 0;
-
-    uint64_t eng_read_bytes[32];
-    uint64_t eng_write_bytes[32];
-    assert(num_engines < 32);
-
-    // How many engines are being sampled in this test?
-    uint32_t n_sampled_engines = 0;
-    for (uint32_t e = 0; e < num_engines; e += 1)
+    t_rd_cache_state state = host_chan_params_opts.rd_cache_state;
+    if (state == RD_CACHE_REMOTE_DIRTY)
     {
-        if (emask & ((uint64_t)1 << e))
+        // The test thread isn't pinned, since thread pool workers would
+        // inherit its affinity. Pick the helper's CPU again whenever the
+        // test thread has moved.
+        unsigned int cur_cpu = 0, cur_node = 0;
+        if (syscall(SYS_getcpu, &cur_cpu, &cur_node, NULL) == 0)
         {
-            n_sampled_engines += 1;
+            if ((int)cur_cpu != s_remote_for_cpu)
+            {
+                if (s_remote_for_cpu >= 0) s_remote_moves += 1;
+                s_remote_cpu = pickRemoteCpu(cur_cpu, cur_node);
+                s_remote_for_cpu = cur_cpu;
+                s_remote_for_node = cur_node;
+            }
         }
+        s_remote_runs += 1;
+
+        // Lines stay modified in the helper's cache after it exits
+        t_dirty_helper h = { s_remote_cpu, num_engines, rd_mask };
+        pthread_t tid;
+        int r = pthread_create(&tid, NULL, dirtyReadBuffers, &h);
+        assert(0 == r);
+        pthread_join(tid, NULL);
+        return;
     }
 
-    for (uint32_t glob_e = 0; glob_e < num_engines; glob_e += 1)
+    for (uint32_t e = 0; e < num_engines; e += 1)
     {
-        t_csr_handle_p csr_handle = s_eng_bufs[glob_e].csr_handle;
-        uint32_t e = s_eng_bufs[glob_e].accel_eng_idx;
-
-        if (emask & ((uint64_t)1 << glob_e))
+        if (engMaskTest(rd_mask, e))
         {
-            // Is the engine's FIM frequency known yet?
-            if (0 == s_eng_bufs[glob_e].fim_ifc_mhz)
+            void *buf = (void*)s_eng_bufs[e].rd_buf;
+            size_t len = s_eng_bufs[e].buf_bytes;
+
+            if (state == RD_CACHE_FLUSHED)
             {
-                uint64_t fim_clk_cycles = csrEngRead(csr_handle, e, 14);
-                uint64_t eng_clk_cycles = csrEngRead(csr_handle, e, 15);
-                s_eng_bufs[glob_e].fim_ifc_mhz = s_afu_mhz * fim_clk_cycles / eng_clk_cycles;
-                printf("# FIM %d interface MHz: %0.1f\n", glob_e, s_eng_bufs[glob_e].fim_ifc_mhz);
+                cacheFlushRange(buf, len);
             }
-            double fim_ns_per_cycle = 1000.0 / s_eng_bufs[glob_e].fim_ifc_mhz;
+            else
+            {
+                cachePrefetchRange(buf, len);
+                if (state == RD_CACHE_LLC) cacheDemoteRange(buf, len);
+            }
+        }
+    }
+}
+
+
+//
+// Run the engines in emask and record bandwidth. With --rel-err, runs are
+// repeated until the 95% confidence interval of the mean read+write
+// bandwidth is within the requested relative error of the mean, or until
+// the run limit is reached. Read buffers in rd_cache_mask are set to the
+// requested cache state before each run.
+//
+static void
+measureBandwidth(
+    uint32_t num_engines,
+    t_engine_mask emask,
+    t_engine_mask rd_cache_mask,    // Set the cache state of these read buffers
+    t_bw_stats *stats
+)
+{
+    double rel_err = host_chan_params_opts.rel_err;
+    uint32_t max_runs = host_chan_params_opts.max_runs;
+    if (max_runs == 0) max_runs = 30;
+
+    memset(stats, 0, sizeof(t_bw_stats));
+
+    // Running mean and sum of squared differences of read+write bandwidth
+    // (Welford)
+    double mean = 0;
+    double m2 = 0;
+    uint32_t n = 0;
+
+    while (true)
+    {
+        setReadCacheState(num_engines, rd_cache_mask);
+        runBandwidth(num_engines, emask);
+
+        double eng_read_gbs[MAX_ENGINES];
+        double eng_write_gbs[MAX_ENGINES];
+        getRunBandwidth(num_engines, emask, eng_read_gbs, eng_write_gbs);
+
+        double total = 0;
+        for (uint32_t e = 0; e < num_engines; e += 1)
+        {
+            stats->eng_read_gbs[e] += eng_read_gbs[e];
+            stats->eng_write_gbs[e] += eng_write_gbs[e];
+            total += eng_read_gbs[e] + eng_write_gbs[e];
+        }
+
+        n += 1;
+        double delta = total - mean;
+        mean += delta / n;
+        m2 += delta * (total - mean);
+
+        if (n > 1)
+        {
+            stats->stddev = sqrt(m2 / (n - 1));
+            stats->ci95 = tQuantile95(n - 1) * stats->stddev / sqrt(n);
+        }
+
+        if (rel_err <= 0) break;
+        if ((n >= 3) && (stats->ci95 <= rel_err * mean)) break;
+        if (n >= max_runs) break;
+    }
+
+    stats->num_runs = n;
+    for (uint32_t e = 0; e < num_engines; e += 1)
+    {
+        stats->eng_read_gbs[e] /= n;
+        stats->eng_write_gbs[e] /= n;
+        stats->read_gbs += stats->eng_read_gbs[e];
+        stats->write_gbs += stats->eng_write_gbs[e];
+    }
+}
+
+
+//
+// Print bandwidth results after measureBandwidth() and write a result
+// record. Engine -1 is all engines together, each using its maximum burst
+// size (burst_size 0).
+//
+static int
+printBandwidth(
+    int32_t engine,
+    uint64_t burst_size,
+    int mode,
+    const t_bw_stats *stats
+)
+{
+    double read_bw = stats->read_gbs;
+    double write_bw = stats->write_gbs;
+
+    if ((read_bw == 0) && (write_bw == 0))
+    {
+        printf("  FAIL: no memory traffic detected!\n");
+        return 1;
+    }
+
+    if (write_bw == 0)
+    {
+        printf("  Read GB/s:  %0.2f", read_bw);
+    }
+    else if (read_bw == 0)
+    {
+        printf("  Write GB/s: %0.2f", write_bw);
+    }
+    else
+    {
+        printf("  R+W GB/s:   %0.2f (read %0.2f, write %0.2f)",
+               read_bw + write_bw, read_bw, write_bw);
+    }
+
+    if (stats->num_runs > 1)
+    {
+        printf(" [%d runs, stddev %0.3f, 95%% CI +/- %0.3f]",
+               stats->num_runs, stats->stddev, stats->ci95);
+    }
+    printf("\n");
+
+    resultBegin("bandwidth");
+    resultInt("engine", engine);
+    resultStr("mode", (mode == 1) ? "read" : ((mode == 2) ? "write" : "read+write"));
+    resultInt("burst", burst_size);
+    resultDouble("read_gbs", read_bw);
+    resultDouble("write_gbs", write_bw);
+    resultInt("runs", stats->num_runs);
+    resultDouble("stddev_gbs", stats->stddev);
+    resultDouble("afu_mhz", s_afu_mhz);
+    resultEnd();
+
+    return 0;
+}
+
+
+//
+// Latency test modes. Modes 1-3 are read, write and read+write on all
+// engines. Modes 4-6 split engine 0 from the others. In LAT_MODE_ROLES,
+// each engine's direction comes from a --roles file.
+//
+#define LAT_MODE_ROLES 7
+
+static const char *
+latencyModeName(int mode)
+{
+    switch (mode)
+    {
+      case 1: return "read";
+      case 2: return "write";
+      case 3: return "read+write";
+      case 4: return "one read+others write";
+      case 5: return "one read+others read+write";
+      case LAT_MODE_ROLES: return "roles";
+      default: return "one write+others read";
+    }
+}
+
+
+//
+// Results of one offered load, computed by getLatencyAndBandwidth() and
+// printed by printLatencyAndBandwidth(). The two are separate so that
+// knee searches can print points sorted by offered load.
+//
+#define NUM_LAT_PCTS 4
+static const double s_lat_pcts[NUM_LAT_PCTS] = { 50, 90, 99, 99.9 };
+
+typedef struct
+{
+    t_engine_mask engine_mask;
+    uint64_t burst_size;
+    int mode;
+    uint32_t max_active_reqs;
+    t_bw_stats stats;
+
+    uint64_t max_reads_in_flight;
+    uint64_t fim_max_reads_in_flight;
+    double read_avg_lat;
+    double fim_read_avg_lat;
+    double write_avg_lat;
+
+    // FIM read latency percentiles (ns) of each engine. Only engines in
+    // lat_pct_mask have them. Engines in lat_overflow_mask had too many
+    // reads in flight to track.
+    t_engine_mask lat_pct_mask;
+    t_engine_mask lat_overflow_mask;
+    double lat_pct_ns[MAX_ENGINES][NUM_LAT_PCTS];
+}
+t_lat_bw_point;
+
+
+//
+// Compute bandwidth and latency results after measureBandwidth(). Bandwidth
+// is the mean over all runs. Latency is computed from the counters of the
+// last run. FIM latency percentiles are added by getLatencyPercentiles().
+//
+static int
+getLatencyAndBandwidth(
+    uint32_t num_engines,
+    t_engine_mask emask,
+    uint32_t max_active_reqs,
+    uint32_t n_sampled_rd_engines,
+    uint32_t n_sampled_wr_engines,
+    const t_bw_stats *stats,
+    t_lat_bw_point *pt
+)
+{
+    assert(! engMaskIsEmpty(emask));
+
+    double afu_ns_per_cycle = 1000.0 / s_afu_mhz;
+
+    uint64_t total_read_bytes = 0;
+    uint64_t total_write_bytes = 0;
+
+    memset(pt, 0, sizeof(t_lat_bw_point));
+    pt->engine_mask = emask;
+    pt->max_active_reqs = max_active_reqs;
+    pt->stats = *stats;
+
+    for (uint32_t glob_e = 0; glob_e < num_engines; glob_e += 1)
+    {
+        t_csr_handle_p csr_handle = s_eng_bufs[glob_e].csr_handle;
+        uint32_t e = s_eng_bufs[glob_e].accel_eng_idx;
+
+        if (engMaskTest(emask, glob_e))
+        {
+            // Read all the engine's counters together: line counts (2, 3),
+            // active lines (8, 9), FIM reads (10, 11), max in flight (12, 13)
+            // and clock cycles (14, 15).
+            t_csr_eng_snapshot snap;
+            fpga_result r = csrEngSnapshot(csr_handle, e, 0xff0c, &snap);
+            assert(FPGA_OK == r);
+
+            // Is the engine's FIM frequency known yet?
+            if (0 == s_eng_bufs[glob_e].fim_ifc_mhz)
+            {
+                uint64_t fim_clk_cycles = snap.csr[14];
+                uint64_t eng_clk_cycles = snap.csr[15];
+                s_eng_bufs[glob_e].fim_ifc_mhz = s_afu_mhz * fim_clk_cycles / eng_clk_cycles;
+                printf("# FIM %d interface MHz: %0.1f\n", glob_e, s_eng_bufs[glob_e].fim_ifc_mhz);
+            }
+            double fim_ns_per_cycle = 1000.0 / s_eng_bufs[glob_e].fim_ifc_mhz;
 
             // Count of lines read and written by the engine
-            uint64_t read_bytes = csrEngRead(csr_handle, e, 2) * s_eng_bufs[glob_e].data_bus_bytes;
-            eng_read_bytes[glob_e] = read_bytes;
+            uint64_t read_bytes = snap.csr[2] * s_eng_bufs[glob_e].data_bus_bytes;
             total_read_bytes += read_bytes;
-            uint64_t write_bytes = csrEngRead(csr_handle, e, 3) * s_eng_bufs[glob_e].data_bus_bytes;
-            eng_write_bytes[glob_e] = write_bytes;
+            uint64_t write_bytes = snap.csr[3] * s_eng_bufs[glob_e].data_bus_bytes;
             total_write_bytes += write_bytes;
 
             // Total active lines across all cycles, from the AFU
-            uint64_t read_active_bytes = csrEngRead(csr_handle, e, 8) * s_eng_bufs[glob_e].data_bus_bytes;
-            uint64_t write_active_bytes = csrEngRead(csr_handle, e, 9) * s_eng_bufs[glob_e].data_bus_bytes;
+            uint64_t read_active_bytes = snap.csr[8] * s_eng_bufs[glob_e].data_bus_bytes;
+            uint64_t write_active_bytes = snap.csr[9] * s_eng_bufs[glob_e].data_bus_bytes;
 
             // Compute average latency using Little's Law. Each sampled engine
             // is given equal weight.
             if (read_bytes)
             {
-                read_avg_lat += afu_ns_per_cycle * (read_active_bytes / read_bytes) / n_sampled_rd_engines;
+                pt->read_avg_lat += afu_ns_per_cycle * (read_active_bytes / read_bytes) / n_sampled_rd_engines;
             }
             if (write_bytes)
             {
-                write_avg_lat += afu_ns_per_cycle * (write_active_bytes / write_bytes) / n_sampled_wr_engines;
+                pt->write_avg_lat += afu_ns_per_cycle * (write_active_bytes / write_bytes) / n_sampled_wr_engines;
             }
 
             // Sample latency calculation for reads at the boundary to the FIM.
             // The separates the FIM latency from the PIM latency.
-            uint64_t fim_reads = csrEngRead(csr_handle, e, 10);
+            uint64_t fim_reads = snap.csr[10];
             if (fim_reads >> 63)
             {
                 fprintf(stderr, "ERROR: FIM read tracking request/response mismatch!\n");
                 exit(1);
             }
-            uint64_t fim_read_active = csrEngRead(csr_handle, e, 11);
+            uint64_t fim_read_active = snap.csr[11];
             if (fim_reads)
             {
-                fim_read_avg_lat += fim_ns_per_cycle * (fim_read_active / fim_reads) / n_sampled_rd_engines;
+                pt->fim_read_avg_lat += fim_ns_per_cycle * (fim_read_active / fim_reads) / n_sampled_rd_engines;
+            }
+
+            pt->max_reads_in_flight += snap.csr[12];
+            uint64_t fim_max_reads = snap.csr[13];
+            if (fim_max_reads >> 63)
+            {
+                // Unit is DWORDs, not lines. Reduce to lines.
+                fim_max_reads &= 0x7fffffffffffffffL;
+                fim_max_reads /= 16;
+            }
+            pt->fim_max_reads_in_flight += fim_max_reads;
+        }
+    }
+
+    if (!total_read_bytes && !total_write_bytes)
+    {
+        fprintf(stderr, "  FAIL: no memory traffic detected!\n");
+        return 1;
+    }
+
+    return 0;
+}
+
+
+//
+// Sum the bandwidth of the engines in pt on accelerators attached to
+// link l.
+//
+static uint32_t
+getLinkBandwidth(
+    const t_lat_bw_point *pt,
+    uint32_t l,
+    double *read_gbs,
+    double *write_gbs
+)
+{
+    uint32_t n_engines = 0;
+    *read_gbs = 0;
+    *write_gbs = 0;
+
+    for (uint32_t a = 0; a < s_num_accels; a += 1)
+    {
+        if (s_accels[a].link != l) continue;
+
+        for (uint32_t e = 0; e < s_accels[a].num_engines; e += 1)
+        {
+            uint32_t glob_e = s_accels[a].first_engine + e;
+            if (! engMaskTest(pt->engine_mask, glob_e)) continue;
+
+            *read_gbs += pt->stats.eng_read_gbs[glob_e];
+            *write_gbs += pt->stats.eng_write_gbs[glob_e];
+            n_engines += 1;
+        }
+    }
+
+    return n_engines;
+}
+
+
+//
+// Masks that fit in a non-negative 64 bit integer are recorded as numbers,
+// matching older results. Wider masks are recorded as hex strings.
+//
+static void
+resultEngineMask(const char *key, t_engine_mask m)
+{
+    t_engine_mask high = m;
+    high.w[0] >>= 63;
+    if (engMaskIsEmpty(high))
+    {
+        resultInt(key, m.w[0]);
+    }
+    else
+    {
+        char mask_str[80];
+        resultStr(key, engMaskStr(m, mask_str, sizeof(mask_str)));
+    }
+}
+
+
+//
+// Print the bandwidth of each link as comments when there are multiple
+// accelerators.
+//
+static void
+printLinkBandwidth(const t_lat_bw_point *pt)
+{
+    if (s_num_accels < 2) return;
+
+    for (uint32_t l = 0; l < s_num_links; l += 1)
+    {
+        double read_gbs, write_gbs;
+        uint32_t n = getLinkBandwidth(pt, l, &read_gbs, &write_gbs);
+        printf("# Link %s: %d engines, read GB/s %0.2f, write GB/s %0.2f\n",
+               s_link_names[l], n, read_gbs, write_gbs);
+    }
+}
+
+
+//
+// Print FIM read latency percentiles of each engine as comments.
+//
+static void
+printLatencyPercentiles(
+    uint32_t num_engines,
+    const t_lat_bw_point *pt
+)
+{
+    for (uint32_t glob_e = 0; glob_e < num_engines; glob_e += 1)
+    {
+        if (engMaskTest(pt->lat_overflow_mask, glob_e))
+        {
+            printf("# FIM %d read latency histogram overflow\n", glob_e);
+        }
+        else if (engMaskTest(pt->lat_pct_mask, glob_e))
+        {
+            printf("# FIM %d read latency ns:", glob_e);
+            for (uint32_t i = 0; i < NUM_LAT_PCTS; i += 1)
+            {
+                printf(" p%g %0.0f", s_lat_pcts[i], pt->lat_pct_ns[glob_e][i]);
+            }
+            printf("\n");
+        }
+    }
+}
+
+
+//
+// Print a row of results from getLatencyAndBandwidth(), followed by
+// comments with run statistics, per-link bandwidth when there are multiple
+// accelerators and latency percentiles.
+//
+static void
+printLatencyAndBandwidth(
+    uint32_t num_engines,
+    bool print_header,
+    const t_lat_bw_point *pt
+)
+{
+    const t_bw_stats *stats = &pt->stats;
+
+    if (print_header)
+    {
+        printf("Read GB/s, Write GB/s, Read Inflight Lines Limit, Read Max Measured Inflight Lines, "
+               "FIM Read Max Measured Inflight Lines, Write Inflight Lines Limit, "
+               "Read Avg Latency ns, FIM Read Avg Latency ns, Write Avg Latency ns");
+
+        if (num_engines > 1)
+        {
+            for (uint32_t glob_e = 0; glob_e < num_engines; glob_e += 1)
+            {
+                printf(", Eng%d Read GB/s, Eng%d Write GB/s", glob_e, glob_e);
             }
+        }
+
+        printf("\n");
+    }
+
+    printf("%0.2f %0.2f %d %ld %ld %d %0.0f %0.0f %0.0f",
+           stats->read_gbs, stats->write_gbs,
+           pt->max_active_reqs, pt->max_reads_in_flight, pt->fim_max_reads_in_flight,
+           pt->max_active_reqs,
+           pt->read_avg_lat, pt->fim_read_avg_lat, pt->write_avg_lat);
+
+    if (num_engines > 1)
+    {
+        for (uint32_t glob_e = 0; glob_e < num_engines; glob_e += 1)
+        {
+            printf(" %0.2f %0.2f", stats->eng_read_gbs[glob_e], stats->eng_write_gbs[glob_e]);
+        }
+    }
+
+    printf("\n");
+
+    if (stats->num_runs > 1)
+    {
+        printf("# Runs: %d, R+W GB/s stddev %0.3f, 95%% CI +/- %0.3f\n",
+               stats->num_runs, stats->stddev, stats->ci95);
+    }
+
+    printLinkBandwidth(pt);
+    printLatencyPercentiles(num_engines, pt);
+
+    resultBegin("latency");
+    resultEngineMask("engine_mask", pt->engine_mask);
+    resultStr("rd_cache_state",
+              rdCacheStateName(host_chan_params_opts.rd_cache_state));
+    resultStr("mode", latencyModeName(pt->mode));
+    resultInt("burst", pt->burst_size);
+    resultInt("max_active", pt->max_active_reqs);
+    resultDouble("read_gbs", stats->read_gbs);
+    resultDouble("write_gbs", stats->write_gbs);
+    resultInt("max_reads_in_flight", pt->max_reads_in_flight);
+    resultInt("fim_max_reads_in_flight", pt->fim_max_reads_in_flight);
+    resultDouble("read_lat_ns", pt->read_avg_lat);
+    resultDouble("fim_read_lat_ns", pt->fim_read_avg_lat);
+    resultDouble("write_lat_ns", pt->write_avg_lat);
+    resultInt("runs", stats->num_runs);
+    resultDouble("stddev_gbs", stats->stddev);
+    resultDouble("afu_mhz", s_afu_mhz);
+    resultEnd();
+
+    if (s_num_accels > 1)
+    {
+        for (uint32_t l = 0; l < s_num_links; l += 1)
+        {
+            double read_gbs, write_gbs;
+            uint32_t n = getLinkBandwidth(pt, l, &read_gbs, &write_gbs);
+
+            resultBegin("link_bandwidth");
+            resultStr("link", s_link_names[l]);
+            resultStr("mode", latencyModeName(pt->mode));
+            resultInt("burst", pt->burst_size);
+            resultInt("max_active", pt->max_active_reqs);
+            resultInt("engines", n);
+            resultDouble("read_gbs", read_gbs);
+            resultDouble("write_gbs", write_gbs);
+            resultEnd();
+        }
+    }
+
+    // FIM read latency percentiles, one record per engine
+    for (uint32_t glob_e = 0; glob_e < num_engines; glob_e += 1)
+    {
+        if (engMaskTest(pt->lat_pct_mask, glob_e))
+        {
+            resultBegin("latency_percentiles");
+            resultInt("engine", glob_e);
+            resultStr("mode", latencyModeName(pt->mode));
+            resultInt("burst", pt->burst_size);
+            resultInt("max_active", pt->max_active_reqs);
+            resultDouble("fim_mhz", s_eng_bufs[glob_e].fim_ifc_mhz);
+            resultDouble("p50_ns", pt->lat_pct_ns[glob_e][0]);
+            resultDouble("p90_ns", pt->lat_pct_ns[glob_e][1]);
+            resultDouble("p99_ns", pt->lat_pct_ns[glob_e][2]);
+            resultDouble("p99.9_ns", pt->lat_pct_ns[glob_e][3]);
+            resultEnd();
+        }
+    }
+}
+
+
+//
+// Read an engine's FIM read latency histogram. A bin is selected by writing
+// engine register 7 and is valid once register 7 echoes the bin index.
+// Returns false if the index is never echoed or if the histogram
+// overflowed. Engines without the histogram are found by
+// probeLatencyHistogram() and are not read.
+//
+#define LAT_HIST_BINS 32
+
+static bool
+readLatencyHistogram(
+    uint32_t glob_e,
+    uint64_t hist[LAT_HIST_BINS]
+)
+{
+    t_csr_handle_p csr_handle = s_eng_bufs[glob_e].csr_handle;
+    uint32_t e = s_eng_bufs[glob_e].accel_eng_idx;
+
+    for (uint32_t bin = 0; bin < LAT_HIST_BINS; bin += 1)
+    {
+        csrEngWrite(csr_handle, e, 7, bin);
+
+        // The selected bin crosses two clock domains
+        uint64_t v;
+        uint32_t trips = 0;
+        while (true)
+        {
+            v = csrEngRead(csr_handle, e, 7);
+            if (((v >> 48) & 0x1f) == bin) break;
+            if (++trips == 1000) return false;
+        }
+
+        if (v >> 63) return false;
+        hist[bin] = v & 0xffffffffffffL;
+    }
+
+    return true;
+}
+
+
+//
+// Latency (in cycles) at percentile pct of a log2 histogram. Bin 0 covers
+// [0, 2) and bin i [2^i, 2^(i+1)). Latencies are assumed to be uniform
+// within a bin.
+//
+static double
+histPercentile(
+    const uint64_t hist[LAT_HIST_BINS],
+    uint64_t total,
+    double pct
+)
+{
+    double target = total * pct / 100.0;
+    double seen = 0;
+
+    for (uint32_t bin = 0; bin < LAT_HIST_BINS; bin += 1)
+    {
+        if (hist[bin] && (seen + hist[bin] >= target))
+        {
+            double lo = bin ? (double)((uint64_t)1 << bin) : 0;
+            double hi = (double)((uint64_t)1 << (bin + 1));
+            return lo + (hi - lo) * (target - seen) / hist[bin];
+        }
+
+        seen += hist[bin];
+    }
+
+    return (double)((uint64_t)1 << LAT_HIST_BINS);
+}
+
+
+//
+// Compute FIM read latency percentiles of each sampled engine with reads.
+//
+static void
+getLatencyPercentiles(
+    uint32_t num_engines,
+    t_engine_mask emask,
+    t_lat_bw_point *pt
+)
+{
+    pt->lat_pct_mask = engMaskNone();
+    pt->lat_overflow_mask = engMaskNone();
+
+    for (uint32_t glob_e = 0; glob_e < num_engines; glob_e += 1)
+    {
+        if (! engMaskTest(emask, glob_e) ||
+            ! s_eng_bufs[glob_e].lat_hist ||
+            (0 == s_eng_bufs[glob_e].fim_ifc_mhz))
+            continue;
+
+        uint64_t hist[LAT_HIST_BINS];
+        if (! readLatencyHistogram(glob_e, hist))
+        {
+            t_csr_handle_p csr_handle = s_eng_bufs[glob_e].csr_handle;
+            if (csrEngRead(csr_handle, s_eng_bufs[glob_e].accel_eng_idx, 7) >> 63)
+            {
+                engMaskSet(&pt->lat_overflow_mask, glob_e);
+            }
+            continue;
+        }
+
+        uint64_t total = 0;
+        for (uint32_t bin = 0; bin < LAT_HIST_BINS; bin += 1)
+        {
+            total += hist[bin];
+        }
+
+        // No reads or histogram not implemented by the events module
+        if (0 == total) continue;
+
+        double fim_ns_per_cycle = 1000.0 / s_eng_bufs[glob_e].fim_ifc_mhz;
+        for (uint32_t i = 0; i < NUM_LAT_PCTS; i += 1)
+        {
+            pt->lat_pct_ns[glob_e][i] =
+                fim_ns_per_cycle * histPercentile(hist, total, s_lat_pcts[i]);
+        }
+        engMaskSet(&pt->lat_pct_mask, glob_e);
+    }
+}
+
+
+//
+// Configure the engines in engine_mask for a latency test mode and offered
+// load, then measure it.
+//
+static int
+measureLatencyPoint(
+    uint32_t num_engines,
+    t_engine_mask engine_mask,
+    uint64_t burst_size,
+    int mode,
+    uint32_t max_reqs,
+    t_lat_bw_point *pt
+)
+{
+    uint32_t num_readers = 0;
+    uint32_t num_writers = 0;
+    t_engine_mask rd_mask = engMaskNone();
+
+    for (uint32_t e = 0; e < num_engines; e += 1)
+    {
+        if (engMaskTest(engine_mask, e))
+        {
+            int eng_mode = mode;
+            if (mode == LAT_MODE_ROLES)
+                // Direction from the roles file
+                eng_mode = s_eng_roles[e];
+            else if (mode == 4)
+                // Only engine 0 read, all others write
+                eng_mode = (e == 0) ? 1 : 2;
+            else if (mode == 5)
+                // Only engine 0 read, all others read+write
+                eng_mode = (e == 0) ? 1 : 3;
+            else if (mode == 6)
+                // Only engine 0 write, all others read
+                eng_mode = (e == 0) ? 2 : 1;
+
+            configBandwidth(e, burst_size, eng_mode, max_reqs);
+            if (eng_mode & 1)
+            {
+                // Read buffer cache state is set before each run
+                num_readers += 1;
+                engMaskSet(&rd_mask, e);
+            }
+            if (eng_mode & 2)
+            {
+                num_writers += 1;
+                cacheFlushRange((void*)s_eng_bufs[e].wr_buf, s_eng_bufs[e].buf_bytes);
+            }
+        }
+
+    }
+
+    t_bw_stats stats;
+    measureBandwidth(num_engines, engine_mask, rd_mask, &stats);
+
+    if (getLatencyAndBandwidth(num_engines, engine_mask, max_reqs,
+                               num_readers, num_writers, &stats, pt))
+    {
+        return 1;
+    }
+
+    getLatencyPercentiles(num_engines, engine_mask, pt);
+    pt->burst_size = burst_size;
+    pt->mode = mode;
+    return 0;
+}
+
+
+//
+// Measure bandwidth and loaded latency at unlimited offered load, then
+// idle latency with one burst in flight per engine.
+//
+static int
+measureLoadedAndIdle(
+    uint32_t num_engines,
+    t_engine_mask engine_mask,
+    uint64_t burst_size,
+    int mode,
+    t_lat_bw_point *load,
+    t_lat_bw_point *idle
+)
+{
+    if (measureLatencyPoint(num_engines, engine_mask, burst_size, mode, 0, load))
+        return 1;
+    return measureLatencyPoint(num_engines, engine_mask, burst_size, mode,
+                               burst_size, idle);
+}
+
+
+//
+// Offered loads are multiples of 4 (or the burst size), up to the largest
+// load the engines support.
+//
+#define MAX_OFFERED_LOAD 608
+#define MAX_LATENCY_POINTS (MAX_OFFERED_LOAD / 4 + 2)
+
+static uint32_t
+nextOfferedLoad(uint32_t max_reqs)
+{
+    return (max_reqs + 4) & 0xfffffffc;
+}
+
+static double
+pointBandwidth(const t_lat_bw_point *pt)
+{
+    return pt->stats.read_gbs + pt->stats.write_gbs;
+}
+
+static double
+pointLatency(const t_lat_bw_point *pt)
+{
+    return pt->read_avg_lat + pt->write_avg_lat;
+}
+
+//
+// Run-to-run noise of a point's bandwidth and latency: the 95% confidence
+// interval from measureBandwidth(). Latency is derived from bandwidth by
+// Little's Law, so its relative error is taken to be the same. Zero unless
+// the point was measured with --rel-err.
+//
+static double
+pointBandwidthNoise(const t_lat_bw_point *pt)
+{
+    return pt->stats.ci95;
+}
+
+static double
+pointLatencyNoise(const t_lat_bw_point *pt)
+{
+    double bw = pointBandwidth(pt);
+    return (bw > 0) ? pointLatency(pt) * pt->stats.ci95 / bw : 0;
+}
+
+static int
+cmpLatencyPoint(const void *a, const void *b)
+{
+    const t_lat_bw_point *pa = a;
+    const t_lat_bw_point *pb = b;
+    return (int)pa->max_active_reqs - (int)pb->max_active_reqs;
+}
+
+
+//
+// Measure every offered load for one burst size and mode. The points array
+// must hold MAX_LATENCY_POINTS.
+//
+static uint32_t
+sweepOfferedLoad(
+    uint32_t num_engines,
+    t_engine_mask engine_mask,
+    uint64_t burst_size,
+    int mode,
+    t_lat_bw_point *points
+)
+{
+    uint32_t num_points = 0;
+
+    for (uint32_t max_reqs = burst_size; max_reqs <= MAX_OFFERED_LOAD; max_reqs = nextOfferedLoad(max_reqs))
+    {
+        if (0 == measureLatencyPoint(num_engines, engine_mask, burst_size,
+                                     mode, max_reqs, &points[num_points]))
+        {
+            num_points += 1;
+        }
+    }
+
+    return num_points;
+}
+
+
+//
+// A knee search measures at most KNEE_SEARCH_MAX_POINTS per curve. Without
+// --rel-err there is no noise floor, and run-to-run noise alone can make
+// every interval look bent and drive the search down to the full sweep.
+//
+#define KNEE_SEARCH_MAX_POINTS 32
+
+//
+// An interval whose midpoint deviates from the linear interpolation of its
+// ends, waiting to be split. dev is the larger of the bandwidth and latency
+// deviations, in units of the tolerance.
+//
+typedef struct
+{
+    const t_lat_bw_point *lo;
+    const t_lat_bw_point *mid;
+    const t_lat_bw_point *hi;
+    double dev;
+}
+t_knee_interval;
+
+//
+// State of a knee search for one burst size and mode
+//
+typedef struct
+{
+    uint32_t num_engines;
+    t_engine_mask engine_mask;
+    uint64_t burst_size;
+    int mode;
+
+    uint32_t num_points;
+    t_lat_bw_point *points;
+
+    // Curve extremes from the coarse sweep, used to scale the tolerance
+    double max_bw;
+    double max_lat;
+
+    // Bent intervals not yet split. Each has its own midpoint, so there
+    // are never more than there are points.
+    uint32_t num_bent;
+    t_knee_interval bent[KNEE_SEARCH_MAX_POINTS];
+
+    // Set when an interval was left unsplit for lack of points
+    bool hit_limit;
+}
+t_knee_search;
+
+static t_lat_bw_point *
+kneeSearchMeasure(t_knee_search *ks, uint32_t max_reqs)
+{
+    t_lat_bw_point *pt = &ks->points[ks->num_points];
+    if (measureLatencyPoint(ks->num_engines, ks->engine_mask, ks->burst_size,
+                            ks->mode, max_reqs, pt))
+    {
+        return NULL;
+    }
+
+    ks->num_points += 1;
+    return pt;
+}
+
+//
+// Deviation err of a midpoint in units of the tolerance scale. Zero if the
+// deviation is within the tolerance or the noise.
+//
+static double
+kneeDeviation(double err, double scale, double noise)
+{
+    if ((err <= scale) || (err <= noise)) return 0;
+    return (scale > 0) ? err / scale : HUGE_VAL;
+}
+
+//
+// Measure the midpoint of the interval between two measured points and
+// compare it to the linear interpolation of the ends. Bandwidth and latency
+// are piecewise linear in offered load away from the knees, so only
+// intervals in which the curve bends are queued to be split further.
+//
+// Differences within the run-to-run noise can't locate a knee. Intervals
+// whose ends differ by less than the noise are not measured, and a midpoint
+// deviation must exceed the noise as well as the tolerance.
+//
+static void
+kneeSearchCheck(
+    t_knee_search *ks,
+    const t_lat_bw_point *lo,
+    const t_lat_bw_point *hi
+)
+{
+    uint32_t mid_reqs = ((lo->max_active_reqs + hi->max_active_reqs) / 2) & 0xfffffffc;
+    if ((mid_reqs <= lo->max_active_reqs) || (mid_reqs >= hi->max_active_reqs))
+        return;
+
+    double bw_noise = fmax(pointBandwidthNoise(lo), pointBandwidthNoise(hi));
+    double lat_noise = fmax(pointLatencyNoise(lo), pointLatencyNoise(hi));
+    if ((fabs(pointBandwidth(hi) - pointBandwidth(lo)) < bw_noise) &&
+        (fabs(pointLatency(hi) - pointLatency(lo)) < lat_noise))
+        return;
+
+    if (ks->num_points == KNEE_SEARCH_MAX_POINTS)
+    {
+        ks->hit_limit = true;
+        return;
+    }
+
+    const t_lat_bw_point *mid = kneeSearchMeasure(ks, mid_reqs);
+    if (NULL == mid) return;
+
+    double tol = host_chan_params_opts.knee_tol;
+    double bw_err = fabs(pointBandwidth(mid) -
+                         (pointBandwidth(lo) + pointBandwidth(hi)) / 2);
+    double lat_err = fabs(pointLatency(mid) -
+                          (pointLatency(lo) + pointLatency(hi)) / 2);
+
+    bw_noise = fmax(bw_noise, pointBandwidthNoise(mid));
+    lat_noise = fmax(lat_noise, pointLatencyNoise(mid));
+
+    double dev = fmax(kneeDeviation(bw_err, tol * ks->max_bw, bw_noise),
+                      kneeDeviation(lat_err, tol * ks->max_lat, lat_noise));
+    if (dev > 0)
+    {
+        t_knee_interval *iv = &ks->bent[ks->num_bent++];
+        iv->lo = lo;
+        iv->mid = mid;
+        iv->hi = hi;
+        iv->dev = dev;
+    }
+}
+
+//
+// Find the bandwidth saturation knee and the latency inflections for one
+// burst size and mode without measuring every offered load. A coarse sweep
+// doubles the offered load. Intervals in which the curve bends are then
+// bisected down to the step of the exhaustive sweep, most bent first, until
+// KNEE_SEARCH_MAX_POINTS are measured. *hit_limit is set if bent intervals
+// remained. Points are returned sorted by offered load. The points array
+// must hold MAX_LATENCY_POINTS.
+//
+static uint32_t
+kneeSearch(
+    uint32_t num_engines,
+    t_engine_mask engine_mask,
+    uint64_t burst_size,
+    int mode,
+    t_lat_bw_point *points,
+    bool *hit_limit
+)
+{
+    t_knee_search ks;
+    memset(&ks, 0, sizeof(ks));
+    ks.num_engines = num_engines;
+    ks.engine_mask = engine_mask;
+    ks.burst_size = burst_size;
+    ks.mode = mode;
+    ks.points = points;
+
+    uint32_t max_reqs = burst_size;
+    while (true)
+    {
+        t_lat_bw_point *pt = kneeSearchMeasure(&ks, max_reqs);
+        if (pt)
+        {
+            if (ks.max_bw < pointBandwidth(pt)) ks.max_bw = pointBandwidth(pt);
+            if (ks.max_lat < pointLatency(pt)) ks.max_lat = pointLatency(pt);
+        }
+
+        if (max_reqs == MAX_OFFERED_LOAD) break;
+        max_reqs = nextOfferedLoad(2 * max_reqs - 1);
+        if (max_reqs > MAX_OFFERED_LOAD) max_reqs = MAX_OFFERED_LOAD;
+    }
+
+    // Refinement appends to the points array, leaving the coarse points
+    // in place.
+    uint32_t num_coarse = ks.num_points;
+    for (uint32_t i = 1; i < num_coarse; i += 1)
+    {
+        kneeSearchCheck(&ks, &points[i - 1], &points[i]);
+    }
+
+    // Split the most bent interval first, so that the point limit is spent
+    // on knees and not on noise.
+    while (ks.num_bent)
+    {
+        uint32_t k = 0;
+        for (uint32_t i = 1; i < ks.num_bent; i += 1)
+        {
+            if (ks.bent[i].dev > ks.bent[k].dev) k = i;
+        }
+
+        t_knee_interval iv = ks.bent[k];
+        ks.bent[k] = ks.bent[--ks.num_bent];
+
+        kneeSearchCheck(&ks, iv.lo, iv.mid);
+        kneeSearchCheck(&ks, iv.mid, iv.hi);
+    }
+
+    *hit_limit = ks.hit_limit;
+    qsort(points, ks.num_points, sizeof(t_lat_bw_point), cmpLatencyPoint);
+    return ks.num_points;
+}
+
+
+//
+// Measure expected read hash throughput on a synthetic region, scaling the
+// number of threads from 1 to max_threads. No FPGA is needed.
+//
+int
+testHostChanHashBench(
+    uint32_t max_threads)
+{
+    const size_t buf_bytes = MB(256);
+    const uint64_t num_lines = buf_bytes / CACHELINE_BYTES;
+    const int num_iter = 8;
+
+    // The fast hash paths must match the bit-by-bit RTL transcription
+    uint32_t hash_errors = hash32SelfCheck(time(NULL), 1000);
+    printf("# hash32 self-check: %s\n", hash_errors ? "FAILED" : "passed");
+    if (hash_errors) return 1;
+
+    uint64_t *buf = malloc(buf_bytes);
+    assert(NULL != buf);
+    initReadBuf(buf, buf_bytes);
+
+    uint32_t ref_hash = HASH32_DEFAULT_INIT;
+    uint32_t ref_sum = 0;
+    hashReadLines((uint16_t*)buf, CACHELINE_BYTES, num_lines, &ref_hash, &ref_sum);
+
+    if ((max_threads == 0) || (max_threads > threadPoolNumThreads()))
+    {
+        max_threads = threadPoolNumThreads();
+    }
+
+    printf("# Expected read hash of %d MB, %d byte lines\n",
+           (int)(buf_bytes / MB(1)), CACHELINE_BYTES);
+    printf("# Threads    GB/s   Speedup\n");
+
+    int result = 0;
+    double base_gbs = 0;
+    uint32_t num_threads = 1;
+    while (true)
+    {
+        threadPoolSetMaxThreads(num_threads);
+
+        struct timespec start, end;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        for (int i = 0; i < num_iter; i += 1)
+        {
+            uint32_t hash, sum;
+            computeExpectedRead((uint16_t*)buf, CACHELINE_BYTES, num_lines,
+                                &hash, &sum);
+            if ((hash != ref_hash) || (sum != ref_sum))
+            {
+                printf("  %d threads: hash 0x%08x, sum 0x%08x, expected 0x%08x, 0x%08x\n",
+                       num_threads, hash, sum, ref_hash, ref_sum);
+                result = 1;
+            }
+        }
+        clock_gettime(CLOCK_MONOTONIC, &end);
+
+        double secs = (end.tv_sec - start.tv_sec) +
+                      (end.tv_nsec - start.tv_nsec) * 1e-9;
+        double gbs = (double)buf_bytes * num_iter / secs / 1e9;
+        if (num_threads == 1) base_gbs = gbs;
+        printf("  %7d  %6.2f  %8.2f\n", num_threads, gbs, gbs / base_gbs);
+
+        if (num_threads == max_threads) break;
+        num_threads = (2 * num_threads < max_threads) ? 2 * num_threads : max_threads;
+    }
+
+    threadPoolSetMaxThreads(0);
+    free(buf);
+
+    return result;
+}
+
+
+//
+// Write check benchmark for one line size. Every kernel wide enough for the
+// lines must agree with the original line by line loop, on clean data and
+// on each injected error. Throughput of the loop is then compared with the
+// kernel chosen for the line size, run by 1 to max_threads threads.
+//
+static int
+benchWriteChk(
+    uint64_t *buf,
+    size_t buf_bytes,
+    uint32_t line_bytes,
+    uint32_t max_threads)
+{
+    const uint32_t burst_size = 64;
+    // Leave room for the terminating zero line
+    const uint32_t num_bursts = (buf_bytes / line_bytes - 1) / burst_size;
+    const uint64_t num_lines = (uint64_t)num_bursts * burst_size;
+    const uint64_t ioaddr = 0x12345;
+    const int num_iter = 8;
+
+    memset(buf, 0, buf_bytes);
+    for (uint64_t i = 0; i < num_lines; i += 1)
+    {
+        buf[i * (line_bytes / 8)] = ioaddr + i;
+        buf[(i + 1) * (line_bytes / 8) - 1] = 0xdeadbeef;
+    }
+
+    int result = 0;
+
+    const uint64_t err_lines[] = { 0, 3, WRITE_CHK_CHUNK_LINES + 5,
+                                   num_lines / 3, num_lines - 1, num_lines };
+    for (uint32_t k = 0; k < s_num_write_chk_kernels; k += 1)
+    {
+        if (s_write_chk_kernels[k].min_line_bytes > line_bytes) continue;
+        s_write_chk_forced = &s_write_chk_kernels[k];
+
+        for (uint32_t n = 0; n <= sizeof(err_lines) / sizeof(err_lines[0]); n += 1)
+        {
+            uint64_t *p = NULL;
+            uint64_t save = 0;
+            if (n > 0)
+            {
+                // Alternate between the low and high words
+                uint64_t line = err_lines[n - 1];
+                p = &buf[line * (line_bytes / 8) + ((n & 1) ? (line_bytes / 8 - 1) : 0)];
+                save = *p;
+                *p ^= 0x100;
+            }
+
+            threadPoolSetMaxThreads(max_threads);
+            uint32_t ref_idx, idx;
+            bool ref_ok = testExpectedWritesScalar(buf, ioaddr, line_bytes, num_bursts,
+                                                   burst_size, &ref_idx);
+            bool ok = testExpectedWrites(buf, ioaddr, line_bytes, num_bursts,
+                                         burst_size, &idx);
+            if ((ok != ref_ok) || (ok != (n == 0)) || (! ok && (idx != ref_idx)))
+            {
+                printf("  Write check mismatch, %s kernel, %d byte lines: %s line %d, "
+                       "reference %s line %d\n",
+                       s_write_chk_forced->name, line_bytes,
+                       ok ? "pass" : "fail", idx, ref_ok ? "pass" : "fail", ref_idx);
+                result = 1;
+            }
+
+            if (p) *p = save;
+        }
+    }
+    s_write_chk_forced = NULL;
+
+    printf("# Write check of %d MB, %d byte lines\n",
+           (int)(buf_bytes / MB(1)), line_bytes);
+    printf("# Verifier  Threads    GB/s   Speedup\n");
+
+    double base_gbs = 0;
+    uint32_t num_threads = 1;
+    bool scalar = true;
+    while (true)
+    {
+        threadPoolSetMaxThreads(num_threads);
+
+        struct timespec start, end;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        for (int i = 0; i < num_iter; i += 1)
+        {
+            uint32_t idx;
+            bool ok;
+            if (scalar)
+                ok = testExpectedWritesScalar(buf, ioaddr, line_bytes, num_bursts,
+                                              burst_size, &idx);
+            else
+                ok = testExpectedWrites(buf, ioaddr, line_bytes, num_bursts,
+                                        burst_size, &idx);
+            if (! ok)
+            {
+                printf("  Write check failed at line %d\n", idx);
+                result = 1;
+            }
+        }
+        clock_gettime(CLOCK_MONOTONIC, &end);
+
+        double secs = (end.tv_sec - start.tv_sec) +
+                      (end.tv_nsec - start.tv_nsec) * 1e-9;
+        double gbs = (double)buf_bytes * num_iter / secs / 1e9;
+        if (scalar) base_gbs = gbs;
+        printf("  %-8s  %7d  %6.2f  %8.2f\n",
+               scalar ? "loop" : writeChkKernel(line_bytes)->name,
+               num_threads, gbs, gbs / base_gbs);
+
+        if (scalar)
+        {
+            scalar = false;
+            continue;
+        }
+        if (num_threads == max_threads) break;
+        num_threads = (2 * num_threads < max_threads) ? 2 * num_threads : max_threads;
+    }
+
+    threadPoolSetMaxThreads(0);
+
+    return result;
+}
+
+
+//
+// Measure write check throughput on a synthetic region for each bus width.
+// No FPGA is needed.
+//
+int
+testHostChanWriteChkBench(
+    uint32_t max_threads)
+{
+    const size_t buf_bytes = MB(256);
+    const uint32_t line_sizes[] = { 32, 64, 128, 192 };
+
+    uint64_t *buf = malloc(buf_bytes);
+    assert(NULL != buf);
+
+    if ((max_threads == 0) || (max_threads > threadPoolNumThreads()))
+    {
+        max_threads = threadPoolNumThreads();
+    }
+
+    int result = 0;
+    for (uint32_t s = 0; s < sizeof(line_sizes) / sizeof(line_sizes[0]); s += 1)
+    {
+        if (s) printf("\n");
+        result |= benchWriteChk(buf, buf_bytes, line_sizes[s], max_threads);
+    }
+
+    free(buf);
+
+    return result;
+}
+
+
+//
+// Throughput of the cache management operations, single threaded and with
+// the thread pool. Lines are dirty before flush, write-back and demote and
+// are flushed before prefetch. Setup isn't timed.
+//
+int
+testHostChanCacheBench(
+    uint32_t max_threads)
+{
+    static const char *op_names[] = { "flush", "writeback", "demote", "prefetch" };
+    const size_t max_bytes = MB(256);
+
+    uint8_t *buf = malloc(max_bytes);
+    assert(NULL != buf);
+    memset(buf, 0, max_bytes);
+
+    if ((max_threads == 0) || (max_threads > threadPoolNumThreads()))
+    {
+        max_threads = threadPoolNumThreads();
+    }
+
+    const t_cache_features *cf = cacheGetFeatures();
+    printf("# Processor supports clflushopt: %d, clwb: %d, cldemote: %d\n",
+           cf->clflushopt, cf->clwb, cf->cldemote);
+    printf("# Op          KB  Threads    GB/s  ns/line\n");
+
+    for (int op = 0; op < 4; op += 1)
+    {
+        // cacheDemoteRange() does nothing without cldemote
+        if ((op == 2) && ! cf->cldemote)
+        {
+            printf("  %-9s unsupported\n", op_names[op]);
+            continue;
+        }
+
+        for (size_t len = KB(256); len <= max_bytes; len *= 4)
+        {
+            // Only flush and write-back are split across threads
+            uint32_t num_threads = 1;
+            while (true)
+            {
+                threadPoolSetMaxThreads(num_threads);
+
+                // Repeat small ranges to get a measurable time
+                int num_iter = max_bytes / len;
+                if (num_iter > 64) num_iter = 64;
+
+                double secs = 0;
+                for (int i = 0; i < num_iter; i += 1)
+                {
+                    if (op == 3)
+                        cacheFlushRange(buf, len);
+                    else
+                        memset(buf, i, len);
+
+                    struct timespec start, end;
+                    clock_gettime(CLOCK_MONOTONIC, &start);
+                    switch (op)
+                    {
+                      case 0: cacheFlushRange(buf, len); break;
+                      case 1: cacheWritebackRange(buf, len); break;
+                      case 2: cacheDemoteRange(buf, len); break;
+                      default: cachePrefetchRange(buf, len); break;
+                    }
+                    clock_gettime(CLOCK_MONOTONIC, &end);
+
+                    secs += (end.tv_sec - start.tv_sec) +
+                            (end.tv_nsec - start.tv_nsec) * 1e-9;
+                }
+
+                double bytes = (double)len * num_iter;
+                printf("  %-9s %7ld  %7d  %6.2f  %7.2f\n",
+                       op_names[op], (long)(len / KB(1)), num_threads,
+                       bytes / secs / 1e9,
+                       secs * 1e9 / (bytes / CACHELINE_BYTES));
+
+                if ((op >= 2) || (num_threads == max_threads)) break;
+                num_threads = (2 * num_threads < max_threads) ? 2 * num_threads : max_threads;
+            }
+        }
+    }
+
+    threadPoolSetMaxThreads(0);
+    free(buf);
+
+    return 0;
+}
+
+
+//
+// PCIe address of an accelerator. Returns false if unknown, e.g. for
+// software models.
+//
+static bool
+getAccelPciAddr(
+    fpga_handle accel_handle,
+    uint16_t *segment,
+    uint8_t *bus,
+    uint8_t *device,
+    uint8_t *function)
+{
+    if (NULL == accel_handle) return false;
+
+    fpga_properties props;
+    if (FPGA_OK != fpgaGetPropertiesFromHandle(accel_handle, &props)) return false;
+
+    *segment = 0;
+    *bus = *device = *function = 0;
+    fpgaPropertiesGetSegment(props, segment);
+    fpgaPropertiesGetBus(props, bus);
+    fpgaPropertiesGetDevice(props, device);
+    fpgaPropertiesGetFunction(props, function);
+    fpgaDestroyProperties(&props);
+
+    return true;
+}
+
+
+//
+// Record the accelerators under test, with engines numbered globally in
+// accelerator order. By default, accelerators are grouped into links by
+// PCIe segment and bus, so VFs of one card are reported together. Names
+// and default links are left in s_accel_desc, where roles and workload
+// files may regroup links. Returns the number of engines, or 0 on error.
+//
+static uint32_t
+describeAccels(
+    uint32_t num_accels,
+    fpga_handle *accel_handles,
+    t_csr_handle_p *csr_handles)
+{
+    uint32_t num_engines = 0;
+
+    if (num_accels > MAX_ACCELS)
+    {
+        fprintf(stderr, "Too many accelerators (%d), limit is %d\n", num_accels, MAX_ACCELS);
+        return 0;
+    }
+
+    memset(s_accel_desc, 0, sizeof(s_accel_desc));
+    for (uint32_t a = 0; a < num_accels; a += 1)
+    {
+        printf("# Test ID: %016" PRIx64 " %016" PRIx64 " (%ld)\n",
+               csrEngGlobRead(csr_handles[a], 1),
+               csrEngGlobRead(csr_handles[a], 0),
+               0xff & (csrEngGlobRead(csr_handles[a], 2) >> 24));
+
+        s_accels[a].accel_handle = accel_handles[a];
+        s_accels[a].csr_handle = csr_handles[a];
+        s_accels[a].first_engine = num_engines;
+        s_accels[a].num_engines = csrGetNumEngines(csr_handles[a]);
+        num_engines += s_accels[a].num_engines;
+
+        t_eng_roles_accel *ra = &s_accel_desc[a];
+        ra->num_engines = s_accels[a].num_engines;
+
+        uint16_t segment;
+        uint8_t bus, device, function;
+        if (! csr_handles[a]->model &&
+            getAccelPciAddr(accel_handles[a], &segment, &bus, &device, &function))
+        {
+            snprintf(ra->name, sizeof(ra->name), "%04x:%02x:%02x.%x",
+                     segment, bus, device, function);
+            snprintf(ra->link, sizeof(ra->link), "%04x:%02x", segment, bus);
+        }
+        else
+        {
+            // Each model is a separate link
+            snprintf(ra->name, sizeof(ra->name), "model%d", a);
+            strcpy(ra->link, ra->name);
+        }
+    }
+    s_num_accels = num_accels;
+
+    printf("# Engines: %d\n", num_engines);
+    if (num_engines > MAX_ENGINES)
+    {
+        fprintf(stderr, "Too many engines (%d), limit is %d\n", num_engines, MAX_ENGINES);
+        return 0;
+    }
+
+    return num_engines;
+}
+
+
+//
+// Number the links of s_accel_desc and initialize the engines of all
+// accelerators.
+//
+static void
+initAccelEngines(uint32_t num_engines)
+{
+    uint32_t num_accels = s_num_accels;
+
+    // Number the links in order of first use
+    s_num_links = 0;
+    for (uint32_t a = 0; a < num_accels; a += 1)
+    {
+        uint32_t l = 0;
+        while ((l < s_num_links) && strcmp(s_link_names[l], s_accel_desc[a].link))
+            l += 1;
+        if (l == s_num_links)
+        {
+            strcpy(s_link_names[l], s_accel_desc[a].link);
+            s_num_links += 1;
+        }
+        s_accels[a].link = l;
+
+        if (num_accels > 1)
+        {
+            printf("# Accelerator %d: %s, engines %d-%d, link %s\n", a,
+                   s_accel_desc[a].name, s_accels[a].first_engine,
+                   s_accels[a].first_engine + s_accels[a].num_engines - 1,
+                   s_link_names[l]);
+        }
+    }
+
+    // Allocate memory buffers for each engine
+    s_eng_bufs = malloc(num_engines * sizeof(t_engine_buf));
+    assert(NULL != s_eng_bufs);
+    s_num_engines = num_engines;
+    for (uint32_t a = 0; a < num_accels; a += 1)
+    {
+        for (uint32_t e = 0; e < s_accels[a].num_engines; e += 1)
+        {
+            initEngine(s_accels[a].first_engine + e, s_accels[a].accel_handle,
+                       s_accels[a].csr_handle, e);
+        }
+    }
+}
+
+
+//
+// Set up the accelerators and their engines. A roles file (NULL for none)
+// sets engine roles and may regroup links. Returns the number of engines,
+// or 0 on error.
+//
+static uint32_t
+initAccels(
+    uint32_t num_accels,
+    fpga_handle *accel_handles,
+    t_csr_handle_p *csr_handles,
+    const char *roles_path)
+{
+    uint32_t num_engines = describeAccels(num_accels, accel_handles, csr_handles);
+    if (0 == num_engines) return 0;
+
+    memset(s_eng_roles, 0, sizeof(s_eng_roles));
+    if (roles_path)
+    {
+        if (engRolesLoad(roles_path, num_accels, s_accel_desc, s_eng_roles)) return 0;
+        printf("# Roles file: %s\n", roles_path);
+    }
+
+    initAccelEngines(num_engines);
+    return num_engines;
+}
+
+
+int
+testHostChanParams(
+    int argc,
+    char *argv[],
+    fpga_handle accel_handle,
+    t_csr_handle_p csr_handle,
+    bool is_ase)
+{
+    int result = 0;
+    s_is_ase = is_ase;
+    // Simulation mirrors every pinned byte. Avoid 1GB pages.
+    if (is_ase) bufPoolSetMaxPageSize(MB(2));
+    // Poll less often in simulation
+    engWaitSetMaxPollNs(is_ase ? 2000000000 : 0);
+    s_is_model = (csr_handle->model != NULL);
+
+    uint32_t num_engines = initAccels(1, &accel_handle, &csr_handle, NULL);
+    if (0 == num_engines) return 1;
+    printf("\n");
+
+    // Test each engine separately
+    for (uint32_t e = 0; e < num_engines; e += 1)
+    {
+        if (testSmallRegions(num_engines, (uint64_t)1 << e))
+        {
+            // Quit on error
+            result = 1;
+            goto done;
+        }
+    }
+
+    // Test all the engines at once
+    if (num_engines > 1)
+    {
+        if (testSmallRegions(num_engines, ((uint64_t)1 << num_engines) - 1))
+        {
+            // Quit on error
+            result = 1;
+            goto done;
+        }
+    }
+
+    // Masked writes
+    for (uint32_t e = 0; e < num_engines; e += 1)
+    {
+        printf("\nTesting masked writes:\n");
+        if (testMaskedWrite(e))
+        {
+            // Quit on error
+            result = 1;
+            goto done;
+        }
+    }
+
+    // Bandwidth test each engine individually
+    bool printed_afu_mhz = false;
+    for (uint32_t e = 0; e < num_engines; e += 1)
+    {
+        uint64_t burst_size = 1;
+        while (burst_size <= s_eng_bufs[e].max_burst_size)
+        {
+            printf("\nTesting engine %d, burst size %ld:\n", e, burst_size);
+
+            for (int mode = 1; mode <= 3; mode += 1)
+            {
+                configBandwidth(e, burst_size, mode, 0);
+                t_bw_stats stats;
+                measureBandwidth(num_engines, engMaskOne(e), engMaskNone(), &stats);
+
+                if (! printed_afu_mhz)
+                {
+                    printf("  AFU clock is %.1f MHz\n", s_afu_mhz);
+                    printed_afu_mhz = true;
+                }
+
+                printBandwidth(e, burst_size, mode, &stats);
+            }
+
+            if (s_eng_bufs[e].natural_bursts)
+            {
+                // Natural burst sizes -- test powers of 2
+                burst_size <<= 1;
+            }
+            else
+            {
+                burst_size += 1;
+                if ((burst_size < s_eng_bufs[e].max_burst_size) && (burst_size == 9))
+                {
+                    burst_size = s_eng_bufs[e].max_burst_size;
+                }
+            }
+        }
+    }
+
+    // Bandwidth test all engines together
+    if (num_engines > 1)
+    {
+        printf("\nTesting all engines, max burst size:\n");
+
+        for (int mode = 1; mode <= 3; mode += 1)
+        {
+            for (uint32_t e = 0; e < num_engines; e += 1)
+            {
+                configBandwidth(e, s_eng_bufs[e].max_burst_size, mode, 0);
+            }
+            t_bw_stats stats;
+            measureBandwidth(num_engines, engMaskFirstN(num_engines), engMaskNone(), &stats);
+            printBandwidth(-1, 0, mode, &stats);
+        }
+    }
+
+    // Release buffers
+  done:
+    bufPoolRelease(s_is_model ? NULL : accel_handle);
+
+    return result;
+}
+
+
+int
+testHostChanLatency(
+    int argc,
+    char *argv[],
+    uint32_t num_accels,
+    fpga_handle *accel_handles,
+    t_csr_handle_p *csr_handles,
+    bool is_ase,
+    uint64_t engine_mask
+)
+{
+    int result = 0;
+    s_is_ase = is_ase;
+    // Simulation mirrors every pinned byte. Avoid 1GB pages.
+    if (is_ase) bufPoolSetMaxPageSize(MB(2));
+    // Poll less often in simulation
+    engWaitSetMaxPollNs(is_ase ? 2000000000 : 0);
+    s_is_model = (csr_handles[0]->model != NULL);
+
+    const char *roles_path = host_chan_params_opts.roles_path;
+    uint32_t num_engines = initAccels(num_accels, accel_handles, csr_handles, roles_path);
+    if (0 == num_engines) return 1;
+
+    // The numeric mask selects among the first 64 engines. All ones (the
+    // default) is every engine. A roles file selects the engines that
+    // aren't idle.
+    t_engine_mask emask = engMaskNone();
+    for (uint32_t e = 0; e < num_engines; e += 1)
+    {
+        bool selected;
+        if (roles_path)
+            selected = (s_eng_roles[e] != ENG_ROLE_IDLE);
+        else
+            selected = (engine_mask == ~(uint64_t)0) ||
+                       ((e < 64) && ((engine_mask >> e) & 1));
+
+        if (selected) engMaskSet(&emask, e);
+    }
+
+    if (engMaskIsEmpty(emask))
+    {
+        fprintf(stderr, "No engines selected!\n");
+        return 1;
+    }
+
+    uint64_t max_burst_size = 8;
+    bool natural_bursts = false;
+    for (uint32_t e = 0; e < num_engines; e += 1)
+    {
+        if (max_burst_size > s_eng_bufs[e].max_burst_size)
+            max_burst_size = s_eng_bufs[e].max_burst_size;
+
+        natural_bursts |= s_eng_bufs[e].natural_bursts;
+    }
+
+    t_lat_bw_point *points = malloc(MAX_LATENCY_POINTS * sizeof(t_lat_bw_point));
+    assert(NULL != points);
+
+    // Bandwidth test each engine individually
+    bool printed_afu_mhz = false;
+    uint64_t burst_size = 1;
+
+    int min_mode = 1;
+    int max_mode = 3;
+    if (num_accels > 1) max_mode = 5;
+    if (num_accels > 2) max_mode = 6;
+    if (roles_path) min_mode = max_mode = LAT_MODE_ROLES;
+
+    // Printed in decimal when it fits, as before wide masks
+    char mask_str[80];
+    bool wide_mask = false;
+    for (uint32_t i = 1; i < MAX_ENGINES / 64; i += 1)
+    {
+        wide_mask |= (emask.w[i] != 0);
+    }
+    if (wide_mask)
+        engMaskStr(emask, mask_str, sizeof(mask_str));
+    else
+        snprintf(mask_str, sizeof(mask_str), "%" PRIu64, emask.w[0]);
+
+    while (burst_size <= max_burst_size)
+    {
+        for (int mode = min_mode; mode <= max_mode; mode += 1)
+        {
+            // Measure either every offered load or just enough to find
+            // the knees in the curve
+            uint32_t num_points;
+            bool knee_hit_limit = false;
+            if (host_chan_params_opts.knee_tol > 0)
+            {
+                num_points = kneeSearch(num_engines, emask, burst_size,
+                                        mode, points, &knee_hit_limit);
+            }
+            else
+            {
+                num_points = sweepOfferedLoad(num_engines, emask, burst_size,
+                                              mode, points);
+            }
+
+            // Every point failed. There is nothing to print under a header.
+            if (0 == num_points) continue;
+
+            if (! printed_afu_mhz)
+            {
+                printf("# AFU MHz: %.1f\n", s_afu_mhz);
+                printed_afu_mhz = true;
+            }
+
+            printf("\n\n# Engine mask: %s\n", mask_str);
+            printf("# Read buffer cache state: %s\n",
+                   rdCacheStateName(host_chan_params_opts.rd_cache_state));
+            printRemoteCpu();
+            printf("# Burst size: %ld\n", burst_size);
+            printf("# Mode: %s\n", latencyModeName(mode));
+            if (knee_hit_limit)
+            {
+                printf("# Knee search stopped at %d points\n",
+                       KNEE_SEARCH_MAX_POINTS);
+            }
+
+            for (uint32_t i = 0; i < num_points; i += 1)
+            {
+                printLatencyAndBandwidth(num_engines, (i == 0), &points[i]);
+            }
+        }
+
+        if (! natural_bursts)
+            burst_size += 1;
+        else
+            burst_size <<= 1;
+    }
+
+    free(points);
+
+    // Release buffers
+  done:
+    for (uint32_t a = 0; a < num_accels; a += 1)
+    {
+        bufPoolRelease(s_is_model ? NULL : accel_handles[a]);
+    }
+
+    return result;
+}
+
+
+//
+// Sweep the footprint of engine buffers and the size of the pages backing
+// them, measuring bandwidth and latency at each point. The engines wrap
+// at the footprint, so large footprints touch many pages and expose the
+// cost of IOMMU translation (IOTLB misses or ATS) in the host.
+//
+int
+testHostChanFootprint(
+    int argc,
+    char *argv[],
+    fpga_handle accel_handle,
+    t_csr_handle_p csr_handle,
+    bool is_ase,
+    uint64_t max_footprint)
+{
+    int result = 0;
+    s_is_ase = is_ase;
+    // Poll less often in simulation
+    engWaitSetMaxPollNs(is_ase ? 2000000000 : 0);
+    s_is_model = (csr_handle->model != NULL);
+    fpga_handle pool_handle = s_is_model ? NULL : accel_handle;
+
+    uint32_t num_engines = initAccels(1, &accel_handle, &csr_handle, NULL);
+    if (0 == num_engines) return 1;
+
+    // All engines run together at the largest burst size they share.
+    // Buffers extend beyond the footprint by the largest burst.
+    uint64_t burst_size = 0;
+    size_t burst_bytes = 0;
+    for (uint32_t e = 0; e < num_engines; e += 1)
+    {
+        // ASE doesn't support physical addresses and uses virtual ones
+        if ((s_eng_bufs[e].addr_mode == ADDR_MODE_HOST_PHYSICAL) && !is_ase)
+        {
+            fprintf(stderr, "Engine %d uses physical addresses, which require buffers within\n"
+                            "a single page. Footprints and page sizes can't be swept.\n", e);
+            return 1;
+        }
+
+        if ((burst_size == 0) || (burst_size > s_eng_bufs[e].max_burst_size))
+            burst_size = s_eng_bufs[e].max_burst_size;
+        size_t b = s_eng_bufs[e].max_burst_size * s_eng_bufs[e].data_bus_bytes;
+        if (burst_bytes < b) burst_bytes = b;
+    }
+    t_engine_mask engine_mask = engMaskFirstN(num_engines);
+
+    // Simulation mirrors every pinned byte. Skip 1GB pages.
+    const size_t page_sizes[] = { 4096, MB(2), MB(1024) };
+    uint32_t num_page_sizes = is_ase ? 2 : 3;
+
+    for (uint32_t p = 0; p < num_page_sizes; p += 1)
+    {
+        size_t page_size = page_sizes[p];
+        const char *page_str = bufPoolPageSizeStr(page_size);
+        bufPoolSetMaxPageSize(page_size);
+
+        printf("\n\n# Page size: %s\n", page_str);
+        printf("# Burst size: %ld\n", burst_size);
+        printf("Footprint KB, Mode (1 read 2 write 3 read+write), Read GB/s, Write GB/s, "
+               "Read Avg Latency ns, Write Avg Latency ns, "
+               "Idle Read Latency ns, Idle Write Latency ns\n");
+
+        for (uint64_t footprint = 4096; footprint <= max_footprint; footprint <<= 1)
+        {
+            // Replace the buffers of the previous point
+            bufPoolRelease(pool_handle);
+
+            bool have_bufs = true;
+            for (uint32_t e = 0; e < num_engines; e += 1)
+            {
+                size_t align = (footprint < page_size) ? footprint : page_size;
+                if (allocEngineBuffers(e, footprint + burst_bytes, align, footprint, false) ||
+                    (s_eng_bufs[e].buf_page_size != page_size))
+                {
+                    have_bufs = false;
+                    break;
+                }
+            }
+
+            if (! have_bufs)
+            {
+                printf("# Failed to allocate %ld KB buffers with %s pages\n",
+                       footprint / 1024, page_str);
+                break;
+            }
+
+            for (int mode = 1; mode <= 3; mode += 1)
+            {
+                t_lat_bw_point load, idle;
+                if (measureLoadedAndIdle(num_engines, engine_mask, burst_size,
+                                         mode, &load, &idle))
+                {
+                    result = 1;
+                    goto done;
+                }
+
+                printf("%ld %d %0.2f %0.2f %0.0f %0.0f %0.0f %0.0f\n",
+                       footprint / 1024,
+                       mode,
+                       load.stats.read_gbs,
+                       load.stats.write_gbs,
+                       load.read_avg_lat,
+                       load.write_avg_lat,
+                       idle.read_avg_lat,
+                       idle.write_avg_lat);
+
+                resultBegin("footprint");
+                resultInt("page_size", page_size);
+                resultInt("footprint", footprint);
+                resultInt("burst", burst_size);
+                resultStr("mode", latencyModeName(mode));
+                resultDouble("read_gbs", load.stats.read_gbs);
+                resultDouble("write_gbs", load.stats.write_gbs);
+                resultDouble("read_lat_ns", load.read_avg_lat);
+                resultDouble("write_lat_ns", load.write_avg_lat);
+                resultDouble("idle_read_lat_ns", idle.read_avg_lat);
+                resultDouble("idle_write_lat_ns", idle.write_avg_lat);
+                resultEnd();
+            }
+        }
+
+        printRemoteCpu();
+    }
+
+  done:
+    bufPoolRelease(pool_handle);
+    bufPoolSetMaxPageSize(is_ase ? MB(2) : 0);
+
+    return result;
+}
+
+
+//
+// NUMA node of the FPGA's PCIe function, from sysfs. Returns -1 if unknown.
+//
+static int
+getAccelNumaNode(fpga_handle accel_handle)
+{
+    uint16_t segment;
+    uint8_t bus, device, function;
+    if (! getAccelPciAddr(accel_handle, &segment, &bus, &device, &function)) return -1;
+
+    char path[128];
+    snprintf(path, sizeof(path), "/sys/bus/pci/devices/%04x:%02x:%02x.%x/numa_node",
+             segment, bus, device, function);
+
+    int node = -1;
+    FILE *f = fopen(path, "r");
+    if (f)
+    {
+        if (1 != fscanf(f, "%d", &node)) node = -1;
+        fclose(f);
+    }
+
+    return node;
+}
+
+
+//
+// Buffer placement in a NUMA sweep: a single node or interleaved across
+// all nodes (node -1).
+//
+typedef struct
+{
+    int rd_node;
+    int wr_node;
+    t_lat_bw_point load;
+    t_lat_bw_point idle;
+}
+t_numa_point;
+
+static const char *
+numaNodeStr(int node, char *buf, size_t len)
+{
+    if (node < 0)
+        snprintf(buf, len, "all");
+    else
+        snprintf(buf, len, "%d", node);
+    return buf;
+}
+
+#define NUMA_SWEEP_BYTES MB(64)
+
+//
+// Place engine read and write buffers on the given nodes (-1 interleaves
+// across all nodes). Returns non-zero if allocation fails.
+//
+static int
+placeEngineBuffers(
+    uint32_t num_engines,
+    struct bitmask **node_masks,
+    struct bitmask *all_nodes,
+    size_t burst_bytes,
+    int rd_node,
+    int wr_node)
+{
+    bufPoolRelease(s_is_model ? NULL : s_eng_bufs[0].accel_handle);
+
+    for (uint32_t e = 0; e < num_engines; e += 1)
+    {
+        s_eng_bufs[e].numa_rd_mem_mask = (rd_node < 0) ? all_nodes : node_masks[rd_node];
+        s_eng_bufs[e].numa_rd_interleave = (rd_node < 0);
+        s_eng_bufs[e].numa_wr_mem_mask = (wr_node < 0) ? all_nodes : node_masks[wr_node];
+        s_eng_bufs[e].numa_wr_interleave = (wr_node < 0);
+
+        if (allocEngineBuffers(e, NUMA_SWEEP_BYTES + burst_bytes, MB(2),
+                               NUMA_SWEEP_BYTES, false))
+        {
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+
+//
+// Measure bandwidth and latency with read and write buffers placed on each
+// NUMA node, and interleaved across all nodes. Reads are swept over read
+// buffer placement, writes over write buffer placement and read+write over
+// every pair. Each row reports the penalty relative to buffers on the
+// FPGA's local node or, when the local node is unknown, relative to the
+// fastest single node placement.
+//
+int
+testHostChanNuma(
+    int argc,
+    char *argv[],
+    fpga_handle accel_handle,
+    t_csr_handle_p csr_handle,
+    bool is_ase)
+{
+    int result = 0;
+    s_is_ase = is_ase;
+    // Poll less often in simulation
+    engWaitSetMaxPollNs(is_ase ? 2000000000 : 0);
+    s_is_model = (csr_handle->model != NULL);
+
+    if (is_ase)
+    {
+        fprintf(stderr, "NUMA placement sweeps are not supported in ASE.\n");
+        return 1;
+    }
+
+    if (numa_available() < 0)
+    {
+        fprintf(stderr, "NUMA is not available on this system.\n");
+        return 1;
+    }
+
+    uint32_t num_engines = initAccels(1, &accel_handle, &csr_handle, NULL);
+    if (0 == num_engines) return 1;
+
+    uint64_t burst_size = 0;
+    size_t burst_bytes = 0;
+    for (uint32_t e = 0; e < num_engines; e += 1)
+    {
+        if (s_eng_bufs[e].addr_mode == ADDR_MODE_HOST_PHYSICAL)
+        {
+            fprintf(stderr, "Engine %d uses physical addresses, which are bound to the\n"
+                            "memory controller's nodes. NUMA placement can't be swept.\n", e);
+            return 1;
+        }
+
+        if ((burst_size == 0) || (burst_size > s_eng_bufs[e].max_burst_size))
+            burst_size = s_eng_bufs[e].max_burst_size;
+        size_t b = s_eng_bufs[e].max_burst_size * s_eng_bufs[e].data_bus_bytes;
+        if (burst_bytes < b) burst_bytes = b;
+    }
+    t_engine_mask engine_mask = engMaskFirstN(num_engines);
+
+    // Nodes with memory
+    int max_node = numa_max_node();
+    int num_nodes = 0;
+    int *nodes = malloc((max_node + 1) * sizeof(int));
+    struct bitmask **node_masks = calloc(max_node + 1, sizeof(struct bitmask*));
+    struct bitmask *all_nodes = numa_allocate_nodemask();
+    assert(nodes && node_masks && all_nodes);
+
+    printf("# NUMA nodes:");
+    for (int n = 0; n <= max_node; n += 1)
+    {
+        if (numa_bitmask_isbitset(numa_all_nodes_ptr, n))
+        {
+            nodes[num_nodes++] = n;
+            node_masks[n] = numa_allocate_nodemask();
+            numa_bitmask_setbit(node_masks[n], n);
+            numa_bitmask_setbit(all_nodes, n);
+            printf(" %d", n);
+        }
+    }
+    printf("\n");
+
+    int local_node = getAccelNumaNode(accel_handle);
+    if (local_node >= 0)
+        printf("# FPGA local node: %d\n", local_node);
+    else
+        printf("# FPGA local node: unknown, penalties are relative to the fastest node\n");
+
+    // Pages are the unit of interleaving. Buffers span many 2MB pages so
+    // that interleaved placement is meaningful, and every placement uses
+    // the same page size.
+    bufPoolSetMaxPageSize(MB(2));
+    printf("# Buffer footprint: %ld MB\n", (long)(NUMA_SWEEP_BYTES / MB(1)));
+    printf("# Burst size: %ld\n", burst_size);
+
+    // Single nodes, then interleaved if there is more than one node
+    int num_placements = num_nodes + ((num_nodes > 1) ? 1 : 0);
+    t_numa_point *points = calloc(num_placements * num_placements, sizeof(t_numa_point));
+    assert(NULL != points);
+
+    for (int mode = 1; mode <= 3; mode += 1)
+    {
+        // Reads vary only the read buffer placement, writes only the write
+        // buffer placement. Read+write varies both.
+        int n_rd = (mode & 1) ? num_placements : 1;
+        int n_wr = (mode & 2) ? num_placements : 1;
+        uint32_t num_points = 0;
+
+        for (int r = 0; r < n_rd; r += 1)
+        {
+            for (int w = 0; w < n_wr; w += 1)
+            {
+                t_numa_point *pt = &points[num_points];
+                pt->rd_node = (r < num_nodes) ? nodes[r] : -1;
+                pt->wr_node = (w < num_nodes) ? nodes[w] : -1;
+
+                if (placeEngineBuffers(num_engines, node_masks, all_nodes, burst_bytes,
+                                       pt->rd_node, pt->wr_node))
+                {
+                    fprintf(stderr, "Failed to allocate buffers on NUMA nodes %d/%d\n",
+                            pt->rd_node, pt->wr_node);
+                    result = 1;
+                    goto done;
+                }
+
+                if (measureLoadedAndIdle(num_engines, engine_mask, burst_size, mode,
+                                         &pt->load, &pt->idle))
+                {
+                    result = 1;
+                    goto done;
+                }
+
+                num_points += 1;
+            }
+        }
+
+        // Reference point: local node, or the fastest single node placement
+        const t_numa_point *ref = NULL;
+        for (uint32_t i = 0; i < num_points; i += 1)
+        {
+            const t_numa_point *pt = &points[i];
+            if (((mode & 1) && (pt->rd_node < 0)) || ((mode & 2) && (pt->wr_node < 0)))
+                continue;
+
+            if (local_node >= 0)
+            {
+                if ((!(mode & 1) || (pt->rd_node == local_node)) &&
+                    (!(mode & 2) || (pt->wr_node == local_node)))
+                {
+                    ref = pt;
+                }
+            }
+            else if ((NULL == ref) || (pointBandwidth(&pt->load) > pointBandwidth(&ref->load)))
+            {
+                ref = pt;
+            }
+        }
+        if (NULL == ref) ref = &points[0];
+
+        printf("\n\n# Mode: %s\n", latencyModeName(mode));
+        printRemoteCpu();
+        printf("Read Node, Write Node, Read GB/s, Write GB/s, "
+               "Read Avg Latency ns, Write Avg Latency ns, "
+               "Idle Read Latency ns, Idle Write Latency ns, "
+               "Bandwidth Penalty %%, Idle Latency Penalty ns\n");
+
+        for (uint32_t i = 0; i < num_points; i += 1)
+        {
+            const t_numa_point *pt = &points[i];
+            char rd_str[16], wr_str[16];
+            numaNodeStr(pt->rd_node, rd_str, sizeof(rd_str));
+            numaNodeStr(pt->wr_node, wr_str, sizeof(wr_str));
+
+            double ref_bw = pointBandwidth(&ref->load);
+            double bw_penalty = 0;
+            if (ref_bw > 0)
+                bw_penalty = 100.0 * (ref_bw - pointBandwidth(&pt->load)) / ref_bw;
+            double lat_penalty = pointLatency(&pt->idle) - pointLatency(&ref->idle);
+
+            printf("%s %s %0.2f %0.2f %0.0f %0.0f %0.0f %0.0f %0.1f %0.0f\n",
+                   (mode & 1) ? rd_str : "-",
+                   (mode & 2) ? wr_str : "-",
+                   pt->load.stats.read_gbs,
+                   pt->load.stats.write_gbs,
+                   pt->load.read_avg_lat,
+                   pt->load.write_avg_lat,
+                   pt->idle.read_avg_lat,
+                   pt->idle.write_avg_lat,
+                   bw_penalty,
+                   lat_penalty);
+
+            resultBegin("numa");
+            resultStr("mode", latencyModeName(mode));
+            // -1 is interleaved across all nodes
+            resultInt("read_node", pt->rd_node);
+            resultInt("write_node", pt->wr_node);
+            resultInt("local_node", local_node);
+            resultInt("burst", burst_size);
+            resultDouble("read_gbs", pt->load.stats.read_gbs);
+            resultDouble("write_gbs", pt->load.stats.write_gbs);
+            resultDouble("read_lat_ns", pt->load.read_avg_lat);
+            resultDouble("write_lat_ns", pt->load.write_avg_lat);
+            resultDouble("idle_read_lat_ns", pt->idle.read_avg_lat);
+            resultDouble("idle_write_lat_ns", pt->idle.write_avg_lat);
+            resultDouble("bw_penalty_pct", bw_penalty);
+            resultDouble("idle_lat_penalty_ns", lat_penalty);
+            resultEnd();
+        }
+    }
+
+  done:
+    bufPoolRelease(s_is_model ? NULL : accel_handle);
+    bufPoolSetMaxPageSize(0);
+
+    free(points);
+    for (int n = 0; n <= max_node; n += 1)
+    {
+        if (node_masks[n]) numa_bitmask_free(node_masks[n]);
+    }
+    numa_bitmask_free(all_nodes);
+    free(node_masks);
+    free(nodes);
+
+    return result;
+}
+
 
-            max_reads_in_flight += csrEngRead(csr_handle, e, 12);
-            uint64_t fim_max_reads = csrEngRead(csr_handle, e, 13);
-            if (fim_max_reads >> 63)
-            {
-                // Unit is DWORDs, not lines. Reduce to lines.
-                fim_max_reads &= 0x7fffffffffffffffL;
-                fim_max_reads /= 16;
-            }
-            fim_max_reads_in_flight += fim_max_reads;
-        }
+//
+// Buffer placement of one engine while a workload runs
+//
+typedef struct
+{
+    int rd_node;
+    int wr_node;
+    uint64_t footprint;
+}
+t_wl_placement;
+
+//
+// NUMA node mask for workload buffers. Masks are allocated on first use
+// and kept, since engine buffer state refers to them.
+//
+static struct bitmask *
+workloadNodeMask(int node)
+{
+    static struct bitmask **masks;
+    if (NULL == masks)
+    {
+        masks = calloc(numa_max_node() + 2, sizeof(struct bitmask*));
+        assert(NULL != masks);
     }
 
-    if (!total_read_bytes && !total_write_bytes)
+    // Slot 0 is all nodes with memory, used for interleaving
+    int slot = (node == WORKLOAD_NODE_ALL) ? 0 : node + 1;
+    if (NULL == masks[slot])
     {
-        fprintf(stderr, "  FAIL: no memory traffic detected!\n");
-        return 1;
+        masks[slot] = numa_allocate_nodemask();
+        if (slot == 0)
+            copy_bitmask_to_bitmask(numa_all_nodes_ptr, masks[slot]);
+        else
+            numa_bitmask_setbit(masks[slot], node);
     }
 
-    double read_bw = total_read_bytes * s_afu_mhz / (1000.0 * cycles);
-    double write_bw = total_write_bytes * s_afu_mhz / (1000.0 * cycles);
+    return masks[slot];
+}
+
 
-    if (print_header)
+//
+// Check workload settings that depend on the engines and the system.
+// Returns non-zero on error.
+//
+static int
+checkWorkload(
+    uint32_t num_engines,
+    const t_workload *wl
+)
+{
+    for (uint32_t p = 0; p < wl->num_phases; p += 1)
     {
-        printf("Read GB/s, Write GB/s, Read Inflight Lines Limit, Read Max Measured Inflight Lines, "
-               "FIM Read Max Measured Inflight Lines, Write Inflight Lines Limit, "
-               "Read Avg Latency ns, FIM Read Avg Latency ns, Write Avg Latency ns");
+        const t_workload_phase *ph = &wl->phases[p];
 
-        if (num_engines > 1)
+        for (uint32_t e = 0; e < num_engines; e += 1)
         {
-            for (uint32_t glob_e = 0; glob_e < num_engines; glob_e += 1)
+            const t_workload_eng *we = &ph->eng[e];
+            if (we->role == ENG_ROLE_IDLE) continue;
+
+            uint32_t burst_size = we->burst_size;
+            if (burst_size > s_eng_bufs[e].max_burst_size)
             {
-                printf(", Eng%d Read GB/s, Eng%d Write GB/s", glob_e, glob_e);
+                fprintf(stderr, "Phase %s: engine %d burst size %d exceeds maximum %d\n",
+                        ph->name, e, burst_size, s_eng_bufs[e].max_burst_size);
+                return 1;
+            }
+            if (s_eng_bufs[e].natural_bursts && (burst_size & (burst_size - 1)))
+            {
+                fprintf(stderr, "Phase %s: engine %d requires power of 2 burst sizes\n",
+                        ph->name, e);
+                return 1;
             }
-        }
-
-        printf("\n");
-    }
 
-    printf("%0.2f %0.2f %d %ld %ld %d %0.0f %0.0f %0.0f",
-           read_bw, write_bw,
-           max_active_reqs, max_reads_in_flight, fim_max_reads_in_flight, max_active_reqs,
-           read_avg_lat, fim_read_avg_lat, write_avg_lat);
+            int nodes[2] = { we->rd_node, we->wr_node };
+            for (int i = 0; i < 2; i += 1)
+            {
+                int node = nodes[i];
+                if (node == WORKLOAD_NODE_DEFAULT) continue;
 
-    if (num_engines > 1)
-    {
-        for (uint32_t glob_e = 0; glob_e < num_engines; glob_e += 1)
-        {
-            double eng_read_bw = eng_read_bytes[glob_e] * s_afu_mhz / (1000.0 * cycles);
-            double eng_write_bw = eng_write_bytes[glob_e] * s_afu_mhz / (1000.0 * cycles);
-            printf(" %0.2f %0.2f", eng_read_bw, eng_write_bw);
+                if ((s_eng_bufs[e].addr_mode == ADDR_MODE_HOST_PHYSICAL) && !s_is_ase)
+                {
+                    fprintf(stderr, "Phase %s: engine %d uses physical addresses, which are bound\n"
+                                    "to the memory controller's nodes. Buffers can't be placed.\n",
+                            ph->name, e);
+                    return 1;
+                }
+                if (numa_available() < 0)
+                {
+                    fprintf(stderr, "NUMA is not available on this system.\n");
+                    return 1;
+                }
+                if ((node >= 0) &&
+                    ((node > numa_max_node()) || ! numa_bitmask_isbitset(numa_all_nodes_ptr, node)))
+                {
+                    fprintf(stderr, "Phase %s: NUMA node %d has no memory\n", ph->name, node);
+                    return 1;
+                }
+            }
         }
     }
 
-    printf("\n");
-
     return 0;
 }
 
 
-int
-testHostChanParams(
-    int argc,
-    char *argv[],
-    fpga_handle accel_handle,
-    t_csr_handle_p csr_handle,
-    bool is_ase)
+//
+// Move engine buffers to the placement requested by a phase. Idle engines
+// keep their buffers where they are. Buffers are pooled, so when any
+// engine moves, all buffers are released and allocated again. Returns
+// non-zero if allocation fails.
+//
+static int
+placeWorkloadBuffers(
+    uint32_t num_engines,
+    const t_workload_phase *ph,
+    t_wl_placement *cur,
+    struct bitmask **dflt_rd_masks,
+    struct bitmask **dflt_wr_masks
+)
 {
-    int result = 0;
-    s_is_ase = is_ase;
+    bool changed = false;
+    t_wl_placement *next = malloc(num_engines * sizeof(t_wl_placement));
+    assert(NULL != next);
 
-    printf("# Test ID: %016" PRIx64 " %016" PRIx64 " (%ld)\n",
-           csrEngGlobRead(csr_handle, 1),
-           csrEngGlobRead(csr_handle, 0),
-           0xff & (csrEngGlobRead(csr_handle, 2) >> 24));
-
-    uint32_t num_engines = csrGetNumEngines(csr_handle);
-    printf("# Engines: %d\n", num_engines);
-
-    // Allocate memory buffers for each engine
-    s_eng_bufs = malloc(num_engines * sizeof(t_engine_buf));
-    assert(NULL != s_eng_bufs);
-    s_num_engines = num_engines;
     for (uint32_t e = 0; e < num_engines; e += 1)
     {
-        initEngine(e, accel_handle, csr_handle, e);
-    }
-    printf("\n");
+        const t_workload_eng *we = &ph->eng[e];
 
-    // Test each engine separately
-    for (uint32_t e = 0; e < num_engines; e += 1)
-    {
-        if (testSmallRegions(num_engines, (uint64_t)1 << e))
+        next[e] = cur[e];
+        if (we->role != ENG_ROLE_IDLE)
         {
-            // Quit on error
-            result = 1;
-            goto done;
+            next[e].rd_node = we->rd_node;
+            next[e].wr_node = we->wr_node;
+            next[e].footprint = we->footprint;
         }
+
+        changed |= (0 != memcmp(&next[e], &cur[e], sizeof(t_wl_placement)));
     }
 
-    // Test all the engines at once
-    if (num_engines > 1)
+    int result = 0;
+    if (! changed) goto done;
+
+    for (uint32_t a = 0; a < s_num_accels; a += 1)
     {
-        if (testSmallRegions(num_engines, ((uint64_t)1 << num_engines) - 1))
-        {
-            // Quit on error
-            result = 1;
-            goto done;
-        }
+        bufPoolRelease(s_is_model ? NULL : s_accels[a].accel_handle);
     }
 
-    // Masked writes
     for (uint32_t e = 0; e < num_engines; e += 1)
     {
-        printf("\nTesting masked writes:\n");
-        if (testMaskedWrite(e))
+        t_engine_buf *eb = &s_eng_bufs[e];
+        const t_wl_placement *pl = &next[e];
+
+        eb->numa_rd_mem_mask = (pl->rd_node == WORKLOAD_NODE_DEFAULT) ?
+                                   dflt_rd_masks[e] : workloadNodeMask(pl->rd_node);
+        eb->numa_rd_interleave = (pl->rd_node == WORKLOAD_NODE_ALL);
+        eb->numa_wr_mem_mask = (pl->wr_node == WORKLOAD_NODE_DEFAULT) ?
+                                   dflt_wr_masks[e] : workloadNodeMask(pl->wr_node);
+        eb->numa_wr_interleave = (pl->wr_node == WORKLOAD_NODE_ALL);
+
+        // Same sizes as initEngine() unless the footprint is set. Buffers
+        // then extend beyond the footprint by the largest burst.
+        size_t buf_bytes = MB(2);
+        size_t align = MB(2);
+        size_t mask_bytes = MB(1);
+        if (pl->footprint)
         {
-            // Quit on error
+            mask_bytes = pl->footprint;
+            buf_bytes = pl->footprint + eb->max_burst_size * eb->data_bus_bytes;
+            align = (mask_bytes < MB(2)) ? mask_bytes : MB(2);
+        }
+
+        if (allocEngineBuffers(e, buf_bytes, align, mask_bytes, false))
+        {
+            fprintf(stderr, "Phase %s: failed to allocate engine %d buffers\n", ph->name, e);
             result = 1;
             goto done;
         }
+
+        cur[e] = next[e];
     }
 
-    // Bandwidth test each engine individually
-    bool printed_afu_mhz = false;
-    for (uint32_t e = 0; e < num_engines; e += 1)
-    {
-        uint64_t burst_size = 1;
-        while (burst_size <= s_eng_bufs[e].max_burst_size)
-        {
-            printf("\nTesting engine %d, burst size %ld:\n", e, burst_size);
+  done:
+    free(next);
+    return result;
+}
 
-            for (int mode = 1; mode <= 3; mode += 1)
-            {
-                configBandwidth(e, burst_size, mode, 0);
-                runBandwidth(num_engines, (uint64_t)1 << e);
 
-                if (! printed_afu_mhz)
-                {
-                    printf("  AFU clock is %.1f MHz\n", s_afu_mhz);
-                    printed_afu_mhz = true;
-                }
+//
+// Print a workload phase's results: a row with total bandwidth and
+// latency and, with multiple engines, the bandwidth of each engine,
+// followed by comments. Records hold the phase totals, each active engine
+// and, with multiple accelerators, each link.
+//
+static void
+printWorkloadPhase(
+    uint32_t num_engines,
+    uint32_t phase_idx,
+    const t_workload_phase *ph,
+    const t_lat_bw_point *pt
+)
+{
+    const t_bw_stats *stats = &pt->stats;
 
-                printBandwidth(num_engines, (uint64_t)1 << e);
-            }
+    if (phase_idx == 0)
+    {
+        printf("Phase, Read GB/s, Write GB/s, Read Max Measured Inflight Lines, "
+               "FIM Read Max Measured Inflight Lines, "
+               "Read Avg Latency ns, FIM Read Avg Latency ns, Write Avg Latency ns");
 
-            if (s_eng_bufs[e].natural_bursts)
-            {
-                // Natural burst sizes -- test powers of 2
-                burst_size <<= 1;
-            }
-            else
+        if (num_engines > 1)
+        {
+            for (uint32_t glob_e = 0; glob_e < num_engines; glob_e += 1)
             {
-                burst_size += 1;
-                if ((burst_size < s_eng_bufs[e].max_burst_size) && (burst_size == 9))
-                {
-                    burst_size = s_eng_bufs[e].max_burst_size;
-                }
+                printf(", Eng%d Read GB/s, Eng%d Write GB/s", glob_e, glob_e);
             }
         }
+
+        printf("\n");
     }
 
-    // Bandwidth test all engines together
+    printf("%s %0.2f %0.2f %ld %ld %0.0f %0.0f %0.0f",
+           ph->name, stats->read_gbs, stats->write_gbs,
+           pt->max_reads_in_flight, pt->fim_max_reads_in_flight,
+           pt->read_avg_lat, pt->fim_read_avg_lat, pt->write_avg_lat);
+
     if (num_engines > 1)
     {
-        printf("\nTesting all engines, max burst size:\n");
-
-        for (int mode = 1; mode <= 3; mode += 1)
+        for (uint32_t glob_e = 0; glob_e < num_engines; glob_e += 1)
         {
-            for (uint32_t e = 0; e < num_engines; e += 1)
-            {
-                configBandwidth(e, s_eng_bufs[e].max_burst_size, mode, 0);
-            }
-            runBandwidth(num_engines, ((uint64_t)1 << num_engines) - 1);
-            printBandwidth(num_engines, ((uint64_t)1 << num_engines) - 1);
+            printf(" %0.2f %0.2f", stats->eng_read_gbs[glob_e], stats->eng_write_gbs[glob_e]);
         }
     }
 
-    // Release buffers
-  done:
-    for (uint32_t e = 0; e < num_engines; e += 1)
+    printf("\n");
+
+    if (stats->num_runs > 1)
     {
-        fpgaReleaseBuffer(accel_handle, s_eng_bufs[e].rd_wsid);
-        fpgaReleaseBuffer(accel_handle, s_eng_bufs[e].wr_wsid);
+        printf("# Runs: %d, R+W GB/s stddev %0.3f, 95%% CI +/- %0.3f\n",
+               stats->num_runs, stats->stddev, stats->ci95);
     }
 
-    return result;
+    printLinkBandwidth(pt);
+    printLatencyPercentiles(num_engines, pt);
+
+    uint32_t n_active = 0;
+    for (uint32_t glob_e = 0; glob_e < num_engines; glob_e += 1)
+    {
+        if (engMaskTest(pt->engine_mask, glob_e)) n_active += 1;
+    }
+
+    resultBegin("workload_phase");
+    resultInt("index", phase_idx);
+    resultStr("phase", ph->name);
+    resultInt("duration_ms", ph->duration_ms);
+    resultInt("engines", n_active);
+    resultDouble("read_gbs", stats->read_gbs);
+    resultDouble("write_gbs", stats->write_gbs);
+    resultInt("max_reads_in_flight", pt->max_reads_in_flight);
+    resultDouble("read_lat_ns", pt->read_avg_lat);
+    resultDouble("fim_read_lat_ns", pt->fim_read_avg_lat);
+    resultDouble("write_lat_ns", pt->write_avg_lat);
+    resultInt("runs", stats->num_runs);
+    resultDouble("stddev_gbs", stats->stddev);
+    resultEnd();
+
+    for (uint32_t glob_e = 0; glob_e < num_engines; glob_e += 1)
+    {
+        if (! engMaskTest(pt->engine_mask, glob_e)) continue;
+
+        const t_workload_eng *we = &ph->eng[glob_e];
+        resultBegin("workload_engine");
+        resultStr("phase", ph->name);
+        resultInt("engine", glob_e);
+        resultStr("role", engRoleName(we->role));
+        resultInt("burst", we->burst_size ? we->burst_size : s_eng_bufs[glob_e].max_burst_size);
+        resultInt("max_active", we->max_active);
+        resultDouble("read_gbs", stats->eng_read_gbs[glob_e]);
+        resultDouble("write_gbs", stats->eng_write_gbs[glob_e]);
+        resultEnd();
+    }
+
+    if (s_num_accels > 1)
+    {
+        for (uint32_t l = 0; l < s_num_links; l += 1)
+        {
+            double read_gbs, write_gbs;
+            uint32_t n = getLinkBandwidth(pt, l, &read_gbs, &write_gbs);
+
+            resultBegin("workload_link");
+            resultStr("phase", ph->name);
+            resultStr("link", s_link_names[l]);
+            resultInt("engines", n);
+            resultDouble("read_gbs", read_gbs);
+            resultDouble("write_gbs", write_gbs);
+            resultEnd();
+        }
+    }
 }
 
 
+//
+// Run the phases of a workload file back-to-back. Engines are stopped
+// between phases only long enough to reconfigure them and, when placement
+// changes, to move their buffers.
+//
 int
-testHostChanLatency(
+testHostChanWorkload(
     int argc,
     char *argv[],
     uint32_t num_accels,
     fpga_handle *accel_handles,
     t_csr_handle_p *csr_handles,
     bool is_ase,
-    uint32_t engine_mask
-)
+    const char *workload_path)
 {
     int result = 0;
-    uint32_t num_engines = 0;
     s_is_ase = is_ase;
-
-    for (uint32_t a = 0; a < num_accels; a += 1)
+    // Simulation mirrors every pinned byte. Avoid 1GB pages.
+    if (is_ase) bufPoolSetMaxPageSize(MB(2));
+    // Poll less often in simulation
+    engWaitSetMaxPollNs(is_ase ? 2000000000 : 0);
+    s_is_model = (csr_handles[0]->model != NULL);
+
+    uint32_t num_engines = describeAccels(num_accels, accel_handles, csr_handles);
+    if (0 == num_engines) return 1;
+
+    t_workload wl;
+    if (workloadLoad(workload_path, num_accels, s_accel_desc, &wl)) return 1;
+    printf("# Workload file: %s, %d phases\n", workload_path, wl.num_phases);
+
+    initAccelEngines(num_engines);
+
+    // Buffers start where initEngine() put them
+    t_wl_placement *cur = malloc(num_engines * sizeof(t_wl_placement));
+    struct bitmask **dflt_rd_masks = malloc(num_engines * sizeof(struct bitmask*));
+    struct bitmask **dflt_wr_masks = malloc(num_engines * sizeof(struct bitmask*));
+    assert(cur && dflt_rd_masks && dflt_wr_masks);
+    for (uint32_t e = 0; e < num_engines; e += 1)
     {
-        printf("# Test ID: %016" PRIx64 " %016" PRIx64 " (%ld)\n",
-               csrEngGlobRead(csr_handles[a], 1),
-               csrEngGlobRead(csr_handles[a], 0),
-               0xff & (csrEngGlobRead(csr_handles[a], 2) >> 24));
-
-        num_engines += csrGetNumEngines(csr_handles[a]);
+        cur[e].rd_node = WORKLOAD_NODE_DEFAULT;
+        cur[e].wr_node = WORKLOAD_NODE_DEFAULT;
+        cur[e].footprint = 0;
+        dflt_rd_masks[e] = s_eng_bufs[e].numa_rd_mem_mask;
+        dflt_wr_masks[e] = s_eng_bufs[e].numa_wr_mem_mask;
     }
 
-    printf("# Engines: %d\n", num_engines);
+    t_lat_bw_point *pt = malloc(sizeof(t_lat_bw_point));
+    assert(NULL != pt);
 
-    // Limit incoming engine mask to available engines
-    engine_mask &= (1 << num_engines) - 1;
-    if (0 == engine_mask)
+    if (checkWorkload(num_engines, &wl))
     {
-        fprintf(stderr, "No engines selected!\n");
-        return 1;
+        result = 1;
+        goto done;
     }
 
-    // Allocate memory buffers for each engine
-    s_eng_bufs = malloc(num_engines * sizeof(t_engine_buf));
-    assert(NULL != s_eng_bufs);
-    s_num_engines = num_engines;
-    uint64_t max_burst_size = 8;
-    bool natural_bursts = false;
-    uint32_t glob_e = 0;
-    for (uint32_t a = 0; a < num_accels; a += 1)
-    {
-        uint32_t accel_num_engines = csrGetNumEngines(csr_handles[a]);
-        for (uint32_t e = 0; e < accel_num_engines; e += 1)
-        {
-            initEngine(glob_e, accel_handles[a], csr_handles[a], e);
-
-            if (max_burst_size > s_eng_bufs[glob_e].max_burst_size)
-                max_burst_size = s_eng_bufs[glob_e].max_burst_size;
+    uint32_t run_time_ms = host_chan_params_opts.run_time_ms;
+    bool printed_afu_mhz = false;
 
-            natural_bursts |= s_eng_bufs[glob_e].natural_bursts;
+    for (uint32_t p = 0; p < wl.num_phases; p += 1)
+    {
+        const t_workload_phase *ph = &wl.phases[p];
 
-            glob_e += 1;
+        if (placeWorkloadBuffers(num_engines, ph, cur, dflt_rd_masks, dflt_wr_masks))
+        {
+            result = 1;
+            break;
         }
-    }
-
-    // Bandwidth test each engine individually
-    bool printed_afu_mhz = false;
-    uint64_t burst_size = 1;
 
-    int max_mode = 3;
-    if (num_accels > 1) max_mode = 5;
-    if (num_accels > 2) max_mode = 6;
+        t_engine_mask emask = engMaskNone();
+        t_engine_mask rd_mask = engMaskNone();
+        uint32_t num_readers = 0;
+        uint32_t num_writers = 0;
 
-    while (burst_size <= max_burst_size)
-    {
-        for (int mode = 1; mode <= max_mode; mode += 1)
+        for (uint32_t e = 0; e < num_engines; e += 1)
         {
-            bool printed_header = false;
-            for (uint32_t max_reqs = burst_size; max_reqs <= 608; max_reqs = (max_reqs + 4) & 0xfffffffc)
-            {
-                uint32_t num_readers = 0;
-                uint32_t num_writers = 0;
+            const t_workload_eng *we = &ph->eng[e];
+            if (we->role == ENG_ROLE_IDLE) continue;
 
-                for (uint32_t e = 0; e < num_engines; e += 1)
-                {
-                    if (engine_mask & (1 << e))
-                    {
-                        int eng_mode = mode;
-                        if (mode == 4)
-                            // Only engine 0 read, all others write
-                            eng_mode = (e == 0) ? 1 : 2;
-                        else if (mode == 5)
-                            // Only engine 0 read, all others read+write
-                            eng_mode = (e == 0) ? 1 : 3;
-                        else if (mode == 6)
-                            // Only engine 0 write, all others read
-                            eng_mode = (e == 0) ? 2 : 1;
-
-                        configBandwidth(e, burst_size, eng_mode, max_reqs);
-                        if (eng_mode & 1)
-                        {
-                            num_readers += 1;
-                            prefetchRange((void*)s_eng_bufs[e].rd_buf, MB(2));
-                        }
-                        if (eng_mode & 2)
-                        {
-                            num_writers += 1;
-                            flushRange((void*)s_eng_bufs[e].wr_buf, MB(2));
-                        }
-                    }
+            uint32_t burst_size = we->burst_size;
+            if (0 == burst_size) burst_size = s_eng_bufs[e].max_burst_size;
 
-                }
+            configBandwidth(e, burst_size, we->role, we->max_active);
+            engMaskSet(&emask, e);
+            if (we->role & ENG_ROLE_READ)
+            {
+                // Read buffer cache state is set before each run
+                num_readers += 1;
+                engMaskSet(&rd_mask, e);
+            }
+            if (we->role & ENG_ROLE_WRITE)
+            {
+                num_writers += 1;
+                cacheFlushRange((void*)s_eng_bufs[e].wr_buf, s_eng_bufs[e].buf_bytes);
+            }
+        }
 
-                runBandwidth(num_engines, engine_mask);
+        if (ph->duration_ms)
+            printf("\n# Phase %d: %s, %d ms\n", p, ph->name, ph->duration_ms);
+        else
+            printf("\n# Phase %d: %s\n", p, ph->name);
 
-                if (! printed_afu_mhz)
-                {
-                    printf("# AFU MHz: %.1f\n", s_afu_mhz);
-                    printed_afu_mhz = true;
-                }
+        // A phase with no active engines is a pause
+        if (engMaskIsEmpty(emask))
+        {
+            usleep((uint64_t)1000 * ph->duration_ms);
+            continue;
+        }
 
-                if (! printed_header)
-                {
-                    printf("\n\n# Engine mask: %d\n", engine_mask);
-                    printf("# Burst size: %ld\n", burst_size);
-                    printf("# Mode: ");
-                    if (mode == 1) printf("read\n");
-                    else if (mode == 2) printf("write\n");
-                    else if (mode == 3) printf("read+write\n");
-                    else if (mode == 4) printf("one read+others write\n");
-                    else if (mode == 5) printf("one read+others read+write\n");
-                    else printf("one write+others read\n");
-                }
+        host_chan_params_opts.run_time_ms = ph->duration_ms ? ph->duration_ms : run_time_ms;
 
-                printLatencyAndBandwidth(num_engines, engine_mask, max_reqs,
-                                         num_readers, num_writers,
-                                         ! printed_header);
+        t_bw_stats stats;
+        measureBandwidth(num_engines, emask, rd_mask, &stats);
+        if (getLatencyAndBandwidth(num_engines, emask, 0, num_readers, num_writers,
+                                   &stats, pt))
+        {
+            result = 1;
+            break;
+        }
+        getLatencyPercentiles(num_engines, emask, pt);
 
-                printed_header = true;
-            }
+        if (! printed_afu_mhz)
+        {
+            printf("# AFU MHz: %.1f\n", s_afu_mhz);
+            printed_afu_mhz = true;
         }
 
-        if (! natural_bursts)
-            burst_size += 1;
-        else
-            burst_size <<= 1;
+        printWorkloadPhase(num_engines, p, ph, pt);
+        printRemoteCpu();
     }
 
-    // Release buffers
+    host_chan_params_opts.run_time_ms = run_time_ms;
+
   done:
-    for (uint32_t e = 0; e < num_engines; e += 1)
+    free(pt);
+    free(cur);
+    free(dflt_rd_masks);
+    free(dflt_wr_masks);
+    workloadFree(&wl);
+
+    // Release buffers
+    for (uint32_t a = 0; a < num_accels; a += 1)
     {
-        fpgaReleaseBuffer(s_eng_bufs[e].accel_handle, s_eng_bufs[e].rd_wsid);
-        fpgaReleaseBuffer(s_eng_bufs[e].accel_handle, s_eng_bufs[e].wr_wsid);
+        bufPoolRelease(s_is_model ? NULL : accel_handles[a]);
     }
 
     return result;
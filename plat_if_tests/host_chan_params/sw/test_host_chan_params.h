@@ -7,6 +7,53 @@
 #include <opae/fpga.h>
 #include "tests_common.h"
 
+//
+// Host cache state of engine read buffers before each latency test run
+//
+typedef enum
+{
+    // Prefetched into the test thread's cache
+    RD_CACHE_LOCAL = 0,
+    // Flushed, so the FPGA reads DRAM
+    RD_CACHE_FLUSHED,
+    // Prefetched and then demoted to the LLC (cldemote)
+    RD_CACHE_LLC,
+    // Dirty in the cache of a helper thread on another core, preferably
+    // on another socket
+    RD_CACHE_REMOTE_DIRTY
+}
+t_rd_cache_state;
+
+//
+// Options that modify test behavior, set from the command line
+//
+typedef struct
+{
+    // Time engines run in each bandwidth test (ms). 0 picks the default.
+    uint32_t run_time_ms;
+    // When non-zero, print engine bandwidth every sample_interval_us
+    // while bandwidth tests run.
+    uint32_t sample_interval_us;
+    // When non-zero, repeat each bandwidth test until the 95% confidence
+    // interval of the mean is within rel_err of the mean, up to max_runs
+    // times.
+    double rel_err;
+    uint32_t max_runs;
+    // When non-zero, latency tests search for the knees of the bandwidth
+    // and latency curves instead of measuring every offered load. Intervals
+    // are split while the measured midpoint differs from linear
+    // interpolation by more than knee_tol of the curve's maximum.
+    double knee_tol;
+    // Cache state of read buffers before each latency test run
+    t_rd_cache_state rd_cache_state;
+    // When non-NULL, latency tests run once with per-engine roles and
+    // link groups from this file. See eng_roles.h.
+    const char *roles_path;
+}
+t_host_chan_params_opts;
+
+extern t_host_chan_params_opts host_chan_params_opts;
+
 int
 testHostChanParams(
     int argc,
@@ -23,6 +70,48 @@ testHostChanLatency(
     fpga_handle *accel_handles,
     t_csr_handle_p *csr_handles,
     bool is_ase,
-    uint32_t engine_mask);
+    uint64_t engine_mask);
+
+int
+testHostChanFootprint(
+    int argc,
+    char *argv[],
+    fpga_handle accel_handle,
+    t_csr_handle_p csr_handle,
+    bool is_ase,
+    uint64_t max_footprint);
+
+int
+testHostChanNuma(
+    int argc,
+    char *argv[],
+    fpga_handle accel_handle,
+    t_csr_handle_p csr_handle,
+    bool is_ase);
+
+int
+testHostChanWorkload(
+    int argc,
+    char *argv[],
+    uint32_t num_accels,
+    fpga_handle *accel_handles,
+    t_csr_handle_p *csr_handles,
+    bool is_ase,
+    const char *workload_path);
+
+int
+testHostChanHashBench(
+    uint32_t max_threads);
+
+int
+testHostChanWriteChkBench(
+    uint32_t max_threads);
+
+int
+testHostChanCacheBench(
+    uint32_t max_threads);
+
+const char *
+rdCacheStateName(t_rd_cache_state state);
 
 #endif // __TEST_HOST_CHAN_PARAMS_H__
@@ -0,0 +1,308 @@
+// Copyright (C) 2022 Intel Corporation
+// SPDX-License-Identifier: MIT
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <errno.h>
+
+#include "workload.h"
+
+#define MAX_TOKENS 12
+
+
+static int
+parseU32(const char *s, uint32_t max, uint32_t *v)
+{
+    char *endptr;
+    unsigned long n = strtoul(s, &endptr, 0);
+    if ((endptr == s) || (*endptr != '\0') || (n > max)) return 1;
+
+    *v = n;
+    return 0;
+}
+
+
+static int
+parseNode(const char *s, int *node)
+{
+    if (0 == strcasecmp(s, "all"))
+    {
+        *node = WORKLOAD_NODE_ALL;
+        return 0;
+    }
+
+    uint32_t n;
+    if (parseU32(s, 1023, &n)) return 1;
+    *node = n;
+    return 0;
+}
+
+
+//
+// Byte count with an optional K, M or G suffix
+//
+static int
+parseBytes(const char *s, uint64_t *bytes)
+{
+    char *endptr;
+    uint64_t v = strtoull(s, &endptr, 0);
+    if (endptr == s) return 1;
+
+    switch (*endptr)
+    {
+      case 'K': case 'k': v <<= 10; endptr += 1; break;
+      case 'M': case 'm': v <<= 20; endptr += 1; break;
+      case 'G': case 'g': v <<= 30; endptr += 1; break;
+    }
+    if (*endptr != '\0') return 1;
+
+    *bytes = v;
+    return 0;
+}
+
+
+//
+// Apply one "key=value" engine attribute. Returns 0 on success.
+//
+static int
+parseEngineAttr(char *attr, t_workload_eng *we)
+{
+    char *val = strchr(attr, '=');
+    if (NULL == val) return 1;
+    *val++ = '\0';
+
+    if (0 == strcmp(attr, "burst"))
+        return parseU32(val, 0x7fff, &we->burst_size) || (0 == we->burst_size);
+    if (0 == strcmp(attr, "max_active"))
+        return parseU32(val, 0xffff, &we->max_active);
+    if (0 == strcmp(attr, "rd_node"))
+        return parseNode(val, &we->rd_node);
+    if (0 == strcmp(attr, "wr_node"))
+        return parseNode(val, &we->wr_node);
+    if (0 == strcmp(attr, "node"))
+    {
+        if (parseNode(val, &we->rd_node)) return 1;
+        we->wr_node = we->rd_node;
+        return 0;
+    }
+    if (0 == strcmp(attr, "footprint"))
+    {
+        uint64_t f;
+        if (parseBytes(val, &f) || (f < 4096) || (f & (f - 1))) return 1;
+        we->footprint = f;
+        return 0;
+    }
+
+    return 1;
+}
+
+
+//
+// Parse "duration_ms = <ms>" in phase p. Whitespace around '=' is optional,
+// so the line may have been split into one to three tokens. As with engine
+// attributes, the rejoined tokens are split on '='.
+//
+static int
+parseDuration(char **tok, int n_tok, t_workload_phase *p)
+{
+    char setting[128];
+    setting[0] = '\0';
+    for (int i = 0; i < n_tok; i += 1)
+    {
+        strncat(setting, tok[i], sizeof(setting) - strlen(setting) - 1);
+    }
+
+    char *val = strchr(setting, '=');
+    if (NULL == val) return 1;
+    *val++ = '\0';
+
+    if (strcmp(setting, "duration_ms")) return 1;
+    return parseU32(val, 0xffffffff, &p->duration_ms);
+}
+
+
+static t_workload_phase *
+addPhase(t_workload *wl, const char *name, uint32_t num_engines)
+{
+    t_workload_phase *phases = realloc(wl->phases,
+                                       (wl->num_phases + 1) * sizeof(t_workload_phase));
+    if (NULL == phases) return NULL;
+    wl->phases = phases;
+
+    t_workload_phase *p = &phases[wl->num_phases];
+    memset(p, 0, sizeof(t_workload_phase));
+    snprintf(p->name, sizeof(p->name), "%s", name);
+
+    p->eng = calloc(num_engines, sizeof(t_workload_eng));
+    if (NULL == p->eng) return NULL;
+    for (uint32_t e = 0; e < num_engines; e += 1)
+    {
+        p->eng[e].rd_node = WORKLOAD_NODE_DEFAULT;
+        p->eng[e].wr_node = WORKLOAD_NODE_DEFAULT;
+    }
+
+    wl->num_phases += 1;
+    return p;
+}
+
+
+//
+// Parse "engine <accel> <engines> <role> [attr=value ...]" in phase p.
+//
+static int
+parseEngineLine(
+    char **tok,
+    int n_tok,
+    uint32_t num_accels,
+    const t_eng_roles_accel *accels,
+    t_workload_phase *p,
+    const char *path,
+    int line_num)
+{
+    uint32_t first, last;
+    t_workload_eng we;
+    memset(&we, 0, sizeof(we));
+    we.rd_node = WORKLOAD_NODE_DEFAULT;
+    we.wr_node = WORKLOAD_NODE_DEFAULT;
+
+    int a = engRolesFindAccel(tok[1], num_accels, accels);
+    if (a < 0)
+    {
+        fprintf(stderr, "%s:%d: unknown accelerator %s\n", path, line_num, tok[1]);
+        return 1;
+    }
+    if (engRolesParseEngines(tok[2], accels[a].num_engines, &first, &last))
+    {
+        fprintf(stderr, "%s:%d: invalid engines %s (accelerator %d has %d)\n",
+                path, line_num, tok[2], a, accels[a].num_engines);
+        return 1;
+    }
+    if (engRolesParseRole(tok[3], &we.role))
+    {
+        fprintf(stderr, "%s:%d: invalid role %s\n", path, line_num, tok[3]);
+        return 1;
+    }
+
+    for (int i = 4; i < n_tok; i += 1)
+    {
+        char attr[64];
+        snprintf(attr, sizeof(attr), "%s", tok[i]);
+        if (parseEngineAttr(tok[i], &we))
+        {
+            fprintf(stderr, "%s:%d: invalid engine attribute %s\n", path, line_num, attr);
+            return 1;
+        }
+    }
+
+    uint32_t base = engRolesFirstEngine(accels, a);
+    for (uint32_t e = first; e <= last; e += 1)
+    {
+        p->eng[base + e] = we;
+    }
+
+    return 0;
+}
+
+
+int
+workloadLoad(
+    const char *path,
+    uint32_t num_accels,
+    t_eng_roles_accel *accels,
+    t_workload *wl)
+{
+    memset(wl, 0, sizeof(t_workload));
+
+    FILE *f = fopen(path, "r");
+    if (NULL == f)
+    {
+        fprintf(stderr, "Failed to open workload file %s: %s\n", path, strerror(errno));
+        return 1;
+    }
+
+    uint32_t num_engines = engRolesFirstEngine(accels, num_accels);
+    t_workload_phase *p = NULL;
+
+    char line[512];
+    int line_num = 0;
+    int err = 0;
+    while (! err && fgets(line, sizeof(line), f))
+    {
+        line_num += 1;
+
+        char *tok[MAX_TOKENS];
+        int n_tok = engRolesSplitLine(line, tok, MAX_TOKENS);
+        if (n_tok == 0) continue;
+
+        err = 1;
+        size_t len = (n_tok == 2) ? strlen(tok[1]) : 0;
+
+        if ((n_tok == 2) && (0 == strcmp(tok[0], "[phase")) &&
+            (len > 1) && (tok[1][len - 1] == ']'))
+        {
+            // Section header: [phase <name>]
+            tok[1][len - 1] = '\0';
+            p = addPhase(wl, tok[1], num_engines);
+            if (NULL == p)
+                fprintf(stderr, "Out of memory\n");
+            else
+                err = 0;
+        }
+        else if ((n_tok == 3) && (0 == strcmp(tok[0], "link")))
+        {
+            int a = engRolesFindAccel(tok[1], num_accels, accels);
+            if (a < 0)
+            {
+                fprintf(stderr, "%s:%d: unknown accelerator %s\n", path, line_num, tok[1]);
+            }
+            else
+            {
+                snprintf(accels[a].link, sizeof(accels[a].link), "%s", tok[2]);
+                err = 0;
+            }
+        }
+        else if (p && (n_tok >= 4) && (0 == strcmp(tok[0], "engine")))
+        {
+            err = parseEngineLine(tok, n_tok, num_accels, accels, p, path, line_num);
+        }
+        else if (p && (n_tok <= 3) &&
+                 (0 == strncmp(tok[0], "duration_ms", strlen("duration_ms"))))
+        {
+            if (parseDuration(tok, n_tok, p))
+                fprintf(stderr, "%s:%d: invalid duration\n", path, line_num);
+            else
+                err = 0;
+        }
+        else
+        {
+            fprintf(stderr, "%s:%d: expected \"[phase <name>]\", \"duration_ms = <ms>\", "
+                            "\"engine <accel> <engines> <role> [attr=value ...]\" "
+                            "or \"link <accel> <name>\"\n", path, line_num);
+        }
+    }
+
+    fclose(f);
+
+    if (! err && (0 == wl->num_phases))
+    {
+        fprintf(stderr, "%s: no phases\n", path);
+        err = 1;
+    }
+
+    if (err) workloadFree(wl);
+    return err;
+}
+
+
+void
+workloadFree(t_workload *wl)
+{
+    for (uint32_t i = 0; i < wl->num_phases; i += 1)
+    {
+        free(wl->phases[i].eng);
+    }
+    free(wl->phases);
+    memset(wl, 0, sizeof(t_workload));
+}
@@ -0,0 +1,90 @@
+// Copyright (C) 2022 Intel Corporation
+// SPDX-License-Identifier: MIT
+
+//
+// Declarative engine workloads (--workload), described in an INI-style
+// text file. A workload is a list of phases that run back-to-back:
+//
+//   # Accelerator grouping for reporting, as in --roles files
+//   link 0 card0
+//
+//   [phase fill]
+//   duration_ms = 50
+//   engine 0 0-3 write burst=4 max_active=64 wr_node=0
+//
+//   [phase steady]
+//   duration_ms = 200
+//   engine 0 * rw burst=2 max_active=32 footprint=64M
+//   engine 1 0 read rd_node=all
+//
+// Accelerators, engines and roles are named as in eng_roles.h. Engines not
+// listed in a phase are idle during it. Optional engine attributes:
+//
+//   burst=<lines>       Burst size (default: the engine's maximum)
+//   max_active=<lines>  Limit on lines in flight (default: unlimited)
+//   rd_node=<n|all>     NUMA node of the read buffer, or interleaved
+//   wr_node=<n|all>     NUMA node of the write buffer, or interleaved
+//   node=<n|all>        Both buffers
+//   footprint=<bytes>   Buffer footprint at which the engine wraps, a power
+//                       of 2 (K, M and G suffixes are allowed)
+//
+// duration_ms is optional. Without it, a phase runs for the normal
+// bandwidth test time. Whitespace around its '=' is optional.
+//
+
+#ifndef __WORKLOAD_H__
+#define __WORKLOAD_H__
+
+#include <stdint.h>
+#include "eng_roles.h"
+
+// Buffer placement values other than a NUMA node
+#define WORKLOAD_NODE_DEFAULT -1
+#define WORKLOAD_NODE_ALL -2
+
+typedef struct
+{
+    t_eng_role role;
+    // 0 is the engine's maximum burst size
+    uint32_t burst_size;
+    // 0 is unlimited
+    uint32_t max_active;
+    int rd_node;
+    int wr_node;
+    // 0 is the default buffer size
+    uint64_t footprint;
+}
+t_workload_eng;
+
+typedef struct
+{
+    char name[ENG_ROLES_MAX_NAME];
+    // 0 is the default run time
+    uint32_t duration_ms;
+    // Indexed by global engine number
+    t_workload_eng *eng;
+}
+t_workload_phase;
+
+typedef struct
+{
+    uint32_t num_phases;
+    t_workload_phase *phases;
+}
+t_workload;
+
+//
+// Parse the workload file at path. "link" lines update accels. Returns 0
+// on success. Errors are reported on stderr with the file and line number.
+// Attribute values that depend on the engines (burst size limits, NUMA
+// nodes) are checked when the workload runs.
+//
+int workloadLoad(
+    const char *path,
+    uint32_t num_accels,
+    t_eng_roles_accel *accels,
+    t_workload *wl);
+
+void workloadFree(t_workload *wl);
+
+#endif // __WORKLOAD_H__
@@ -36,6 +36,9 @@ typedef struct
     uint32_t eng_type;
     bool natural_bursts;
     bool ordered_read_responses;
+
+    // Expected hash computation, sized for data_byte_width
+    t_test_data_ctx *chk_ctx;
 }
 t_engine_buf;
 
@@ -44,6 +47,8 @@ static t_csr_handle_p s_csr_handle;
 static bool s_is_ase;
 static t_engine_buf* s_eng_bufs;
 static double s_afu_mhz;
+// Engine waits check for hangs each time this passes
+static uint64_t s_hang_check_ns;
 
 static char *engine_type[] = 
 {
@@ -188,42 +193,21 @@ runEnginesTest(
 
     uint64_t prev_total_lines = 0;
 
-    // Wait for engines to complete. Checking csrGetEnginesEnabled()
-    // resolves a race between the request to start an engine
-    // and the engine active flag going high. Execution is done when
-    // the engine is enabled and the active flag goes low.
-    struct timespec wait_time;
-    // Poll less often in simulation
-    wait_time.tv_sec = (s_is_ase ? 2 : 0);
-    wait_time.tv_nsec = 10000000;
-    int trips = 0;
-    while (true)
+    // Wait for engines to complete. Some simulators are very slow, so
+    // a timeout isn't fatal as long as traffic is still flowing.
+    while (engWait(s_csr_handle, ENG_WAIT_DONE, s_hang_check_ns))
     {
-        uint64_t eng_enabled = csrGetEnginesEnabled(s_csr_handle);
-        uint64_t eng_active = csrGetEnginesActive(s_csr_handle);
-
-        // Done once the engine has been enabled and it is
-        // no longer active.
-        if (eng_enabled && ! eng_active) break;
-
-        trips += 1;
-        if (trips == 10)
+        uint64_t cur_total_lines = totalMemLines(emask);
+        if (cur_total_lines == prev_total_lines)
         {
-            // Some simulators are very slow. Is there still traffic flowing?
-            uint64_t cur_total_lines = totalMemLines(emask);
-            if (cur_total_lines == prev_total_lines)
-            {
-                printf(" - HANG!\n\n");
-                printf("Aborting - enabled mask 0x%lx, active mask 0x%lx\n",
-                       eng_enabled, eng_active);
-                return 1;
-            }
-
-            prev_total_lines = cur_total_lines;
-            trips = 0;
+            printf(" - HANG!\n\n");
+            printf("Aborting - enabled mask 0x%lx, active mask 0x%lx\n",
+                   csrGetEnginesEnabled(s_csr_handle),
+                   csrGetEnginesActive(s_csr_handle));
+            return 1;
         }
 
-        nanosleep(&wait_time, NULL);
+        prev_total_lines = cur_total_lines;
     }
 
     // Stop the engines
@@ -422,7 +406,7 @@ testBankWiring(
         // Check hashes
         for (uint32_t e = 0; e < num_engines; e += 1)
         {
-            uint64_t expected_hash = testDataChkGen(s_eng_bufs[e].data_byte_width, rand(), 4);
+            uint64_t expected_hash = testDataCtxChkGen(s_eng_bufs[e].chk_ctx, rand(), 4);
             uint64_t hw_hash = csrEngRead(s_csr_handle, e, 5);
 
             printf("  Engine %d, addr 0x%x", e, start_addr);
@@ -451,7 +435,6 @@ testSmallRegions(
 )
 {
     int num_errors = 0;
-    size_t data_byte_width = s_eng_bufs[e].data_byte_width;
 
     // What is the maximum burst size for the engine? It is encoded in CSR 0.
     uint64_t max_burst_size = s_eng_bufs[e].max_burst_size;
@@ -515,10 +498,11 @@ testSmallRegions(
                 }
 
                 // Compute expected hash
-                expected_hash = testDataChkGen(data_byte_width, seed, num_bursts * burst_size);
+                expected_hash = testDataCtxChkGen(s_eng_bufs[e].chk_ctx, seed, num_bursts * burst_size);
 
                 hw_hash = csrEngRead(s_csr_handle, e, 5);
-                if ((mode == 1) || (expected_hash == hw_hash))
+                bool pass = (mode == 1) || (expected_hash == hw_hash);
+                if (pass)
                 {
                     printf(" - PASS\n");
                 }
@@ -529,6 +513,14 @@ testSmallRegions(
                     printf("    0x%016lx, expected 0x%016lx\n", hw_hash, expected_hash);
                 }
 
+                resultBegin("engine_test");
+                resultInt("engine", e);
+                resultStr("mode", (mode == 1) ? "write" : ((mode == 2) ? "read" : "read+write"));
+                resultInt("burst", burst_size);
+                resultInt("num_bursts", num_bursts);
+                resultBool("pass", pass);
+                resultEnd();
+
                 // Update hash if a write was done
                 if (mode & 1) seed = wr_seed;
             }
@@ -546,7 +538,7 @@ testSmallRegions(
                 goto fail;
             }
 
-            expected_hash = testDataChkGen(data_byte_width, seed, num_bursts * burst_size);
+            expected_hash = testDataCtxChkGen(s_eng_bufs[e].chk_ctx, seed, num_bursts * burst_size);
             hw_hash = csrEngRead(s_csr_handle, e, 5);
             if (expected_hash != hw_hash)
             {
@@ -604,11 +596,12 @@ configBandwidth(
 
 //
 // Run a bandwidth test (configured already with configBandwidth) on the set
-// of engines indicated by emask.
+// of engines indicated by emask. Burst size is used only for reporting.
 //
 static int
 runBandwidth(
-    uint64_t emask
+    uint64_t emask,
+    uint64_t burst_size
 )
 {
     assert(emask != 0);
@@ -616,13 +609,7 @@ runBandwidth(
     csrEnableEngines(s_csr_handle, emask);
 
     // Wait for them to start
-    struct timespec wait_time;
-    wait_time.tv_sec = (s_is_ase ? 2 : 0);
-    wait_time.tv_nsec = 100000000;
-    while (csrGetEnginesEnabled(s_csr_handle) == 0)
-    {
-        nanosleep(&wait_time, NULL);
-    }
+    engWait(s_csr_handle, ENG_WAIT_STARTED, 0);
 
     // Let them run for a while
     sleep(s_is_ase ? 10 : 1);
@@ -631,32 +618,20 @@ runBandwidth(
 
     // Wait for them to stop
     uint64_t prev_total_lines = 0;
-    int trips = 0;
-    while (true)
+    while (engWait(s_csr_handle, ENG_WAIT_IDLE, s_hang_check_ns))
     {
-        uint64_t eng_active = csrGetEnginesActive(s_csr_handle);
-
-        // Done once no engine is active
-        if (! eng_active) break;
-
-        trips += 1;
-        if (trips == 10)
+        // Some simulators are very slow. Is there still traffic flowing?
+        uint64_t cur_total_lines = totalMemLines(emask);
+        if (cur_total_lines == prev_total_lines)
         {
-            // Some simulators are very slow. Is there still traffic flowing?
-            uint64_t cur_total_lines = totalMemLines(emask);
-            if (cur_total_lines == prev_total_lines)
-            {
-                printf(" - HANG!\n\n");
-                printf("Aborting - active mask 0x%lx\n", eng_active);
-                testDumpMaskedEngineState(emask);
-                exit(1);
-            }
-
-            prev_total_lines = cur_total_lines;
-            trips = 0;
+            printf(" - HANG!\n\n");
+            printf("Aborting - active mask 0x%lx\n",
+                   csrGetEnginesActive(s_csr_handle));
+            testDumpMaskedEngineState(emask);
+            exit(1);
         }
 
-        nanosleep(&wait_time, NULL);
+        prev_total_lines = cur_total_lines;
     }
 
     if (s_afu_mhz == 0)
@@ -700,6 +675,15 @@ runBandwidth(
                 printf("  [eng %d] R+W GiB/s:   %f (read %f, write %f)\n",
                        e, read_bw + write_bw, read_bw, write_bw);
             }
+
+            resultBegin("bandwidth");
+            resultInt("engine", e);
+            resultStr("mode", ! write_lines ? "read" : (! read_lines ? "write" : "read+write"));
+            resultInt("burst", burst_size);
+            resultDouble("read_gbs", read_bw);
+            resultDouble("write_gbs", write_bw);
+            resultDouble("afu_mhz", s_afu_mhz);
+            resultEnd();
         }
 
         e += 1;
@@ -723,6 +707,10 @@ testLocalMemParams(
     s_csr_handle = csr_handle;
     s_is_ase = is_ase;
 
+    // Poll less often in simulation
+    s_hang_check_ns = s_is_ase ? 20000000000 : 100000000;
+    engWaitSetMaxPollNs(s_is_ase ? 2000000000 : 0);
+
     printf("Test ID: %016" PRIx64 " %016" PRIx64 "\n",
            csrEngGlobRead(csr_handle, 1),
            csrEngGlobRead(csr_handle, 0));
@@ -742,6 +730,7 @@ testLocalMemParams(
         s_eng_bufs[e].natural_bursts = (r >> 15) & 1;
         s_eng_bufs[e].ordered_read_responses = (r >> 39) & 1;
         s_eng_bufs[e].eng_type = (r >> 35) & 7;
+        s_eng_bufs[e].chk_ctx = testDataCtxAlloc(s_eng_bufs[e].data_byte_width);
         printf("  Engine %d type: %s\n", e, engine_type[s_eng_bufs[e].eng_type]);
         printf("  Engine %d data byte width: %d\n", e, s_eng_bufs[e].data_byte_width);
         printf("  Engine %d max burst size: %d\n", e, s_eng_bufs[e].max_burst_size);
@@ -749,6 +738,18 @@ testLocalMemParams(
         printf("  Engine %d ordered read responses: %d\n", e, s_eng_bufs[e].ordered_read_responses);
     }
     printf("\n");
+
+    // Expected hashes of long runs jump ahead instead of generating every
+    // value. Confirm that jumping matches stepping for each data width.
+    for (uint32_t e = 0; e < num_engines; e += 1)
+    {
+        if (testDataSelfCheck(s_eng_bufs[e].data_byte_width, rand(), 64))
+        {
+            printf("Engine %d test data jump ahead self-check FAILED\n", e);
+            result = 1;
+            goto done;
+        }
+    }
     
     if (testBankWiring(num_engines))
     {
@@ -799,21 +800,21 @@ testLocalMemParams(
         {
             configBandwidth(e, burst_size, true, false);
         }
-        runBandwidth(all_eng_mask);
+        runBandwidth(all_eng_mask, burst_size);
 
         // Write
         for (uint32_t e = 0; e < num_engines; e += 1)
         {
             configBandwidth(e, burst_size, false, true);
         }
-        runBandwidth(all_eng_mask);
+        runBandwidth(all_eng_mask, burst_size);
 
         // Read+Write
         for (uint32_t e = 0; e < num_engines; e += 1)
         {
             configBandwidth(e, burst_size, true, true);
         }
-        runBandwidth(all_eng_mask);
+        runBandwidth(all_eng_mask, burst_size);
 
         if (s_eng_bufs[0].natural_bursts || (burst_size >= 4))
         {
@@ -827,6 +828,10 @@ testLocalMemParams(
     }
 
   done:
+    for (uint32_t e = 0; e < num_engines; e += 1)
+    {
+        testDataCtxFree(s_eng_bufs[e].chk_ctx);
+    }
     free(s_eng_bufs);
 
     return result;